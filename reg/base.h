@@ -1,6 +1,9 @@
 #pragma once
 #include <type_traits>
 #include <initializer_list>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
 
 //-----------------------------------------------------------------------------
 //	bare minimum
@@ -78,6 +81,17 @@ template<typename T> constexpr bool				between(T x, identity_t<T> a, identity_t<
 template<typename A, typename B> auto 			exchange(A& a, const B& b)	{ A t = a; a = b; return t; }
 template<typename T> void						swap(T& a, T& b)			{ T t = a; a = b; b = t; }
 
+// index of the lowest set bit of x, which mustn't be 0
+inline int lowest_set_bit(unsigned x) {
+#if defined(_MSC_VER) && !defined(__clang__)
+	unsigned long	i;
+	_BitScanForward(&i, x);
+	return int(i);
+#else
+	return __builtin_ctz(x);
+#endif
+}
+
 template<typename T> auto& 						unconst(const T &t)	{ return const_cast<T&>(t); }
 template<typename T> auto& 						toconst(T &t)		{ return const_cast<const T&>(t); }
 template<typename T> auto						unconst(const T *t)	{ return const_cast<T*>(t); }
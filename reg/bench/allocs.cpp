@@ -0,0 +1,8 @@
+// counts malloc and realloc calls when linked with -Wl,--wrap=malloc,--wrap=realloc; printed at exit with REGFAKE_STATS
+#include <stdlib.h>
+#include <stdio.h>
+extern "C" void *__real_malloc(size_t); extern "C" void *__real_realloc(void*, size_t);
+static long n_alloc;
+extern "C" void *__wrap_malloc(size_t n) { ++n_alloc; return __real_malloc(n); }
+extern "C" void *__wrap_realloc(void *p, size_t n) { ++n_alloc; return __real_realloc(p, n); }
+struct Report { ~Report() { if (getenv("REGFAKE_STATS")) fprintf(stderr, "allocs=%ld\n", n_alloc); } } report;
@@ -0,0 +1,9 @@
+#!/bin/sh
+# best of N wall times: best_of.sh N label cmd...
+n=$1; label=$2; shift 2
+best=
+for i in $(seq $n); do
+  s=$(date +%s%N); sh -c "$*"; e=$(date +%s%N); t=$(( (e - s) / 1000000 ))
+  [ -z "$best" ] || [ $t -lt $best ] && best=$t
+done
+echo "$label: ${best} ms"
@@ -0,0 +1,45 @@
+#!/bin/sh
+# builds reg and the programs here against fake/ (an in-memory Win32 stand-in), into $OUT (default bench/out)
+#	build.sh			reg and the programs here
+#	build.sh check		only a -Wall -Wextra syntax check of reg.cpp
+# CXXFLAGS is added to every compile, e.g. CXXFLAGS="-fsanitize=address,undefined -fno-sanitize=alignment"
+set -e
+HERE=$(cd "$(dirname "$0")" && pwd)
+OUT=${OUT:-$HERE/out}
+mkdir -p "$OUT/src"
+cp "$HERE"/../*.h "$HERE"/../reg.cpp "$OUT/src/"
+
+# gcc rejects two things in text.h that MSVC lets through, as it doesn't look into templates until they're used:
+# three Parser operators (a missing '?', and an r that class doesn't have) and put(void*), which uses base<> before
+# it's declared; they're fixed up in the copy only
+python3 - "$OUT/src/text.h" <<'PY'
+import sys
+l = open(sys.argv[1]).read().split('\n')
+b = next(i for i, s in enumerate(l) if 'skip(skip_whitespace(), t) this' in s)
+l[b:b + 3] = ['', '', '']
+for i, s in enumerate(l):
+	if 'inline void put(TextWriter<C> &p, void *v)' in s:
+		l[i] = 'template<typename C> inline void put(TextWriter<C> &p, void *v) { p << L"0x" << uintptr_t(v); }'
+open(sys.argv[1], 'w').write('\n'.join(l))
+PY
+
+FLAGS="-std=c++17 -fshort-wchar -fms-extensions -include $HERE/fake/shim16.h -isystem $HERE/fake -DUNICODE -D_UNICODE"
+if [ "$1" = check ]; then
+	g++ $FLAGS -fsyntax-only -Wall -Wextra -Wno-unused-parameter -Wno-missing-field-initializers $CXXFLAGS "$OUT/src/reg.cpp"
+	exit
+fi
+
+FLAGS="$FLAGS -O2 -g $CXXFLAGS"
+cd "$OUT"
+g++ -std=c++17 -fshort-wchar -O2 -g $CXXFLAGS -c "$HERE/fake/fake.cpp" -o fake.o
+g++ $FLAGS -c src/reg.cpp -o reg.o
+g++ $FLAGS reg.o fake.o -o reg -lpthread
+g++ $FLAGS reg.o fake.o "$HERE/allocs.cpp" -Wl,--wrap=malloc,--wrap=realloc -o reg_allocs -lpthread
+
+# these include reg.cpp (its wmain renamed) to call into it directly
+for p in import_bench walk_hive; do
+	g++ $FLAGS -iquote src "$HERE/$p.cpp" fake.o -o $p -lpthread
+done
+for p in hex_check wildcard_check regex_check regex_bench; do
+	g++ $FLAGS -iquote src "$HERE/$p.cpp" -o $p
+done
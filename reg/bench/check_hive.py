@@ -0,0 +1,119 @@
+# checks a hive the way SAVE writes it (checksum, bins, cell sizes, lh hashes and order, sk counts, max sizes): check_hive.py file.hiv
+import struct, sys
+d = open(sys.argv[1], 'rb').read()
+err = []
+def E(m):
+    err.append(m)
+    if len(err) < 20: print('ERR', m)
+assert d[:4] == b'regf'
+cs = 0
+for i in range(127): cs ^= struct.unpack_from('<I', d, i*4)[0]
+if cs == 0xffffffff: cs = 0xfffffffe
+if cs == 0: cs = 1
+if cs != struct.unpack_from('<I', d, 508)[0]: E('checksum')
+seq1, seq2 = struct.unpack_from('<II', d, 4)
+major, minor, typ, fmt, root, binsize, clus = struct.unpack_from('<IIIIIII', d, 20)
+print('version %d.%d root %x bins %d file %d' % (major, minor, root, binsize, len(d)))
+if 4096 + binsize != len(d): E('size')
+B = d[4096:]
+cells = {}
+used = free = 0; nbins = 0
+off = 0
+while off < binsize:
+    if B[off:off+4] != b'hbin': E('hbin at %x' % off); break
+    bo, bs = struct.unpack_from('<II', B, off+4)
+    if bo != off or bs % 4096: E('bin hdr %x' % off)
+    nbins += 1
+    c = off + 32
+    while c < off + bs:
+        sz = struct.unpack_from('<i', B, c)[0]
+        if sz == 0 or abs(sz) % 8: E('cell size %x' % c); break
+        if sz < 0: cells[c] = -sz; used += -sz
+        else: free += sz
+        c += abs(sz)
+    if c != off + bs: E('cells overrun bin %x' % off)
+    off += bs
+print('bins %d used %d free %d (%.1f%%)' % (nbins, used, free, 100.0*free/binsize))
+def cell(o):
+    if o not in cells: E('bad cell ref %x' % o); return b''
+    return B[o+4:o+cells[o]]
+ref = set()
+def up(s):
+    return ''.join(ch.upper() if ord(ch) < 0x80 else ch.upper() if len(ch.upper())==1 else ch for ch in s)
+def h(s):
+    x = 0
+    for ch in s: x = (x*37 + ord(up(ch))) & 0xffffffff
+    return x
+sk_refs = {}
+nkeys = nvals = 0
+stack = [(root, 0xffffffff)]
+while stack:
+    k, par = stack.pop()
+    c = cell(k); ref.add(k); nkeys += 1
+    if c[:2] != b'nk': E('nk sig %x' % k); continue
+    flags, = struct.unpack_from('<H', c, 2)
+    (parent, nsub, nvol, sub, vsub, nval, vals, sec, cls, msn, msc, mvn, mvd, work, nl, cl) = struct.unpack_from('<IIIIIIIIIIIIIIHH', c, 16)
+    if parent != par and k != root: E('parent %x' % k)
+    name = c[76:76+nl].decode('latin-1') if flags & 0x20 else c[76:76+nl].decode('utf-16le', 'surrogatepass')
+    sk_refs[sec] = sk_refs.get(sec, 0) + 1
+    mx_vn = mx_vd = 0
+    if nval:
+        vl = cell(vals); ref.add(vals)
+        for i in range(nval):
+            v = struct.unpack_from('<I', vl, i*4)[0]; ref.add(v); nvals += 1
+            vc = cell(v)
+            if vc[:2] != b'vk': E('vk'); continue
+            vnl, size, data, typ, vf = struct.unpack_from('<HIIIH', vc, 2)
+            mx_vn = max(mx_vn, vnl * (1 if not (vf & 1) else 2))
+            n = size & 0x7fffffff
+            mx_vd = max(mx_vd, n)
+            if size & 0x80000000:
+                if n > 4: E('inline >4')
+            elif n > 16344:
+                db = cell(data); ref.add(data)
+                if db[:2] != b'db': E('db'); continue
+                ns, sl = struct.unpack_from('<HI', db, 2); ref.add(sl)
+                sll = cell(sl); tot = 0
+                for j in range(ns):
+                    so = struct.unpack_from('<I', sll, j*4)[0]; ref.add(so); tot += min(len(cell(so)), 16344)
+                if tot < n: E('db short')
+            else:
+                ref.add(data)
+                if len(cell(data)) < n: E('data short %x' % v)
+    if mvd != mx_vd: E('max_value_data %x %d %d' % (k, mvd, mx_vd))
+    subs = []
+    if nsub:
+        l = cell(sub); ref.add(sub)
+        leaves = []
+        if l[:2] == b'ri':
+            cnt, = struct.unpack_from('<H', l, 2)
+            for i in range(cnt):
+                lo = struct.unpack_from('<I', l, 4+i*4)[0]; ref.add(lo); leaves.append(cell(lo))
+        else: leaves = [l]
+        for lf in leaves:
+            if lf[:2] != b'lh': E('lh sig'); continue
+            cnt, = struct.unpack_from('<H', lf, 2)
+            for i in range(cnt):
+                so, hh = struct.unpack_from('<II', lf, 4+i*8)
+                sc = cell(so)
+                sf, = struct.unpack_from('<H', sc, 2); snl, = struct.unpack_from('<H', sc, 72)
+                sn = sc[76:76+snl].decode('latin-1') if sf & 0x20 else sc[76:76+snl].decode('utf-16le', 'surrogatepass')
+                if hh != h(sn): E('hash %r' % sn)
+                subs.append((sn, so))
+        if len(subs) != nsub: E('nsub %x' % k)
+        names = [up(s) for s, _ in subs]
+        if [tuple(map(ord, x)) for x in names] != sorted(tuple(map(ord, x)) for x in names): E('order under %r' % name)
+        if len(set(names)) != len(names): E('dup under %r' % name)
+        for sn, so in reversed(subs): stack.append((so, k))
+    if msn != max([len(s)*2 for s, _ in subs] or [0]): E('max_subkey_name %r' % name)
+# sk
+for s, r in sk_refs.items():
+    sc = cell(s); ref.add(s)
+    if sc[:2] != b'sk': E('sk'); continue
+    fl, bl, rc, sz = struct.unpack_from('<IIII', sc, 4)
+    if rc != r: E('sk refs %x %d %d' % (s, rc, r))
+    if cell(fl)[:2] != b'sk' or cell(bl)[:2] != b'sk': E('sk links')
+    if struct.unpack_from('<I', cell(fl), 8)[0] != s: E('sk flink/blink mismatch')
+unref = [c for c in cells if c not in ref]
+print('keys %d values %d sk %d unreferenced cells %d' % (nkeys, nvals, len(sk_refs), len(unref)))
+print('OK' if not err else '%d errors' % len(err))
@@ -0,0 +1,21 @@
+#!/bin/bash
+# compare_hive.sh name: loads name.reg into the fake registry over SERVE and runs the QUERYs in compare_hive.txt and an EXPORT
+# against it, then the same against /hive name.hiv (from gen_hive.py), and compares the two
+HERE=$(cd "$(dirname "$0")" && pwd)
+R=${REG:-$HERE/out/reg}
+f=$1
+keys=$(iconv -f utf-16 -t utf-8 $f.reg | tr -d '\r' | grep '^\[' | sed 's/^\[//; s/\]$//')
+args=()
+while IFS= read -r k; do args+=(ADD "$k" /f --); done <<< "$keys"
+args+=(IMPORT $f.reg)
+rm -f $f.fe.reg $f.he.reg
+i=0
+while IFS= read -r o; do
+  args+=(-- ! QUERY 'HKLM\SOFTWARE' $o)
+done < "$HERE/compare_hive.txt"
+args+=(-- EXPORT 'HKLM\SOFTWARE' $f.fe.reg)
+python3 "$HERE/serve.py" $R "${args[@]}" > $f.fake.out; echo serve=$?
+: > $f.hive.out
+while IFS= read -r o; do $R QUERY 'HKLM\SOFTWARE' /hive $f.hiv $o >> $f.hive.out; done < "$HERE/compare_hive.txt"
+cmp $f.fake.out $f.hive.out && echo QUERY-same $(wc -c < $f.hive.out)
+$R EXPORT 'HKLM\SOFTWARE' $f.he.reg /hive $f.hiv; cmp $f.fe.reg $f.he.reg && echo EXPORT-same $(wc -c < $f.he.reg)
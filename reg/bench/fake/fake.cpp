@@ -0,0 +1,316 @@
+// an in-memory stand-in for the Win32 APIs reg.cpp uses, so it can be built, tested and timed on Linux
+// files, mappings, threads and events map onto POSIX; the registry is a tree of Nodes behind one mutex
+// environment:
+//	REGFAKE_SEED=depth,fanout,values	seeds HKCU\Software with a synthetic tree
+//	REGFAKE_LATENCY=us					sleeps that long in every registry call (RegConnectRegistry: 10x)
+//	REGFAKE_SCRIPT=file					changes the tree from another thread as the command runs (see script below)
+//	REGFAKE_NOTIFY=0					makes RegNotifyChangeKeyValue fail, so WATCH polls
+//	REGFAKE_STATS=1						prints registry calls, opens, connects and write calls to stderr at exit
+// and "reg A ++ B" runs both commands in one process, against the same tree
+#include <locale.h>
+#include "shim16.h"
+#include "windows.h"
+#include <map>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <wctype.h>
+typedef std::u16string wstr;
+static wstr W(const wchar_t *s) { return s ? wstr((const char16_t*)s) : wstr(); }
+static wstr W(const char *s) { wstr r; while (*s) r += (char16_t)*s++; return r; }
+static wstr W(int i) { return W(std::to_string(i).c_str()); }
+
+std::string narrow(const wchar_t *w) { std::string s; if (w) for (; *w; ++w) s += (char)*w; return s; }
+
+struct FileH { int fd; };
+extern "C" {
+HANDLE CreateFileW(LPCWSTR name, DWORD access, DWORD, LPSECURITY_ATTRIBUTES, DWORD disp, DWORD, HANDLE) {
+	int flags = (access & GENERIC_WRITE) ? O_RDWR : O_RDONLY;
+	if (disp == CREATE_ALWAYS) flags |= O_CREAT | O_TRUNC;
+	if (disp == OPEN_ALWAYS) flags |= O_CREAT;
+	int fd = open(narrow(name).c_str(), flags, 0644);
+	if (fd < 0) return INVALID_HANDLE_VALUE;
+	return new FileH{fd};
+}
+struct Mapping { FileH *f; };
+std::atomic<long> g_writes{0};
+BOOL CloseHandle(HANDLE h) { return TRUE; }
+BOOL FlushFileBuffers(HANDLE) { return TRUE; }
+BOOL WriteFile(HANDLE h, LPCVOID p, DWORD n, LPDWORD w, void*) { ++g_writes; auto r = write(((FileH*)h)->fd, p, n); if (w) *w = r; return r >= 0; }
+BOOL ReadFile(HANDLE h, LPVOID p, DWORD n, LPDWORD w, void*) { auto r = read(((FileH*)h)->fd, p, n); if (w) *w = r; return r >= 0; }
+BOOL GetFileSizeEx(HANDLE h, LARGE_INTEGER *s) { struct stat st; fstat(((FileH*)h)->fd, &st); s->QuadPart = st.st_size; return TRUE; }
+BOOL GetFileInformationByHandle(HANDLE h, LPBY_HANDLE_FILE_INFORMATION i) { struct stat st; if (fstat(((FileH*)h)->fd, &st)) return FALSE; memset(i, 0, sizeof(*i)); i->dwVolumeSerialNumber = st.st_dev; i->nFileIndexHigh = st.st_ino >> 32; i->nFileIndexLow = st.st_ino; i->nNumberOfLinks = st.st_nlink; return TRUE; }
+BOOL SetFilePointerEx(HANDLE h, LARGE_INTEGER d, LARGE_INTEGER *n, DWORD m) { auto r = lseek(((FileH*)h)->fd, d.QuadPart, m == 0 ? SEEK_SET : m == 1 ? SEEK_CUR : SEEK_END); if (n) n->QuadPart = r; return TRUE; }
+HANDLE CreateFileMappingW(HANDLE f, LPSECURITY_ATTRIBUTES, DWORD, DWORD, DWORD, LPCWSTR) { LARGE_INTEGER s; GetFileSizeEx(f, &s); if (!s.QuadPart) return nullptr; return new Mapping{(FileH*)f}; }
+LPVOID MapViewOfFile(HANDLE m, DWORD, DWORD, DWORD, SIZE_T) { LARGE_INTEGER s; GetFileSizeEx(((Mapping*)m)->f, &s); void *p = mmap(0, s.QuadPart, PROT_READ, MAP_PRIVATE, ((Mapping*)m)->f->fd, 0); return p == MAP_FAILED ? nullptr : p; }
+BOOL UnmapViewOfFile(LPCVOID) { return TRUE; }
+HANDLE GetStdHandle(DWORD d) { return new FileH{d == STD_INPUT_HANDLE ? 0 : 1}; }
+BOOL GetConsoleMode(HANDLE, LPDWORD) { return FALSE; }
+BOOL WriteConsoleW(HANDLE h, const void *p, DWORD n, LPDWORD w, void*) { ++g_writes; auto r = write(((FileH*)h)->fd, p, n * 2); if (w) *w = r / 2; return r >= 0; }
+DWORD GetLastError() { return errno; }
+void GetSystemInfo(SYSTEM_INFO *i) { memset(i, 0, sizeof(*i)); i->dwNumberOfProcessors = sysconf(_SC_NPROCESSORS_ONLN); i->dwPageSize = 4096; i->dwAllocationGranularity = 65536; }
+ULONGLONG GetTickCount64() { timespec t; clock_gettime(CLOCK_MONOTONIC, &t); return t.tv_sec * 1000ull + t.tv_nsec / 1000000; }
+DWORD GetTickCount() { return (DWORD)GetTickCount64(); }
+BOOL QueryPerformanceCounter(LARGE_INTEGER *c) { timespec t; clock_gettime(CLOCK_MONOTONIC, &t); c->QuadPart = t.tv_sec * 1000000000ll + t.tv_nsec; return TRUE; }
+BOOL QueryPerformanceFrequency(LARGE_INTEGER *f) { f->QuadPart = 1000000000ll; return TRUE; }
+void Sleep(DWORD ms) { usleep(ms * 1000); }
+void GetSystemTimeAsFileTime(FILETIME *f) { timespec t; clock_gettime(CLOCK_REALTIME, &t); uint64_t v = (t.tv_sec + 11644473600ull) * 10000000ull + t.tv_nsec / 100; f->dwLowDateTime = (DWORD)v; f->dwHighDateTime = v >> 32; }
+struct ThreadH { int tag; pthread_t t; LPTHREAD_START_ROUTINE f; void *p; };
+struct EventH { int tag; pthread_mutex_t m; pthread_cond_t c; bool set, manual; };
+HANDLE CreateEventW(LPSECURITY_ATTRIBUTES, BOOL manual, BOOL init, LPCWSTR) { auto e = new EventH{2}; pthread_mutex_init(&e->m, 0); pthread_cond_init(&e->c, 0); e->set = init; e->manual = manual; return e; }
+BOOL SetEvent(HANDLE h) { auto e = (EventH*)h; pthread_mutex_lock(&e->m); e->set = true; pthread_cond_broadcast(&e->c); pthread_mutex_unlock(&e->m); return TRUE; }
+BOOL ResetEvent(HANDLE h) { auto e = (EventH*)h; pthread_mutex_lock(&e->m); e->set = false; pthread_mutex_unlock(&e->m); return TRUE; }
+static void *thunk(void *p) { auto t = (ThreadH*)p; t->f(t->p); return 0; }
+HANDLE CreateThread(LPSECURITY_ATTRIBUTES, SIZE_T, LPTHREAD_START_ROUTINE f, LPVOID p, DWORD, DWORD*) { auto t = new ThreadH{1, 0, f, p}; pthread_create(&t->t, 0, thunk, t); return t; }
+DWORD WaitForSingleObject(HANDLE h, DWORD ms) {
+	if (*(int*)h == 1) { pthread_join(((ThreadH*)h)->t, 0); return 0; }
+	auto e = (EventH*)h; pthread_mutex_lock(&e->m);
+	timespec t; clock_gettime(CLOCK_REALTIME, &t); t.tv_nsec += (ms % 1000) * 1000000l; t.tv_sec += ms / 1000 + t.tv_nsec / 1000000000l; t.tv_nsec %= 1000000000l;
+	while (!e->set) { if (ms == INFINITE) pthread_cond_wait(&e->c, &e->m); else if (pthread_cond_timedwait(&e->c, &e->m, &t)) break; }
+	DWORD r = e->set ? WAIT_OBJECT_0 : WAIT_TIMEOUT; if (e->set && !e->manual) e->set = false;
+	pthread_mutex_unlock(&e->m); return r;
+}
+void InitializeSRWLock(PSRWLOCK l) { pthread_mutex_init(&l->m, 0); }
+void AcquireSRWLockExclusive(PSRWLOCK l) { pthread_mutex_lock(&l->m); }
+void ReleaseSRWLockExclusive(PSRWLOCK l) { pthread_mutex_unlock(&l->m); }
+void AcquireSRWLockShared(PSRWLOCK l) { pthread_mutex_lock(&l->m); }
+void ReleaseSRWLockShared(PSRWLOCK l) { pthread_mutex_unlock(&l->m); }
+void InitializeConditionVariable(PCONDITION_VARIABLE c) { pthread_cond_init(&c->c, 0); }
+BOOL SleepConditionVariableSRW(PCONDITION_VARIABLE c, PSRWLOCK l, DWORD ms, ULONG) {
+	if (ms == INFINITE) { pthread_cond_wait(&c->c, &l->m); return TRUE; }
+	timespec t; clock_gettime(CLOCK_REALTIME, &t); t.tv_nsec += (ms % 1000) * 1000000l; t.tv_sec += ms / 1000 + t.tv_nsec / 1000000000l; t.tv_nsec %= 1000000000l;
+	if (pthread_cond_timedwait(&c->c, &l->m, &t)) { errno = ERROR_TIMEOUT; return FALSE; } return TRUE;
+}
+void WakeConditionVariable(PCONDITION_VARIABLE c) { pthread_cond_signal(&c->c); }
+void WakeAllConditionVariable(PCONDITION_VARIABLE c) { pthread_cond_broadcast(&c->c); }
+LONG InterlockedIncrement(LONG volatile *p) { return __sync_add_and_fetch(p, 1); }
+LONG InterlockedDecrement(LONG volatile *p) { return __sync_sub_and_fetch(p, 1); }
+LONG InterlockedExchangeAdd(LONG volatile *p, LONG v) { return __sync_fetch_and_add(p, v); }
+LONG InterlockedCompareExchange(LONG volatile *p, LONG x, LONG c) { return __sync_val_compare_and_swap(p, c, x); }
+void* InterlockedCompareExchangePointer(void* volatile *p, void *x, void *c) { return __sync_val_compare_and_swap(p, c, x); }
+int WideCharToMultiByte(UINT, DWORD, LPCWSTR w, int n, char *d, int dn, const char*, BOOL*) {
+	std::string s; for (int i = 0; i < n; i++) { unsigned c = w[i]; if (c < 0x80) s += c; else if (c < 0x800) { s += 0xc0 | c >> 6; s += 0x80 | (c & 63); } else { s += 0xe0 | c >> 12; s += 0x80 | ((c >> 6) & 63); s += 0x80 | (c & 63); } }
+	if (d) memcpy(d, s.data(), std::min<size_t>(s.size(), dn)); return s.size();
+}
+int MultiByteToWideChar(UINT, DWORD, const char *s, int n, LPWSTR d, int) {
+	int o = 0; for (int i = 0; i < n;) { unsigned char c = s[i++]; unsigned v = c; if (c >= 0xe0) { v = (c & 15) << 12 | (s[i] & 63) << 6 | (s[i+1] & 63); i += 2; } else if (c >= 0xc0) { v = (c & 31) << 6 | (s[i++] & 63); } if (d) d[o] = v; o++; } return o;
+}
+DWORD FormatMessageW(DWORD, LPCVOID, DWORD, DWORD, LPWSTR b, DWORD, void*) { *(const wchar_t**)b = L"message\n"; return 1; }
+DWORD GetTempPathW(DWORD, LPWSTR b) { memcpy(b, L"/tmp/", 12); return 5; }
+}
+
+//-----------------------------------------------------------------------------
+// registry
+//-----------------------------------------------------------------------------
+
+struct Val { wstr name; DWORD type; std::vector<BYTE> data; };
+struct Node {
+	wstr name;
+	Node *parent = nullptr;
+	std::vector<Node*> children;
+	std::vector<Val> values;
+	uint64_t last_write = 1;
+	bool deleted = false;		// handles to it only get ERROR_KEY_DELETED, as on Windows
+	Node *subtree_parent() { return parent; }
+};
+static Node roots[6];
+std::atomic<long> g_reg_calls{0}, g_connects{0}, g_opens{0};
+int g_latency_us = 0;
+static std::mutex reg_mutex;
+static uint64_t clock_tick = 100;
+struct Notify { Node *n; bool subtree; HANDLE e; };
+static std::vector<Notify> notifies;
+std::atomic<long> g_notifies{0};
+extern "C" BOOL SetEvent(HANDLE);
+static void touch(Node *n) {
+	n->last_write = ++clock_tick;
+	for (size_t i = 0; i < notifies.size();) {
+		bool hit = false; for (auto p = n; p; p = p->subtree_parent()) { if (!notifies[i].subtree && p != n) break; if (p == notifies[i].n) { hit = true; break; } }
+		if (hit) { SetEvent(notifies[i].e); notifies.erase(notifies.begin() + i); } else i++;
+	}
+}
+static Node *node(HKEY h) { auto v = (uintptr_t)h; if (v >= 0x80000000 && v < 0x80000006) return &roots[v - 0x80000000]; return (Node*)h; }
+static bool ieq(const wstr &a, const wstr &b) { if (a.size() != b.size()) return false; for (size_t i = 0; i < a.size(); i++) if (r16_lower(a[i]) != r16_lower(b[i])) return false; return true; }
+static bool iless(const wstr &a, const wstr &b) { return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), [](wchar_t x, wchar_t y) { return r16_lower(x) < r16_lower(y); }); }
+static Node *child(Node *n, const wstr &name, bool create) {
+	for (auto c : n->children) if (ieq(c->name, name)) return c;
+	if (!create) return nullptr;
+	auto c = new Node; c->name = name; c->parent = n; touch(c);
+	n->children.insert(std::lower_bound(n->children.begin(), n->children.end(), c, [](Node *a, Node *b) { return iless(a->name, b->name); }), c);
+	touch(n);
+	return c;
+}
+static Node *walk(Node *n, LPCWSTR sub, bool create) {
+	if (!sub) return n;
+	wstr s = W(sub);
+	size_t a = 0;
+	while (n && a < s.size()) {
+		auto b = s.find(u'\\', a); if (b == wstr::npos) b = s.size();
+		if (b > a) n = child(n, s.substr(a, b - a), create);
+		a = b + 1;
+	}
+	return n;
+}
+static void latency() { ++g_reg_calls; if (g_latency_us) usleep(g_latency_us); }
+extern "C" {
+LSTATUS RegOpenKeyExW(HKEY h, LPCWSTR sub, DWORD, REGSAM, PHKEY r) { latency(); ++g_opens; std::lock_guard<std::mutex> l(reg_mutex); if (node(h)->deleted) return ERROR_KEY_DELETED; auto n = walk(node(h), sub, false); if (!n) return ERROR_FILE_NOT_FOUND; *r = (HKEY)n; return 0; }
+LSTATUS RegCreateKeyExW(HKEY h, LPCWSTR sub, DWORD, LPWSTR, DWORD, REGSAM, LPSECURITY_ATTRIBUTES, PHKEY r, LPDWORD) { latency(); std::lock_guard<std::mutex> l(reg_mutex); *r = (HKEY)walk(node(h), sub, true); return 0; }
+LSTATUS RegDeleteKeyExW(HKEY h, LPCWSTR sub, REGSAM, DWORD) { latency(); std::lock_guard<std::mutex> l(reg_mutex); auto n = walk(node(h), sub, false); if (!n) return ERROR_FILE_NOT_FOUND; if (!n->children.empty()) return ERROR_ACCESS_DENIED; n->deleted = true; auto &c = n->parent->children; c.erase(std::find(c.begin(), c.end(), n)); touch(n->parent); return 0; }
+static void del_tree(Node *n) { for (auto c : n->children) { del_tree(c); c->deleted = true; } n->children.clear(); }
+LSTATUS RegDeleteTreeW(HKEY h, LPCWSTR sub) { latency(); std::lock_guard<std::mutex> l(reg_mutex); auto n = walk(node(h), sub, false); if (!n) return ERROR_FILE_NOT_FOUND; del_tree(n); n->values.clear(); if (sub && *sub) { n->deleted = true; auto &c = n->parent->children; c.erase(std::find(c.begin(), c.end(), n)); touch(n->parent);} return 0; }
+LSTATUS RegCloseKey(HKEY) { return 0; }
+// simple upper-casing through glibc's UTF-8 locale tables
+int LCMapStringEx(LPCWSTR, DWORD, LPCWSTR src, int n, LPWSTR dst, int, void*, void*, intptr_t) {
+	static locale_t l = newlocale(LC_CTYPE_MASK, "C.UTF-8", 0);
+	for (int i = 0; i < n; i++) { auto u = towupper_l(src[i], l); dst[i] = u < 0x10000 ? u : src[i]; }
+	return n;
+}
+// a fixed owner-only descriptor, so SAVE's two-call path is exercised
+LSTATUS RegGetKeySecurity(HKEY, SECURITY_INFORMATION, PSECURITY_DESCRIPTOR sd, LPDWORD size) {
+	static const BYTE d[] = {1,0,0,0x80, 20,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0, 1,1,0,0,0,0,0,5, 18,0,0,0};
+	if (!sd || *size < sizeof(d)) { *size = sizeof(d); return ERROR_INSUFFICIENT_BUFFER; }
+	memcpy(sd, d, sizeof(d)); *size = sizeof(d); return 0;
+}
+LSTATUS RegConnectRegistryW(LPCWSTR, HKEY h, PHKEY r) { latency(); ++g_connects; if (g_latency_us) usleep(g_latency_us * 10); *r = h; return 0; }
+LSTATUS RegQueryInfoKeyW(HKEY h, LPWSTR cls, LPDWORD cs, LPDWORD, LPDWORD ns, LPDWORD ms, LPDWORD mc, LPDWORD nv, LPDWORD mv, LPDWORD md, LPDWORD sd, PFILETIME ft) {
+	latency(); std::lock_guard<std::mutex> l(reg_mutex); auto n = node(h); if (n->deleted) return ERROR_KEY_DELETED;
+	if (cls) cls[0] = 0; if (cs) *cs = 0;
+	DWORD mks = 0, mvs = 0, mds = 0; for (auto c : n->children) mks = std::max<DWORD>(mks, c->name.size()); for (auto &v : n->values) { mvs = std::max<DWORD>(mvs, v.name.size()); mds = std::max<DWORD>(mds, v.data.size()); }
+	if (ns) *ns = n->children.size(); if (ms) *ms = mks; if (mc) *mc = 0; if (nv) *nv = n->values.size(); if (mv) *mv = mvs; if (md) *md = mds; if (sd) *sd = 0;
+	if (ft) { ft->dwLowDateTime = (DWORD)n->last_write; ft->dwHighDateTime = n->last_write >> 32; }
+	return 0;
+}
+LSTATUS RegEnumValueW(HKEY h, DWORD i, LPWSTR name, LPDWORD ns, LPDWORD, LPDWORD type, LPBYTE data, LPDWORD ds) {
+	latency(); std::lock_guard<std::mutex> l(reg_mutex); auto n = node(h); if (n->deleted) return ERROR_KEY_DELETED;
+	if (i >= n->values.size()) return ERROR_NO_MORE_ITEMS;
+	auto &v = n->values[i];
+	if (v.name.size() + 1 > *ns) return ERROR_MORE_DATA;
+	memcpy(name, v.name.c_str(), (v.name.size() + 1) * 2); *ns = v.name.size();
+	if (type) *type = v.type;
+	if (ds) { if (data) { if (v.data.size() > *ds) { *ds = v.data.size(); return ERROR_MORE_DATA; } memcpy(data, v.data.data(), v.data.size()); } *ds = v.data.size(); }
+	return 0;
+}
+LSTATUS RegEnumKeyExW(HKEY h, DWORD i, LPWSTR name, LPDWORD ns, LPDWORD, LPWSTR, LPDWORD, PFILETIME ft) {
+	latency(); std::lock_guard<std::mutex> l(reg_mutex); auto n = node(h); if (n->deleted) return ERROR_KEY_DELETED;
+	if (i >= n->children.size()) return ERROR_NO_MORE_ITEMS;
+	auto c = n->children[i];
+	if (c->name.size() + 1 > *ns) return ERROR_MORE_DATA;
+	memcpy(name, c->name.c_str(), (c->name.size() + 1) * 2); *ns = c->name.size();
+	if (ft) { ft->dwLowDateTime = (DWORD)c->last_write; ft->dwHighDateTime = c->last_write >> 32; }
+	return 0;
+}
+LSTATUS RegQueryValueExW(HKEY h, LPCWSTR name, LPDWORD, LPDWORD type, LPBYTE data, LPDWORD ds) {
+	latency(); std::lock_guard<std::mutex> l(reg_mutex); auto n = node(h); if (n->deleted) return ERROR_KEY_DELETED;
+	for (auto &v : n->values) if (ieq(v.name, W(name))) { if (type) *type = v.type; if (ds) { if (data) { if (v.data.size() > *ds) { *ds = v.data.size(); return ERROR_MORE_DATA; } memcpy(data, v.data.data(), v.data.size()); } *ds = v.data.size(); } return 0; }
+	return ERROR_FILE_NOT_FOUND;
+}
+LSTATUS RegSetValueExW(HKEY h, LPCWSTR name, DWORD, DWORD type, const BYTE *data, DWORD size) {
+	latency(); std::lock_guard<std::mutex> l(reg_mutex); auto n = node(h); if (n->deleted) return ERROR_KEY_DELETED; touch(n);
+	wstr nm = W(name);
+	for (auto &v : n->values) if (ieq(v.name, nm)) { v.type = type; v.data.assign(data, data + size); return 0; }
+	n->values.push_back({nm, type, std::vector<BYTE>(data, data + size)});
+	return 0;
+}
+LSTATUS RegDeleteValueW(HKEY h, LPCWSTR name) {
+	latency(); std::lock_guard<std::mutex> l(reg_mutex); auto n = node(h); if (n->deleted) return ERROR_KEY_DELETED;
+	for (auto i = n->values.begin(); i != n->values.end(); ++i) if (ieq(i->name, W(name))) { n->values.erase(i); touch(n); return 0; }
+	return ERROR_FILE_NOT_FOUND;
+}
+LSTATUS RegLoadAppKeyW(LPCWSTR, PHKEY, REGSAM, DWORD, DWORD) { return ERROR_NOT_SUPPORTED; }
+LSTATUS RegUnLoadKeyW(HKEY, LPCWSTR) { return ERROR_NOT_SUPPORTED; }
+LSTATUS RegNotifyChangeKeyValue(HKEY h, BOOL subtree, DWORD, HANDLE e, BOOL) {
+	if (getenv("REGFAKE_NOTIFY") && !atoi(getenv("REGFAKE_NOTIFY"))) return ERROR_NOT_SUPPORTED;
+	latency(); ++g_notifies; std::lock_guard<std::mutex> l(reg_mutex); notifies.push_back({node(h), !!subtree, e}); return 0;
+}
+uint32_t _byteswap_ulong(uint32_t v) { return __builtin_bswap32(v); }
+unsigned long long _byteswap_uint64(unsigned long long v) { return __builtin_bswap64(v); }
+unsigned short _byteswap_ushort(unsigned short v) { return __builtin_bswap16(v); }
+int _wfopen_s(FILE **f, const wchar_t *n, const wchar_t *m) { std::string mode = narrow(m); mode = mode.substr(0, mode.find(',')); if (mode.find('b') == std::string::npos) mode += "b"; *f = fopen(narrow(n).c_str(), mode.c_str()); return *f ? 0 : errno; }
+int _setmode(int, int) { return 0; }
+int _fileno(FILE *f) { return fileno(f); }
+}
+
+// seeds a synthetic tree: REGFAKE_SEED=depth,fanout,values
+static struct Seeder {
+	Seeder() {
+		if (auto s = getenv("REGFAKE_LATENCY")) g_latency_us = atoi(s);
+		auto s = getenv("REGFAKE_SEED");
+		if (!s) return;
+		int depth = 3, fan = 4, vals = 3;
+		sscanf(s, "%d,%d,%d", &depth, &fan, &vals);
+		seed(child(&roots[1], W("Software"), true), depth, fan, vals, 0);
+	}
+	void seed(Node *n, int depth, int fan, int vals, int id) {
+		for (int i = 0; i < vals; i++) {
+			Val v; v.name = W("Value") + W(i);
+			switch (i % 4) {
+				case 0: { v.type = 1; wstr t = W("Data ") + W(id * 31 + i) + W(" \"quoted\" \\path"); v.data.assign((BYTE*)t.c_str(), (BYTE*)(t.c_str() + t.size() + 1)); } break;
+				case 1: { v.type = 4; DWORD d = id * 7 + i; v.data.assign((BYTE*)&d, (BYTE*)&d + 4); } break;
+				case 2: { v.type = 3; for (int j = 0; j < 40 + id % 100; j++) v.data.push_back(j * 13 + id); } break;
+				case 3: { v.type = 7; const char16_t t[] = u"one\0two\0"; v.data.assign((BYTE*)t, (BYTE*)t + sizeof(t) - sizeof(wchar_t)); } break;
+			}
+			n->values.push_back(v);
+		}
+		if (vals) { Val v; v.name = wstr(); v.type = 1; wstr t = W("default"); v.data.assign((BYTE*)t.c_str(), (BYTE*)(t.c_str() + t.size() + 1)); n->values.push_back(v); }
+		if (depth > 0)
+			for (int i = 0; i < fan; i++)
+				seed(child(n, W("Key") + W(i), true), depth - 1, fan, vals, id * fan + i + 1);
+	}
+} seeder;
+
+// REGFAKE_SCRIPT=file: lines of "ms op path [name [data]]" (path under HKCU), run at ms after start:
+//	set path name dword | str path name text | delv path name | mk path | rm path | exit
+static void *script(void *f) {
+	FILE *in = fopen((const char*)f, "r"); if (!in) return 0;
+	char line[1024]; timespec t0; clock_gettime(CLOCK_MONOTONIC, &t0);
+	while (fgets(line, sizeof line, in)) {
+		long ms; char op[16] = "", path[512] = "", name[256] = "", data[512] = "";
+		if (sscanf(line, "%ld %15s %511s %255s %511[^\n]", &ms, op, path, name, data) < 2) continue;
+		timespec t; clock_gettime(CLOCK_MONOTONIC, &t); long el = (t.tv_sec - t0.tv_sec) * 1000 + (t.tv_nsec - t0.tv_nsec) / 1000000; if (ms > el) usleep((ms - el) * 1000);
+		std::string o = op;
+		if (o == "exit") { fflush(stdout); if (getenv("REGFAKE_STATS")) fprintf(stderr, "reg_calls=%ld opens=%ld notifies=%ld\n", (long)g_reg_calls, (long)g_opens, (long)g_notifies); _exit(0); }
+		std::lock_guard<std::mutex> l(reg_mutex);
+		wstr p = W(path); for (auto &c : p) if (c == '/') c = '\\';
+		if (o == "mk") { walk(&roots[1], (LPCWSTR)p.c_str(), true); continue; }
+		auto n = walk(&roots[1], (LPCWSTR)p.c_str(), false); if (!n) continue;
+		wstr nm = std::string(name) == "@" ? wstr() : W(name);
+		if (o == "rm") { del_tree(n); n->deleted = true; auto &c = n->parent->children; c.erase(std::find(c.begin(), c.end(), n)); touch(n->parent); }
+		else if (o == "delv") { for (auto i = n->values.begin(); i != n->values.end(); ++i) if (ieq(i->name, nm)) { n->values.erase(i); touch(n); break; } }
+		else if (o == "set" || o == "str") {
+			std::vector<BYTE> d; DWORD type;
+			if (o == "set") { DWORD v = strtoul(data, 0, 0); d.assign((BYTE*)&v, (BYTE*)&v + 4); type = 4; } else { wstr w = W(data); d.assign((BYTE*)w.c_str(), (BYTE*)(w.c_str() + w.size() + 1)); type = 1; }
+			bool found = false; for (auto &v : n->values) if (ieq(v.name, nm)) { v.type = type; v.data = d; found = true; }
+			if (!found) n->values.push_back({nm, type, d});
+			touch(n);
+		}
+	}
+	return 0;
+}
+
+extern int wmain(int, wchar_t**);
+int main(int argc, char **argv) {
+	// several commands in one process (sharing the fake registry) separated by "++"
+	int r = 0;
+	if (auto f = getenv("REGFAKE_SCRIPT")) { pthread_t t; pthread_create(&t, 0, script, (void*)f); }
+	for (int a = 1; a <= argc;) {
+		std::vector<wstr> w; std::vector<wchar_t*> p;
+		w.push_back(W("reg"));
+		int b = a;
+		for (; b < argc && strcmp(argv[b], "++"); b++) w.push_back(W(argv[b]));
+		for (auto &s : w) p.push_back((wchar_t*)&s[0]);
+		p.push_back(nullptr);
+		r = wmain(w.size(), p.data());
+		fflush(stdout);
+		a = b + 1;
+		if (a > argc - 0 && b >= argc) break;
+	}
+	if (getenv("REGFAKE_STATS")) fprintf(stderr, "reg_calls=%ld opens=%ld connects=%ld writes=%ld\n", (long)g_reg_calls, (long)g_opens, (long)g_connects, (long)g_writes);
+	return r;
+}
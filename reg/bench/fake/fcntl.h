@@ -0,0 +1,4 @@
+#pragma once
+#define _O_U8TEXT 0x40000
+#define _O_U16TEXT 0x20000
+#define _O_BINARY 0x8000
@@ -0,0 +1,4 @@
+#pragma once
+#include <cpuid.h>
+#undef __cpuid
+inline void __cpuid(int info[4], int leaf) { unsigned a, b, c, d; __get_cpuid(leaf, &a, &b, &c, &d); info[0] = a; info[1] = b; info[2] = c; info[3] = d; }
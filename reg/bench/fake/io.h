@@ -0,0 +1,2 @@
+#pragma once
+extern "C" { int _setmode(int, int); int _fileno(FILE*); }
@@ -0,0 +1,44 @@
+#pragma once
+// force-included with -fshort-wchar: glibc's wcs* functions assume a 32-bit wchar_t, so these replace them
+#include <wchar.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+inline size_t r16_wcslen(const wchar_t *s) { const wchar_t *p = s; while (*p) ++p; return p - s; }
+inline wchar_t *r16_wcschr(const wchar_t *s, wchar_t c) { for (;; ++s) { if (*s == c) return (wchar_t*)s; if (!*s) return nullptr; } }
+inline int r16_wcscmp(const wchar_t *a, const wchar_t *b) { while (*a && *a == *b) ++a, ++b; return (int)*a - (int)*b; }
+inline int r16_wcsncmp(const wchar_t *a, const wchar_t *b, size_t n) { while (n && *a && *a == *b) ++a, ++b, --n; return n ? (int)*a - (int)*b : 0; }
+inline wchar_t r16_lower(wchar_t c) { return c >= 'A' && c <= 'Z' ? c + 32 : c; }
+inline int r16_wcsicmp(const wchar_t *a, const wchar_t *b) { while (*a && r16_lower(*a) == r16_lower(*b)) ++a, ++b; return (int)r16_lower(*a) - (int)r16_lower(*b); }
+inline int r16_wcsnicmp(const wchar_t *a, const wchar_t *b, size_t n) { while (n && *a && r16_lower(*a) == r16_lower(*b)) ++a, ++b, --n; return n ? (int)r16_lower(*a) - (int)r16_lower(*b) : 0; }
+inline wchar_t *r16_wcscpy(wchar_t *d, const wchar_t *s) { auto r = d; while ((*d++ = *s++)); return r; }
+inline unsigned long long r16_wcstoull(const wchar_t *s, wchar_t **e, int base) {
+	char buf[80]; int i = 0; const wchar_t *p = s; while (*p && i < 79) { if (*p > 127) break; buf[i++] = (char)*p++; } buf[i] = 0;
+	char *ce; auto v = strtoull(buf, &ce, base); if (e) *e = (wchar_t*)s + (ce - buf); return v;
+}
+inline long long r16_wcstoll(const wchar_t *s, wchar_t **e, int base) {
+	char buf[80]; int i = 0; const wchar_t *p = s; while (*p && i < 79) { if (*p > 127) break; buf[i++] = (char)*p++; } buf[i] = 0;
+	char *ce; auto v = strtoll(buf, &ce, base); if (e) *e = (wchar_t*)s + (ce - buf); return v;
+}
+#define wcslen r16_wcslen
+#define wcschr r16_wcschr
+#define wcscmp r16_wcscmp
+#define wcsncmp r16_wcsncmp
+#define _wcsicmp r16_wcsicmp
+#define _wcsnicmp r16_wcsnicmp
+#define wcscpy r16_wcscpy
+#define wcstoul(s, e, b) ((uint32_t)r16_wcstoull(s, e, b))
+#define wcstoull r16_wcstoull
+#define wcstol(s, e, b) ((int32_t)r16_wcstoll(s, e, b))
+#define wcstoll r16_wcstoll
+#define _wtoi(s) ((int)r16_wcstoll(s, nullptr, 10))
+#include <wctype.h>
+static inline unsigned short shim_towlower(unsigned short c) { return (unsigned short)towlower((wint_t)c); }
+#define towlower(c) shim_towlower(c)
@@ -0,0 +1,186 @@
+#pragma once
+// just the Win32 declarations reg.cpp uses, implemented by fake.cpp
+#include <stdint.h>
+#include <stddef.h>
+#include <wchar.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+typedef void *HANDLE; typedef struct HKEY__ *HKEY; typedef HKEY *PHKEY;
+typedef uint32_t DWORD; typedef DWORD *LPDWORD; typedef unsigned char BYTE; typedef BYTE *LPBYTE;
+typedef int32_t LONG; typedef int BOOL; typedef DWORD REGSAM; typedef wchar_t WCHAR; typedef wchar_t *LPWSTR; typedef const wchar_t *LPCWSTR;
+typedef unsigned short WORD; typedef uint64_t ULONGLONG; typedef int64_t LONGLONG; typedef void *LPVOID; typedef const void *LPCVOID;
+typedef int32_t LSTATUS; typedef int64_t LONG64; typedef uintptr_t ULONG_PTR; typedef ULONG_PTR SIZE_T; typedef unsigned int UINT; typedef uint32_t ULONG;
+typedef struct { DWORD dwLowDateTime, dwHighDateTime; } FILETIME, *PFILETIME;
+typedef union { struct { DWORD LowPart; LONG HighPart; }; LONGLONG QuadPart; } LARGE_INTEGER;
+typedef union { struct { DWORD LowPart; DWORD HighPart; }; ULONGLONG QuadPart; } ULARGE_INTEGER;
+typedef struct { DWORD nLength; void *lpSecurityDescriptor; BOOL bInheritHandle; } SECURITY_ATTRIBUTES, *LPSECURITY_ATTRIBUTES;
+#include <pthread.h>
+typedef struct { pthread_mutex_t m; } SRWLOCK, *PSRWLOCK; typedef struct { pthread_cond_t c; } CONDITION_VARIABLE, *PCONDITION_VARIABLE;
+#define SRWLOCK_INIT {PTHREAD_MUTEX_INITIALIZER}
+#define CONDITION_VARIABLE_INIT {PTHREAD_COND_INITIALIZER}
+typedef struct { DWORD dwOemId; DWORD dwPageSize; void *a,*b; ULONG_PTR mask; DWORD dwNumberOfProcessors; DWORD t; DWORD dwAllocationGranularity; WORD l, r; } SYSTEM_INFO;
+typedef DWORD (*LPTHREAD_START_ROUTINE)(LPVOID);
+#define WINAPI
+#define CALLBACK
+#define MAX_PATH 260
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+#define INFINITE 0xffffffff
+#define ERROR_SUCCESS 0L
+#define ERROR_FILE_NOT_FOUND 2L
+#define ERROR_ACCESS_DENIED 5L
+#define ERROR_INVALID_FUNCTION 1L
+#define ERROR_INVALID_DATA 13L
+#define ERROR_OUTOFMEMORY 14L
+#define ERROR_BAD_FORMAT 11L
+#define ERROR_NOT_ENOUGH_MEMORY 8
+#define ERROR_MORE_DATA 234L
+#define ERROR_NO_MORE_ITEMS 259L
+#define ERROR_INVALID_PARAMETER 87L
+#define ERROR_NOT_SUPPORTED 50L
+#define ERROR_HANDLE_EOF 38L
+#define ERROR_KEY_DELETED 1018L
+#define ERROR_BADKEY 1010L
+#define ERROR_FILE_INVALID 1006L
+#define ERROR_ALREADY_EXISTS 183L
+#define ERROR_WRITE_FAULT 29L
+#define ERROR_TIMEOUT 1460L
+#define ERROR_BAD_LENGTH 24L
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258L
+#define WAIT_FAILED 0xffffffff
+#define KEY_READ 0x20019
+#define KEY_ALL_ACCESS 0xf003f
+#define KEY_WOW64_32KEY 0x200
+#define KEY_WOW64_64KEY 0x100
+#define KEY_NOTIFY 0x10
+#define KEY_QUERY_VALUE 1
+#define KEY_ENUMERATE_SUB_KEYS 8
+#define REG_OPTION_NON_VOLATILE 0
+#define REG_NOTIFY_CHANGE_NAME 1
+#define REG_NOTIFY_CHANGE_LAST_SET 4
+#define REG_NOTIFY_THREAD_AGNOSTIC 0x10000000
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 1
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define OPEN_ALWAYS 4
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+#define FILE_FLAG_DELETE_ON_CLOSE 0x04000000
+#define FILE_ATTRIBUTE_TEMPORARY 0x100
+#define FILE_BEGIN 0
+#define FILE_CURRENT 1
+#define FILE_END 2
+#define PAGE_READONLY 2
+#define PAGE_READWRITE 4
+#define FILE_MAP_READ 4
+#define FILE_MAP_WRITE 2
+#define STD_INPUT_HANDLE ((DWORD)-10)
+#define STD_OUTPUT_HANDLE ((DWORD)-11)
+#define FORMAT_MESSAGE_FROM_SYSTEM 0x1000
+#define FORMAT_MESSAGE_ALLOCATE_BUFFER 0x100
+#define CP_UTF8 65001
+#define IS_HIGH_SURROGATE(c) ((c) >= 0xd800 && (c) <= 0xdbff)
+#define HEAP_ZERO_MEMORY 8
+#define TRUE 1
+#define FALSE 0
+extern "C" {
+HANDLE CreateFileW(LPCWSTR, DWORD, DWORD, LPSECURITY_ATTRIBUTES, DWORD, DWORD, HANDLE);
+#define CreateFile CreateFileW
+BOOL CloseHandle(HANDLE);
+BOOL FlushFileBuffers(HANDLE);
+BOOL WriteFile(HANDLE, LPCVOID, DWORD, LPDWORD, void*);
+BOOL GetConsoleMode(HANDLE, LPDWORD);
+BOOL WriteConsoleW(HANDLE, const void*, DWORD, LPDWORD, void*);
+BOOL ReadFile(HANDLE, LPVOID, DWORD, LPDWORD, void*);
+BOOL GetFileSizeEx(HANDLE, LARGE_INTEGER*);
+typedef struct { DWORD dwFileAttributes; FILETIME ftCreationTime, ftLastAccessTime, ftLastWriteTime; DWORD dwVolumeSerialNumber, nFileSizeHigh, nFileSizeLow, nNumberOfLinks, nFileIndexHigh, nFileIndexLow; } BY_HANDLE_FILE_INFORMATION, *LPBY_HANDLE_FILE_INFORMATION;
+BOOL GetFileInformationByHandle(HANDLE, LPBY_HANDLE_FILE_INFORMATION);
+BOOL SetFilePointerEx(HANDLE, LARGE_INTEGER, LARGE_INTEGER*, DWORD);
+HANDLE CreateFileMappingW(HANDLE, LPSECURITY_ATTRIBUTES, DWORD, DWORD, DWORD, LPCWSTR);
+#define CreateFileMapping CreateFileMappingW
+LPVOID MapViewOfFile(HANDLE, DWORD, DWORD, DWORD, SIZE_T);
+BOOL UnmapViewOfFile(LPCVOID);
+HANDLE GetStdHandle(DWORD);
+DWORD GetLastError();
+void GetSystemInfo(SYSTEM_INFO*);
+DWORD GetTickCount();
+ULONGLONG GetTickCount64();
+BOOL QueryPerformanceCounter(LARGE_INTEGER*);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER*);
+void Sleep(DWORD);
+void GetSystemTimeAsFileTime(FILETIME*);
+HANDLE CreateThread(LPSECURITY_ATTRIBUTES, SIZE_T, LPTHREAD_START_ROUTINE, LPVOID, DWORD, DWORD*);
+DWORD WaitForSingleObject(HANDLE, DWORD);
+DWORD WaitForMultipleObjects(DWORD, const HANDLE*, BOOL, DWORD);
+HANDLE CreateEventW(LPSECURITY_ATTRIBUTES, BOOL, BOOL, LPCWSTR);
+#define CreateEvent CreateEventW
+BOOL SetEvent(HANDLE);
+BOOL ResetEvent(HANDLE);
+void InitializeSRWLock(PSRWLOCK);
+void AcquireSRWLockExclusive(PSRWLOCK);
+void ReleaseSRWLockExclusive(PSRWLOCK);
+void AcquireSRWLockShared(PSRWLOCK);
+void ReleaseSRWLockShared(PSRWLOCK);
+void InitializeConditionVariable(PCONDITION_VARIABLE);
+BOOL SleepConditionVariableSRW(PCONDITION_VARIABLE, PSRWLOCK, DWORD, ULONG);
+void WakeConditionVariable(PCONDITION_VARIABLE);
+void WakeAllConditionVariable(PCONDITION_VARIABLE);
+LONG InterlockedIncrement(LONG volatile*);
+LONG InterlockedDecrement(LONG volatile*);
+LONG InterlockedExchangeAdd(LONG volatile*, LONG);
+LONG InterlockedCompareExchange(LONG volatile*, LONG, LONG);
+void* InterlockedCompareExchangePointer(void* volatile*, void*, void*);
+LONG64 InterlockedExchangeAdd64(LONGLONG volatile*, LONGLONG);
+int WideCharToMultiByte(UINT, DWORD, LPCWSTR, int, char*, int, const char*, BOOL*);
+int MultiByteToWideChar(UINT, DWORD, const char*, int, LPWSTR, int);
+DWORD FormatMessageW(DWORD, LPCVOID, DWORD, DWORD, LPWSTR, DWORD, void*);
+DWORD GetTempPathW(DWORD, LPWSTR);
+LSTATUS RegOpenKeyExW(HKEY, LPCWSTR, DWORD, REGSAM, PHKEY);
+#define RegOpenKeyEx RegOpenKeyExW
+LSTATUS RegCreateKeyExW(HKEY, LPCWSTR, DWORD, LPWSTR, DWORD, REGSAM, LPSECURITY_ATTRIBUTES, PHKEY, LPDWORD);
+#define RegCreateKeyEx RegCreateKeyExW
+LSTATUS RegDeleteKeyExW(HKEY, LPCWSTR, REGSAM, DWORD);
+#define RegDeleteKeyEx RegDeleteKeyExW
+LSTATUS RegDeleteTreeW(HKEY, LPCWSTR);
+#define RegDeleteTree RegDeleteTreeW
+LSTATUS RegCloseKey(HKEY);
+LSTATUS RegConnectRegistryW(LPCWSTR, HKEY, PHKEY);
+#define RegConnectRegistry RegConnectRegistryW
+LSTATUS RegQueryInfoKeyW(HKEY, LPWSTR, LPDWORD, LPDWORD, LPDWORD, LPDWORD, LPDWORD, LPDWORD, LPDWORD, LPDWORD, LPDWORD, PFILETIME);
+#define RegQueryInfoKey RegQueryInfoKeyW
+typedef DWORD SECURITY_INFORMATION;
+#define LCMAP_UPPERCASE 0x200
+#define LOCALE_NAME_INVARIANT L""
+int LCMapStringEx(LPCWSTR, DWORD, LPCWSTR, int, LPWSTR, int, void*, void*, intptr_t);
+typedef void *PSECURITY_DESCRIPTOR;
+#define OWNER_SECURITY_INFORMATION 1
+#define GROUP_SECURITY_INFORMATION 2
+#define DACL_SECURITY_INFORMATION 4
+#define ERROR_INSUFFICIENT_BUFFER 122L
+LSTATUS RegGetKeySecurity(HKEY, SECURITY_INFORMATION, PSECURITY_DESCRIPTOR, LPDWORD);
+LSTATUS RegEnumValueW(HKEY, DWORD, LPWSTR, LPDWORD, LPDWORD, LPDWORD, LPBYTE, LPDWORD);
+#define RegEnumValue RegEnumValueW
+LSTATUS RegEnumKeyExW(HKEY, DWORD, LPWSTR, LPDWORD, LPDWORD, LPWSTR, LPDWORD, PFILETIME);
+#define RegEnumKeyEx RegEnumKeyExW
+LSTATUS RegQueryValueExW(HKEY, LPCWSTR, LPDWORD, LPDWORD, LPBYTE, LPDWORD);
+#define RegQueryValueEx RegQueryValueExW
+LSTATUS RegSetValueExW(HKEY, LPCWSTR, DWORD, DWORD, const BYTE*, DWORD);
+#define RegSetValueEx RegSetValueExW
+LSTATUS RegDeleteValueW(HKEY, LPCWSTR);
+#define RegDeleteValue RegDeleteValueW
+LSTATUS RegLoadAppKeyW(LPCWSTR, PHKEY, REGSAM, DWORD, DWORD);
+#define RegLoadAppKey RegLoadAppKeyW
+LSTATUS RegUnLoadKeyW(HKEY, LPCWSTR);
+#define RegUnLoadKey RegUnLoadKeyW
+LSTATUS RegNotifyChangeKeyValue(HKEY, BOOL, DWORD, HANDLE, BOOL);
+uint32_t _byteswap_ulong(uint32_t);
+unsigned long long _byteswap_uint64(unsigned long long);
+unsigned short _byteswap_ushort(unsigned short);
+int _wfopen_s(FILE**, const wchar_t*, const wchar_t*);
+FILE *_wfopen(const wchar_t*, const wchar_t*);
+}
+
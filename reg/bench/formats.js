@@ -0,0 +1,41 @@
+// formats.py in node, with the extension's own regexes for the text format
+const fs = require('fs');
+const PATH_PATTERN	= /^(HKEY_LOCAL_MACHINE|HKEY_CURRENT_USER|HKEY_CLASSES_ROOT|HKEY_USERS|HKEY_CURRENT_CONFIG).*\\(.*)$/;
+const ITEM_PATTERN  = /^\s*(.*?)\s+(REG_[A-Z_]+)(\s+\((.*?)\))?\s*(.*)$/;
+function text() {
+  let keys = 0, vals = 0;
+  for (const line of fs.readFileSync('out_text.txt', 'utf8').split('\n')) {
+    let m;
+    if ((m = ITEM_PATTERN.exec(line))) {
+      let d = m[5];
+      switch (m[2]) {
+        case 'REG_DWORD': case 'REG_QWORD': d = BigInt(d); break;
+        case 'REG_BINARY': d = Buffer.from(d, 'hex'); break;
+        case 'REG_MULTI_SZ': d = d.split('\\0'); break;
+      }
+      vals++;
+    } else if ((m = PATH_PATTERN.exec(line))) keys++;
+  }
+  return [keys, vals];
+}
+function jsonl() {
+  let keys = 0, vals = 0;
+  for (const line of fs.readFileSync('out_jsonl.txt', 'utf8').split('\n')) {
+    if (!line) continue;
+    const r = JSON.parse(line);
+    if (r.key !== undefined) keys++;
+    else if (r.name !== undefined) { let d = r.data; if (d === undefined) { d = Buffer.from(r.raw, "base64"); if (r.type == 7) d = d.toString("utf16le"); } vals++; }
+  }
+  return [keys, vals];
+}
+function binary() {
+  const b = fs.readFileSync('out_binary.bin'); let p = 0, keys = 0, vals = 0;
+  while (p < b.length) {
+    const kind = b.readUInt16LE(p), len = b.readUInt32LE(p + 2); p += 6;
+    if (kind == 0x4b) { b.toString('utf16le', p, p + len); keys++; }
+    else if (kind == 0x56) { const t = b.readUInt32LE(p), nl = b.readUInt32LE(p + 4); b.toString('utf16le', p + 8, p + 8 + nl * 2); let d = b.subarray(p + 8 + nl * 2, p + len); if (t == 1 || t == 2 || t == 7) d = d.toString('utf16le'); else if (t == 4) d = d.readUInt32LE(0); vals++; }
+    p += len + (len & 1);
+  }
+  return [keys, vals];
+}
+for (const f of [text, jsonl, binary]) { for (let i = 0; i < 2; i++) { const s = process.hrtime.bigint(); const r = f(); if (i) console.log(f.name, r, Number(process.hrtime.bigint() - s) / 1e6 + 'ms'); } }
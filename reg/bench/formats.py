@@ -0,0 +1,38 @@
+# times decoding QUERY output in each /format, from out_text.txt, out_jsonl.txt and out_binary.bin, made with e.g.
+#	reg QUERY HKLM\x /s /snapshot t.snap [/format:jsonl|/format:binary] > out_...
+import re, json, struct, base64, sys, time
+ITEM = re.compile(r'^\s+(.*?)\s+(REG_[A-Z_]+)\s*(.*)$')
+def text():
+    keys=vals=0; cur=None
+    for line in open('out_text.txt', encoding='utf-8'):
+        line=line.rstrip('\n')
+        if not line: continue
+        m = ITEM.match(line)
+        if m:
+            name,t,d=m.groups()
+            if t in ('REG_DWORD','REG_QWORD'): d=int(d,16)
+            elif t=='REG_BINARY': d=bytes.fromhex(d)
+            vals+=1
+        else: keys+=1
+    return keys,vals
+def jsonl():
+    keys=vals=0
+    for line in open('out_jsonl.txt', encoding='utf-8'):
+        r=json.loads(line)
+        if 'key' in r: keys+=1
+        elif 'name' in r:
+            d=r['data']
+            if isinstance(d,str): d=base64.b64decode(d)
+            vals+=1
+    return keys,vals
+def binary():
+    b=open('out_binary.bin','rb').read(); p=0; keys=vals=0; n=len(b)
+    while p<n:
+        kind,ln=struct.unpack_from('<HI',b,p); p+=6
+        if kind==0x4b: b[p:p+ln].decode('utf-16le'); keys+=1
+        elif kind==0x56:
+            t,nl=struct.unpack_from('<II',b,p); name=b[p+8:p+8+nl*2].decode('utf-16le'); data=b[p+8+nl*2:p+ln]; vals+=1
+        p+=ln+(ln&1)
+    return keys,vals
+for f in (text,jsonl,binary):
+    s=time.time(); r=f(); print(f.__name__, r, '%.0fms'%((time.time()-s)*1000))
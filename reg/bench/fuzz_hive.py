@@ -0,0 +1,29 @@
+# mutates a hive and runs QUERY, EXPORT and SAVE on it, keeping inputs that crash or hang: fuzz_hive.py file.hiv iterations seed reg
+# build reg with CXXFLAGS="-fsanitize=address,undefined -fno-sanitize=alignment"; CHECK=1 also runs check_hive.py on what SAVE wrote
+import random, subprocess, sys, os
+src = open(sys.argv[1], 'rb').read()
+n = int(sys.argv[2]); rng = random.Random(int(sys.argv[3]))
+bad = 0
+for it in range(n):
+    d = bytearray(src)
+    for _ in range(rng.choice([1, 2, 5, 20, 100])):
+        pos = rng.randrange(4096, len(d)) if rng.random() < 0.97 else rng.randrange(0, 4096)
+        kind = rng.random()
+        if kind < 0.5: d[pos] = rng.randrange(256)
+        elif kind < 0.8 and pos + 4 <= len(d): d[pos:pos+4] = rng.choice([b'\xff\xff\xff\xff', b'\x00\x00\x00\x00', b'\x20\x00\x00\x00', b'\xff\xff\xff\x7f', b'\x00\x00\x00\x80', bytes(rng.randrange(256) for _ in range(4))])
+        else:
+            # point a dword at another cell start
+            if pos + 4 <= len(d): d[pos:pos+4] = (rng.randrange(0, len(d) - 4096) & ~7).to_bytes(4, 'little')
+    open('fz.hiv', 'wb').write(d)
+    for args in (['QUERY', 'HKLM\\SOFTWARE', '/hive', 'fz.hiv', '/s'], ['EXPORT', 'HKLM\\SOFTWARE', 'fz.reg', '/hive', 'fz.hiv', '/threads', '2'], ['QUERY', 'HKCU', '/hive', 'fz.hiv', '/s', '/f', 'a', '/format:jsonl'], ['SAVE', 'HKLM\\SOFTWARE', 'fz.sv.hiv', '/hive', 'fz.hiv']):
+        try:
+            r = subprocess.run([sys.argv[4]] + args, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, timeout=20)
+            if r.returncode < 0 or b'ERROR: AddressSanitizer' in r.stderr or b'runtime error' in r.stderr:
+                bad += 1; open('crash%d.hiv' % bad, 'wb').write(d); print('CRASH', it, args[0], r.returncode, r.stderr[-600:].decode(errors='replace'))
+        except subprocess.TimeoutExpired:
+            bad += 1; open('hang%d.hiv' % bad, 'wb').write(d); print('HANG', it, args[0])
+    if os.environ.get('CHECK') and os.path.exists('fz.sv.hiv'):
+        c = subprocess.run(['python3', os.path.join(os.path.dirname(os.path.abspath(__file__)), 'check_hive.py'), 'fz.sv.hiv'], capture_output=True, text=True)
+        if not c.stdout.rstrip().endswith('OK'): bad += 1; open('badsave%d.hiv' % bad, 'wb').write(d); print('BADSAVE', it, c.stdout[-400:])
+        os.remove('fz.sv.hiv')
+print('done', n, 'bad', bad)
@@ -0,0 +1,21 @@
+# mutates a snapshot (header offsets and record fields included) and runs QUERY, SAVE and IMPORT on it: fuzz_snapshot.py file.snap iterations seed reg
+import random, subprocess, sys
+src = open(sys.argv[1], 'rb').read()
+n = int(sys.argv[2]); rng = random.Random(int(sys.argv[3]))
+bad = 0
+for it in range(n):
+    d = bytearray(src)
+    for _ in range(rng.choice([1, 2, 5, 20])):
+        pos = rng.randrange(8, len(d) - 8) & ~3 if rng.random() < 0.9 else rng.randrange(8, 56) & ~7
+        v = rng.choice([0xfffffffffffffff0, 0xfffffffffffffffc, 0xffffffff, 0xfffffffe, 0x80000000, rng.randrange(1 << 64), rng.randrange(len(d))])
+        w = rng.choice([4, 8])
+        d[pos:pos+w] = (v & ((1 << (8 * w)) - 1)).to_bytes(w, 'little')
+    open('fz.snap', 'wb').write(d)
+    for args in (['QUERY', 'HKLM\\x', '/snapshot', 'fz.snap', '/s'], ['SAVE', 'HKLM\\x', 'fz.sv.hiv', '/y', '/import', 'fz.snap'], ['QUERY', 'HKLM\\x', '/snapshot', 'fz.snap', '/s', '/f', 'ab'], ['QUERY', 'HKLM\\x', '/snapshot', 'fz.snap', '/s', '/f', 'Eta', '/k'], ['IMPORT', 'fz.snap']):
+        try:
+            r = subprocess.run([sys.argv[4]] + args, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, timeout=20)
+        except subprocess.TimeoutExpired:
+            bad += 1; open('hang%d.snap' % bad, 'wb').write(d); print('HANG', it, args[0]); break
+        if r.returncode < 0 or b'ERROR: AddressSanitizer' in r.stderr or b'runtime error' in r.stderr:
+            bad += 1; open('crash%d.snap' % bad, 'wb').write(d); print('CRASH', it, args[0], r.returncode, r.stderr[-300:].decode(errors='replace')); break
+print('done', n, 'bad', bad)
@@ -0,0 +1,195 @@
+# writes a regf hive (and optionally the same tree as a .reg) from a pseudo-random tree:
+#	gen_hive.py seed depth fanout values big_every key_budget out.hiv [out.reg]
+# big_every > 0 makes every nth binary value big enough for a db; FRAG=0.3 leaves free holes between cells
+import struct, random, sys, os
+
+MAX_SEG = 16344
+
+class Key:
+    def __init__(s, name):
+        s.name = name; s.values = []; s.subkeys = []; s.last_write = 0
+
+def gen_tree(rng, depth, fan, nvals, big_every, budget):
+    names_pool = ['Alpha', 'beta', 'Gamma', 'Delta', 'epsilon', 'Zeta', 'Eta', 'Theta', 'Café', 'Ωmega', '日本', 'Key', 'Data', 'Control', 'Services']
+    counter = [0]
+    def mk(d):
+        k = Key(None)
+        k.last_write = 0x01D0000000000000 + rng.randrange(1 << 40)
+        for i in range(rng.randrange(nvals + 1)):
+            counter[0] += 1
+            t = rng.choice([1, 1, 4, 4, 3, 3, 7, 2, 11, 0])
+            name = '' if i == 0 and rng.random() < 0.3 and not os.environ.get('NODEFAULT') else rng.choice(names_pool) + str(i)
+            if t in (1, 2):
+                data = ('text %d %s \\path "q"' % (counter[0], rng.choice(names_pool))).encode('utf-16-le') + b'\0\0'
+            elif t == 4:
+                data = struct.pack('<I', rng.randrange(1 << 32))
+            elif t == 11:
+                data = struct.pack('<Q', rng.randrange(1 << 64))
+            elif t == 7:
+                data = 'one\0two\0\0'.encode('utf-16-le')
+            elif t == 0:
+                data = bytes(rng.randrange(0, 5))
+            else:
+                n = rng.choice([1, 2, 3, 4, 10, 40, 200])
+                if big_every and counter[0] % big_every == 0:
+                    n = rng.randrange(MAX_SEG + 1, 70000)
+                data = bytes(rng.randrange(256) for _ in range(n)) if n < 1000 else (bytes(range(256)) * (n // 256 + 1))[:n]
+            if data == b'' and t != 0:
+                continue
+            if any(v[0].upper() == name.upper() for v in k.values):
+                continue
+            k.values.append((name, t, data))
+        if d > 0 and budget[0] > 0:
+            n = rng.randrange(fan + 1) if d > 1 else rng.randrange(fan // 2 + 1)
+            if rng.random() < 0.05:
+                n = 60   # enough for an ri
+            used = set()
+            for i in range(n):
+                budget[0] -= 1
+                nm = rng.choice(names_pool) + str(rng.randrange(1000))
+                if nm.upper() in used:
+                    continue
+                used.add(nm.upper())
+                c = mk(d - 1)
+                c.name = nm
+                k.subkeys.append(c)
+            k.subkeys.sort(key=lambda c: c.name.upper())
+        return k
+    root = mk(depth)
+    root.name = 'CMI-CreateHive{TEST}'
+    return root
+
+def compressible(s):
+    return all(ord(c) < 256 for c in s)
+
+def encname(s):
+    return (s.encode('latin-1'), True) if compressible(s) else (s.encode('utf-16-le'), False)
+
+class Writer:
+    def __init__(s):
+        s.bins = bytearray(); s.bin_start = 0; s.bin_end = 0; s.nbins = 0
+    def new_bin(s, need):
+        size = max(4096, (need + 32 + 4095) // 4096 * 4096)
+        s.close_bin()
+        s.bin_start = len(s.bins); s.bin_end = s.bin_start + size
+        s.bins += b'hbin' + struct.pack('<III', s.bin_start, size, 0) + bytes(16)
+        s.nbins += 1
+    def close_bin(s):
+        if s.bin_end > len(s.bins):
+            free = s.bin_end - len(s.bins)
+            s.bins += struct.pack('<i', free) + bytes(free - 4)
+    def alloc(s, payload):
+        frag = float(os.environ.get('FRAG', '0'))
+        if frag and random.random() < frag:
+            hole = random.randrange(1, 64) * 8
+            if len(s.bins) + hole <= s.bin_end:
+                s.bins += struct.pack('<i', hole) + bytes(hole - 4)
+        size = (len(payload) + 4 + 7) & ~7
+        if len(s.bins) + size > s.bin_end:
+            s.new_bin(size)
+        off = len(s.bins)
+        s.bins += struct.pack('<i', -size) + payload + bytes(size - 4 - len(payload))
+        return off
+    def patch(s, off, fmt, *v):
+        struct.pack_into(fmt, s.bins, off + 4, *v)
+
+def lh_hash(name):
+    h = 0
+    for c in name.upper():
+        h = (h * 37 + ord(c)) & 0xffffffff
+    return h
+
+def write_hive(root, path, rng, minor=5):
+    w = Writer()
+    w.new_bin(0)
+    sk_desc = bytes.fromhex('0100048000000000000000000000000014000000020008000000000000000000')
+    sk = w.alloc(b'sk' + bytes(2) + struct.pack('<IIII', 0, 0, 1, len(sk_desc)) + sk_desc)
+    w.patch(sk, '<II', sk, sk)
+    stats = {'keys': 0, 'values': 0, 'db': 0, 'ri': 0, 'lf': 0, 'lh': 0, 'li': 0, 'utf16': 0}
+    def write_key(k, parent, is_root):
+        stats['keys'] += 1
+        nm, comp = encname(k.name)
+        if not comp: stats['utf16'] += 1
+        flags = (0x2c if is_root else 0) | (0x20 if comp else 0)
+        nk = w.alloc(b'nk' + struct.pack('<HQIIIIIIIIIIIIIIIHH', flags, k.last_write, 0, parent, len(k.subkeys), 0, 0xffffffff, 0xffffffff,
+            len(k.values), 0xffffffff, sk, 0xffffffff, 0, 0, 0, 0, 0, len(nm), 0) + nm)
+        # values next to their key
+        voffs = []
+        maxd = maxn = 0
+        for (name, t, data) in k.values:
+            stats['values'] += 1
+            vn, vcomp = encname(name)
+            maxd = max(maxd, len(data)); maxn = max(maxn, len(name) * 2)
+            if len(data) <= 4:
+                size = len(data) | 0x80000000; doff = struct.unpack('<I', data.ljust(4, b'\0'))[0]
+            elif len(data) > MAX_SEG and minor >= 4:
+                stats['db'] += 1
+                segs = [w.alloc(data[i:i + MAX_SEG]) for i in range(0, len(data), MAX_SEG)]
+                lst = w.alloc(b''.join(struct.pack('<I', x) for x in segs))
+                doff = w.alloc(b'db' + struct.pack('<HI', len(segs), lst)); size = len(data)
+            else:
+                doff = w.alloc(data); size = len(data)
+            voffs.append(w.alloc(b'vk' + struct.pack('<HIIIHH', len(vn), size, doff, t, 1 if vcomp else 0, 0) + vn))
+        vlist = w.alloc(b''.join(struct.pack('<I', x) for x in voffs)) if voffs else 0xffffffff
+        subs = [write_key(c, nk, False) for c in k.subkeys]
+        slist = 0xffffffff
+        if subs:
+            def simple(items, kind):
+                stats[kind] += 1
+                if kind == 'li':
+                    return w.alloc(b'li' + struct.pack('<H', len(items)) + b''.join(struct.pack('<I', o) for o, c in items))
+                hint = (lambda c: lh_hash(c.name)) if kind == 'lh' else (lambda c: struct.unpack('<I', c.name.encode('latin-1', 'replace')[:4].ljust(4, b'\0'))[0])
+                return w.alloc(kind.encode() + struct.pack('<H', len(items)) + b''.join(struct.pack('<II', o, hint(c)) for o, c in items))
+            items = list(zip(subs, k.subkeys))
+            if len(items) > 40:
+                stats['ri'] += 1
+                parts = [simple(items[i:i + 16], rng.choice(['lh', 'li', 'lf'])) for i in range(0, len(items), 16)]
+                slist = w.alloc(b'ri' + struct.pack('<H', len(parts)) + b''.join(struct.pack('<I', p) for p in parts))
+            else:
+                slist = simple(items, rng.choice(['lh', 'lh', 'lf', 'li']))
+        maxsn = max([len(c.name) * 2 for c in k.subkeys] or [0])
+        w.patch(nk, '<HHQIIIIIIIIIIIIII', 0x6b6e, flags, k.last_write, 0, parent, len(k.subkeys), 0, slist, 0xffffffff, len(k.values), vlist, sk, 0xffffffff, maxsn, 0, maxn, maxd)
+        return nk
+    root_off = write_key(root, 0xffffffff, True)
+    w.close_bin()
+    base = bytearray(4096)
+    struct.pack_into('<4sIIQIIIIIII', base, 0, b'regf', 1, 1, 0x01D0000000000000, 1, minor, 0, 1, root_off, len(w.bins), 1)
+    base[48:48 + 16] = 'test.hiv'.encode('utf-16-le')
+    cs = 0
+    for i in range(127):
+        cs ^= struct.unpack_from('<I', base, i * 4)[0]
+    struct.pack_into('<I', base, 508, cs)
+    with open(path, 'wb') as f:
+        f.write(base); f.write(w.bins)
+    return stats
+
+def reg_escape(s):
+    return s.replace('\\', '\\\\').replace('"', '\\"')
+
+def write_reg(root, mount, path):
+    out = ['Windows Registry Editor Version 5.00', '']
+    def emit(k, p):
+        out.append('[%s]' % p)
+        for (name, t, data) in k.values:
+            n = '@' if name == '' else '"%s"' % reg_escape(name)
+            if t == 1 and len(data) >= 2 and data[-2:] == b'\0\0' and '\0' not in data[:-2].decode('utf-16-le'):
+                out.append('%s="%s"' % (n, reg_escape(data[:-2].decode('utf-16-le'))))
+            elif t == 4:
+                out.append('%s=dword:%08x' % (n, struct.unpack('<I', data)[0]))
+            else:
+                out.append('%s=hex(%x):%s' % (n, t, ','.join('%02x' % b for b in data)))
+        out.append('')
+        for c in k.subkeys:
+            emit(c, p + '\\' + c.name)
+    emit(root, mount)
+    with open(path, 'w', encoding='utf-16') as f:
+        f.write('\r\n'.join(out) + '\r\n')
+
+if __name__ == '__main__':
+    seed, depth, fan, nvals, big, budget = (int(x) for x in sys.argv[1:7])
+    rng = random.Random(seed)
+    root = gen_tree(rng, depth, fan, nvals, big, [budget])
+    st = write_hive(root, sys.argv[7], rng)
+    if len(sys.argv) > 8:
+        write_reg(root, 'HKEY_LOCAL_MACHINE\\SOFTWARE', sys.argv[8])
+    print(st)
@@ -0,0 +1,10 @@
+# writes a .reg whose keys are all on \\remote (n^3 of them, each with one value) for IMPORT through the key cache and
+# connection pool: gen_remote.py out.reg [n]; run the IMPORT with REGFAKE_SEED=3,n,0 so the keys exist, and REGFAKE_STATS=1
+import sys
+n = int(sys.argv[2]) if len(sys.argv) > 2 else 37
+lines = ['Windows Registry Editor Version 5.00', '']
+for a in range(n):
+    for b in range(n):
+        for c in range(n):
+            lines += [f'[\\\\remote\\HKEY_CURRENT_USER\\Software\\Key{a}\\Key{b}\\Key{c}]', f'"Imported"=dword:{(a * n + b) * n + c:08x}', '']
+open(sys.argv[1], 'w', encoding='utf-16', newline='').write('\r\n'.join(lines))
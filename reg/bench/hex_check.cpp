@@ -0,0 +1,84 @@
+// checks decode_hex against a plain scalar loop on random hex: text, then times both on 20M bytes of .reg-style hex
+#include "hex.h"
+#include <cstring>
+#include <stdio.h>
+#include <random>
+#include <vector>
+#include <time.h>
+
+// the loop decode_hex replaced
+byte *scalar(const wchar_t *s, const wchar_t *e, byte *d) {
+	while (s < e) {
+		auto	c = *s++;
+		if (c == ',' || c == '\\' || is_whitespace(c))
+			continue;
+		auto	d0 = hexchar(c);
+		if (d0 < 0)
+			break;
+		auto	d1 = s < e ? hexchar(*s) : -1;
+		if (d1 >= 0) {
+			d0 = (d0 << 4) | d1;
+			++s;
+		}
+		*d++ = d0;
+	}
+	return d;
+}
+
+int main() {
+	std::mt19937	rng(1);
+	const char		*alpha = "0123456789abcdefABCDEF,,, \\\r\nxZ";
+
+	for (int t = 0; t < 200000; t++) {
+		// odd runs are anything from alpha; even ones are regular hex: with the odd line break and stray char
+		std::vector<wchar_t>	s;
+		int		n		= rng() % 200;
+		bool	regular	= t & 1;
+		for (int i = 0; i < n; i++) {
+			if (regular) {
+				s.push_back("0123456789abcdef"[rng() % 16]);
+				s.push_back("0123456789ABCDEF"[rng() % 16]);
+				s.push_back(',');
+				if (rng() % 30 == 0) {
+					for (auto c : L"\\\r\n  ")
+						if (c)
+							s.push_back(c);
+				}
+				if (rng() % 500 == 0)
+					s.push_back(alpha[rng() % 32]);
+			} else {
+				s.push_back(alpha[rng() % 32]);
+			}
+		}
+		std::vector<byte>	a(s.size() + 2), b(s.size() + 2);
+		auto	ea = scalar(s.data(), s.data() + s.size(), a.data());
+		auto	eb = decode_hex(s.data(), s.data() + s.size(), b.data());
+		if (ea - a.data() != eb - b.data() || memcmp(a.data(), b.data(), ea - a.data())) {
+			printf("mismatch %d: %d bytes against %d\n", t, int(ea - a.data()), int(eb - b.data()));
+			for (auto c : s)
+				putchar(c == '\r' ? 'R' : c == '\n' ? 'N' : c);
+			puts("");
+			return 1;
+		}
+	}
+
+	std::vector<wchar_t>	s;
+	for (int i = 0; i < 20000000; i++) {
+		s.push_back("0123456789abcdef"[i % 16]);
+		s.push_back("0123456789abcdef"[(i / 16) % 16]);
+		s.push_back(',');
+		if (i % 25 == 24) {
+			for (auto c : L"\\\r\n  ")
+				if (c)
+					s.push_back(c);
+		}
+	}
+	std::vector<byte>	out(s.size());
+	for (int k = 0; k < 2; k++) {
+		auto	t0	= clock();
+		auto	e	= k ? decode_hex(s.data(), s.data() + s.size(), out.data()) : scalar(s.data(), s.data() + s.size(), out.data());
+		auto	t1	= clock();
+		printf("%s: %.0f MB/s\n", k ? "decode_hex" : "scalar", (e - out.data()) / 1e6 / ((t1 - t0) / (double)CLOCKS_PER_SEC));
+	}
+	printf("ok\n");
+}
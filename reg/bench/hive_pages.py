@@ -0,0 +1,31 @@
+# counts the 4K pages a depth-first walk of a hive touches, and how often it moves between them: hive_pages.py file.hiv
+import struct, sys
+d = open(sys.argv[1], 'rb').read(); B = d[4096:]
+root = struct.unpack_from('<I', d, 36)[0]
+def sz(o): return -struct.unpack_from('<i', B, o)[0]
+seq = []; keyseq = []
+def touch(o, keys_only=False):
+    seq.append(o >> 12)
+    if keys_only: keyseq.append(o >> 12)
+def leaves(l):
+    touch(l, True); sig = B[l+4:l+6]; cnt = struct.unpack_from('<H', B, l+6)[0]
+    if sig == b'ri':
+        out = []
+        for i in range(cnt): out += leaves(struct.unpack_from('<I', B, l+8+i*4)[0])
+        return out
+    step = 4 if sig == b'li' else 8
+    return [struct.unpack_from('<I', B, l+8+i*step)[0] for i in range(cnt)]
+stack = [root]
+while stack:
+    k = stack.pop(); touch(k, True)
+    nsub, = struct.unpack_from('<I', B, k+4+20); sub, = struct.unpack_from('<I', B, k+4+28)
+    nval, vals = struct.unpack_from('<II', B, k+4+36)
+    if nval:
+        touch(vals)
+        for i in range(nval):
+            v = struct.unpack_from('<I', B, vals+4+i*4)[0]; touch(v)
+            size, data = struct.unpack_from('<II', B, v+4+4)
+            if not size & 0x80000000 and size <= 16344: touch(data)
+    if nsub: stack += list(reversed(leaves(sub)))
+sw = lambda s: sum(1 for a, b in zip(s, s[1:]) if a != b)
+print('%s: walk reads %d, page switches %d, distinct pages %d; keys-only switches %d, distinct pages %d' % (sys.argv[1], len(seq), sw(seq), len(set(seq)), sw(keyseq), len(set(keyseq))))
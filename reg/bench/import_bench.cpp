@@ -0,0 +1,240 @@
+// times parsing a .reg file as IMPORT does now (mapped, entries as views) against the stdio path it replaced (a char at a
+// time into a heap string per line), with no registry calls: import_bench file.reg
+// the old path only reads UTF-16LE with a BOM here (it relied on the CRT's text modes for the rest), as EXPORT writes
+#define wmain orig_wmain
+#include "reg.cpp"
+#undef wmain
+#include <time.h>
+
+static double now() { timespec t; clock_gettime(CLOCK_MONOTONIC, &t); return t.tv_sec + t.tv_nsec * 1e-9; }
+
+struct Counts {
+	uint64_t	keys = 0, values = 0, removes = 0, bytes = 0, sum = 0;
+	void set(string::view name, const byte *data, size_t size) {
+		++values;
+		bytes	+= size;
+		sum		+= name.size() + (size ? data[0] + data[size - 1] : 0);
+	}
+	bool operator==(const Counts &b) const { return keys == b.keys && values == b.values && removes == b.removes && bytes == b.bytes && sum == b.sum; }
+};
+
+//-----------------------------------------------------------------------------
+//	the old path, as it was before IMPORT mapped the file
+//-----------------------------------------------------------------------------
+
+struct FileReader {
+	FILE	*h = nullptr;
+	FileReader(const wchar_t *filename) {
+		if (_wfopen_s(&h, filename, L"rb") == 0) {
+			if (getc(h) == 0xff && getc(h) == 0xfe)
+				return;
+			fseek(h, 0, SEEK_SET);
+		}
+	}
+	~FileReader() { if (h) fclose(h); }
+	template<typename T> bool get(T &t) { return fread(&t, 1, sizeof(T), h) == sizeof(T); }
+};
+
+// string::read_to, except that it starts the buffer again after each 256 chars instead of dropping a char and
+// appending the full buffer again, and stops at the end of the file
+string read_to(FileReader &r, wchar_t terminator) {
+	string  ret;
+	wchar_t buffer[256], *p;
+	wchar_t	c = 0;
+	bool	more;
+
+	do {
+		p = buffer;
+		while ((more = p < ::end(buffer)) && r.get(c) && c != terminator)
+			*p++ = c;
+		ret += string::view(buffer, p - buffer);
+	} while (more ? !feof(r.h) && c != terminator : true);
+
+	return ret;
+}
+
+bool win_getline(FileReader &reader, string &line) {
+	line = read_to(reader, '\n');
+	if (line.empty() && feof(reader.h))
+		return false;
+	if (line.length() && line.back() == '\r')
+		line.pop_back();
+	return true;
+}
+
+// the prefix tests go through view::startsWith: string::startsWith never matched a longer string, so the old path
+// dropped every value that wasn't a string, which would flatter its timing
+void old_parse_reg_data(const string &line, TYPE &type, dynamic_range<byte> &data) {
+	string::view	v = line;
+	if (line[0] == '"') {
+		auto end = line.find_last('"');
+		if (end) {
+			type = TYPE::SZ;
+			auto size = unescape(string::view(line.begin() + 1, end), (wchar_t*)data.ensure((end - line) * 2)) * 2 + 2;
+			data.alloc(size);
+		}
+
+	} else if (v.startsWith(L"dword:"_s)) {
+		type = TYPE::DWORD;
+		*((DWORD*)data.alloc(sizeof(DWORD))) = wcstoul(&line[6], nullptr, 16);
+
+	} else if (v.startsWith(L"qword:"_s)) {
+		type = TYPE::QWORD;
+		*((uint64_t*)data.alloc(sizeof(uint64_t))) = wcstoull(&line[6], nullptr, 16);
+
+	} else if (v.startsWith(L"hex"_s)) {
+		auto p = &line[3];
+		type = TYPE::BINARY;
+
+		if (p[0] == '(') {
+			type = (TYPE)wcstoul(p + 1, (wchar_t**)&p, 16);
+			++p;
+		}
+		if (p[0] == ':')
+			p++;
+
+		for (;;) {
+			wchar_t	*p2;
+			auto v = wcstoul(p, &p2, 16);
+			if (p == p2)
+				break;
+			*data.alloc(1) = v;
+			p = p2;
+			if (*p == ',')
+				++p;
+		}
+	}
+}
+
+Counts old_import(const wchar_t *file) {
+	Counts		c;
+	FileReader	reader(file);
+	string		line;
+	if (!reader.h || !win_getline(reader, line) || line != L"Windows Registry Editor Version 5.00")
+		return c;
+
+	// values under a [-key] are parsed and counted too, as ImportChunk leaves them for the apply step to skip
+	while (win_getline(reader, line)) {
+		line = line.trim();
+		if (line.empty() || line[0] == ';')
+			continue;
+
+		bool	more = line.back() == '\\';
+		if (more) {
+			line.pop_back();
+			for (StringBuilder b(line); more;) {
+				string	line2;
+				if (!win_getline(reader, line2))
+					break;
+				more = line2.length() && line2.back() == '\\';
+				if (more)
+					line2.pop_back();
+				b << line2;
+			}
+		}
+
+		if (line[0] == '[') {
+			++c.keys;
+
+		} else {
+			auto	equals	= line.find_first('=');
+			if (equals) {
+				auto	name	= string::view(line.begin(), equals).trim();
+				auto	value	= string::view(equals + 1, line.end()).trim();
+
+				if (name == L"@"_s)	// read as the default value since SAVE, so the counts compare
+					name = string::view(name.begin(), name.begin());
+				else if (name.size() >= 2 && name[0] == '"' && name.back() == '"')
+					name = string::view(name.begin() + 1, name.end() - 1);
+
+				if (value == L"-"_s) {
+					++c.removes;
+				} else {
+					TYPE				type;
+					dynamic_range<byte>	data;
+					old_parse_reg_data(string(value), type, data);
+					if (data.p != data.a)
+						c.set(string(name), data.a, data.p - data.a);
+				}
+			}
+		}
+	}
+	return c;
+}
+
+//-----------------------------------------------------------------------------
+//	what IMPORT does now
+//-----------------------------------------------------------------------------
+
+void count(Counts &c, const ImportChunk &chunk) {
+	for (auto &i : make_range(chunk.entries.a, chunk.entries.p)) {
+		if (i.kind == ImportChunk::Entry::SET)
+			c.set(i.name, chunk.data.a + i.offset, i.size);
+		else if (i.kind == ImportChunk::Entry::REMOVE)
+			++c.removes;
+		else
+			++c.keys;
+	}
+}
+
+// IMPORT's parser on this thread only
+Counts mapped_import(const wchar_t *file) {
+	Counts		c;
+	RegFileText	reader(file);
+	RegLines	lines(reader.text);
+	string::view	line;
+	if (lines.next(line)) {
+		ImportChunk	chunk(string::view(lines.p, lines.end));
+		chunk.parse();
+		count(c, chunk);
+	}
+	return c;
+}
+
+// IMPORT's parser with its pool, as doIMPORT runs it
+Counts pooled_import(const wchar_t *file) {
+	Counts		c;
+	RegFileText	reader(file);
+	import_reg_text(reader.text, [&c](const ImportChunk &chunk) { count(c, chunk); return 0; });
+	return c;
+}
+
+int wmain(int argc, wchar_t *argv[]) {
+	if (argc < 2) {
+		printf("import_bench file.reg\n");
+		return 1;
+	}
+	WinFileReader	f(argv[1]);
+	LARGE_INTEGER	size;
+	if (!f || !GetFileSizeEx(f.h, &size)) {
+		printf("can't open the file\n");
+		return 1;
+	}
+
+	struct { const char *name; Counts (*f)(const wchar_t*); } paths[] = {
+		{"stdio, per-line strings",	old_import},
+		{"mapped, one thread",		mapped_import},
+		{"mapped, as IMPORT",		pooled_import},
+	};
+	Counts	first;
+	int		ret = 0;
+	for (auto &p : paths) {
+		double	best = 1e30;
+		Counts	c;
+		for (int r = 0; r < 3; r++) {
+			auto t0 = now();
+			c		= p.f(argv[1]);
+			best	= min(best, now() - t0);
+		}
+		printf("%-24s %8.0f ms %7.0f MB/s  keys %llu values %llu removes %llu data %llu bytes\n", p.name, best * 1000, size.QuadPart / best / 1e6,
+			(unsigned long long)c.keys, (unsigned long long)c.values, (unsigned long long)c.removes, (unsigned long long)c.bytes
+		);
+		if (&p == paths)
+			first = c;
+		else if (!(c == first)) {
+			printf("  differs from the stdio path\n");
+			ret = 1;
+		}
+	}
+	return ret;
+}
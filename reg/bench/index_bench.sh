@@ -0,0 +1,37 @@
+#!/bin/sh
+# search index build time, size and query latency, against QUERY /s /f on the registry and on a plain snapshot:
+#	index_bench.sh [reg]	in a scratch directory, with REGFAKE_SEED giving the tree (6,7,5 is 137k keys) and REGFAKE_LATENCY if wanted
+# live times include seeding the fake registry, which the first line measures; snapshot queries run without the seed, and
+# indexed output is checked against the plain snapshot's
+HERE=$(cd "$(dirname "$0")" && pwd)
+R=${1:-$HERE/out/reg}
+KEY='HKCU\Software'
+
+ms() { s=$(date +%s%N); "$@" > /dev/null; e=$(date +%s%N); echo $(( (e - s) / 1000000 )); }
+snap() { env -u REGFAKE_SEED -u REGFAKE_LATENCY $R "$@"; }
+size() { echo $(( $(wc -c < "$1") / 1024 ))K; }
+
+echo "seeding only       $(ms $R QUERY $KEY)ms"
+rm -f plain.snap index.snap
+echo "EXPORT /snapshot   $(ms $R EXPORT $KEY plain.snap /snapshot)ms $(size plain.snap)"
+echo "EXPORT /index      $(ms $R EXPORT $KEY index.snap /index)ms $(size index.snap)"
+echo "  again (refresh)  $(ms $R EXPORT $KEY index.snap /index)ms $(size index.snap)"
+
+while IFS= read -r q; do
+	eval "set -- $q"
+	live=$(ms $R QUERY $KEY /s "$@")
+	plain=$(ms snap QUERY $KEY /s "$@" /snapshot plain.snap)
+	indexed=$(ms snap QUERY $KEY /s "$@" /snapshot index.snap)
+	snap QUERY $KEY /s "$@" /snapshot plain.snap > plain.out
+	snap QUERY $KEY /s "$@" /snapshot index.snap > index.out
+	same=same; cmp -s plain.out index.out || same=DIFFERENT
+	printf '%-28s live %6sms  snapshot %6sms  indexed %6sms  %s lines, %s\n' "$q" $live $plain $indexed $(wc -l < index.out) $same
+done <<'EOF'
+/f 'Key3' /k /e
+/f 'Data 1234'
+/f 'y6' /k
+/f 'quoted' /d /c
+/f '^Data 12+ ' /r /d
+/f Value3 /v /e
+EOF
+rm -f plain.out index.out
@@ -0,0 +1,54 @@
+// checks Regex against std::regex (ECMAScript) on random patterns and texts: regex_check iterations
+#include "regex.h"
+#include <regex>
+#include <string>
+#include <stdio.h>
+#include <chrono>
+static unsigned rs = 12345;
+static unsigned rnd(unsigned n) { rs = rs * 1103515245 + 12345; return (rs >> 8) % n; }
+std::string gen(int depth) {
+	std::string r;
+	int n = 1 + rnd(4);
+	for (int i = 0; i < n; i++) {
+		std::string a;
+		switch (rnd(depth > 2 ? 8 : 11)) {
+			case 0: a = "a"; break; case 1: a = "b"; break; case 2: a = "A"; break; case 3: a = "."; break;
+			case 4: a = "[ab]"; break; case 5: a = "[^a]"; break; case 6: a = "\\d"; break; case 7: a = "[A-Z1]"; break;
+			case 8: a = "(" + gen(depth + 1) + ")"; break;
+			case 9: a = "(?:" + gen(depth + 1) + "|" + gen(depth + 1) + ")"; break;
+			case 10: a = rnd(2) ? "^" : "$"; break;
+		}
+		bool grp = a[0] == '(';
+		if (a != "^" && a != "$") switch (rnd(8)) {
+			case 0: a += grp ? "?" : "*"; break; case 1: a += grp ? "{1,2}" : "+"; break; case 2: a += "?"; break; case 3: a += "{1,2}"; break; case 4: a += "{2}"; break;
+		}
+		r += a;
+	}
+	if (rnd(6) == 0) r += "|" + gen(depth + 1);
+	return r;
+}
+void widen(const std::string &s, wchar_t *w) { for (size_t i = 0; i <= s.size(); i++) w[i] = (unsigned char)s[i]; }
+int main(int argc, char **argv) {
+	const char alpha[] = "abAB1 _x9Z";
+	long checks = 0, bad = 0;
+	wchar_t wp[1024], wt[256];
+	for (int iter = 0, n = argc > 1 ? atoi(argv[1]) : 20000; iter < n; iter++) {
+		auto pat = gen(0);
+		bool icase = rnd(2), whole = rnd(4) == 0;
+		std::regex re;
+		try { re = std::regex(pat, icase ? std::regex::ECMAScript | std::regex::icase : std::regex::ECMAScript); } catch (...) { continue; }
+		widen(pat, wp);
+		Regex rx;
+		if (!rx.compile(wp, icase, whole)) { printf("compile fail %s\n", pat.c_str()); bad++; continue; }
+		for (int j = 0; j < 30; j++) {
+			std::string t; int n = rnd(12);
+			for (int k = 0; k < n; k++) t += alpha[rnd(10)];
+			widen(t, wt);
+			bool a = whole ? std::regex_match(t, re) : std::regex_search(t, re);
+			bool b = rx(string::view(wt, t.size()));
+			checks++;
+			if (a != b && bad++ < 20) printf("MISMATCH /%s/ %s%s '%s' std=%d mine=%d\n", pat.c_str(), icase ? "i" : "", whole ? "w" : "", t.c_str(), a, b);
+		}
+	}
+	printf("%ld checks, %ld bad\n", checks, bad);
+}
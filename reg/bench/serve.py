@@ -0,0 +1,32 @@
+# runs reg SERVE, sending each argument list (separated by a line "--" on argv) in turn, waiting for each to exit; prints the output of those marked "!"
+import subprocess, sys, codecs
+cmds, cur = [], []
+for a in sys.argv[2:]:
+    if a == '--': cmds.append(cur); cur = []
+    else: cur.append(a)
+cmds.append(cur)
+p = subprocess.Popen([sys.argv[1], 'SERVE'], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+code = 0
+for i, c in enumerate(cmds):
+    if c[0] == 'sleep':
+        import time; time.sleep(int(c[1]) / 1000); continue
+    show = c[0] == '!'
+    if show: c = c[1:]
+    payload = ''.join(x + '\0' for x in c)
+    n = len(payload.encode('utf-16-le')) // 2
+    p.stdin.write(('%d %d\n' % (i, n)).encode() + payload.encode('utf-8')); p.stdin.flush()
+    while True:
+        line = p.stdout.readline().decode()
+        id_, kind, num = line.split(' ')
+        if kind == 'exit':
+            code = int(num); break
+        # n UTF-16 units as UTF-8: read chars until we have that many units
+        dec = codecs.getincrementaldecoder('utf-8')()
+        units, text, got = int(num), [], 0
+        while got < units:
+            t = dec.decode(p.stdout.read(units - got))
+            text.append(t); got += len(t.encode('utf-16-le')) // 2
+        buf = ''.join(text).encode('utf-8')
+        if show: sys.stdout.write(buf.decode('utf-8'))
+p.stdin.close(); p.wait()
+sys.exit(code)
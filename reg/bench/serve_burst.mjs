@@ -0,0 +1,47 @@
+// sends a burst of QUERYs to reg SERVE at once and reports the rate: node serve_burst.mjs reg [threads] [count]
+// run with REGFAKE_SEED=3,8,4 (the keys queried) and REGFAKE_LATENCY for a registry that takes time
+import { spawn } from 'node:child_process';
+const [exe, threads, count = '1000'] = process.argv.slice(2);
+const args = ['SERVE'];
+if (threads) args.push('/threads', threads);
+const p = spawn(exe, args, { stdio: ['pipe', 'pipe', 'inherit'] });
+const N = +count;
+const ops = [];
+for (let i = 0; i < N; i++) {
+	const k = `HKCU\\Software\\Key${i % 8}\\Key${(i >> 3) % 8}`;
+	switch (i % 4) {
+		case 0: ops.push(['QUERY', k]); break;
+		case 1: ops.push(['QUERY', k, '/v', 'Value1']); break;
+		case 2: ops.push(['QUERY', k, '/s']); break;
+		case 3: ops.push(['QUERY', `HKCU\\Software\\Key${i % 8}`, '/depth:1', '/keysonly']); break;
+	}
+}
+let buf = Buffer.alloc(0), pending = new Map(), done = 0, fail = 0, order = [];
+const t0 = process.hrtime.bigint();
+p.stdout.on('data', d => {
+	buf = Buffer.concat([buf, d]);
+	for (;;) {
+		const nl = buf.indexOf(10);
+		if (nl < 0) return;
+		const [id, kind, n] = buf.subarray(0, nl).toString().split(' ');
+		if (kind === 'data') {
+			// n UTF-16 units as UTF-8: all ASCII here
+			if (buf.length < nl + 1 + +n) return;
+			pending.set(id, (pending.get(id) || '') + buf.subarray(nl + 1, nl + 1 + +n).toString());
+			buf = buf.subarray(nl + 1 + +n);
+		} else {
+			buf = buf.subarray(nl + 1);
+			order.push(+id);
+			if (n !== '0') fail++;
+			if (++done === N) {
+				const ms = Number(process.hrtime.bigint() - t0) / 1e6;
+				let inorder = order.every((v, i) => i === 0 || v > order[i - 1]);
+				console.log(`threads=${threads || 'default'} ${N} requests ${ms.toFixed(0)}ms  ${(N / ms * 1000).toFixed(0)}/s  failed=${fail} in_order=${inorder}`);
+				p.stdin.end();
+			}
+		}
+	}
+});
+let out = '';
+ops.forEach((a, i) => { const s = a.join('\0') + '\0'; out += `${i} ${s.length}\n${s}`; });
+p.stdin.write(out);
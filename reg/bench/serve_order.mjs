@@ -0,0 +1,41 @@
+// interleaves ADDs to one key with QUERYs of it (and slow QUERYs of others) over SERVE, checking that each read sees
+// the write before it and that answers come back in order: node serve_order.mjs reg threads (REGFAKE_SEED=3,8,4)
+import { spawn } from 'node:child_process';
+const [exe, threads] = process.argv.slice(2);
+const p = spawn(exe, ['SERVE', '/threads', threads], { stdio: ['pipe', 'pipe', 'inherit'] });
+const ops = [], expect = new Map();
+const k = 'HKCU\\Software\\Key1';
+for (let i = 0; i < 200; i++) {
+	ops.push(['ADD', k, '/v', 'Ord', '/t', 'REG_DWORD', '/d', String(i), '/f']);
+	ops.push(['QUERY', 'hkey_current_user\\software\\KEY1', '/v', 'Ord']); expect.set(ops.length - 1, i);
+	ops.push(['QUERY', `HKCU\\Software\\Key${2 + i % 5}`, '/s']);
+}
+let buf = Buffer.alloc(0), text = new Map(), done = 0, bad = 0, order = [];
+p.stdout.on('data', d => {
+	buf = Buffer.concat([buf, d]);
+	for (;;) {
+		const nl = buf.indexOf(10);
+		if (nl < 0) return;
+		const [id, kind, n] = buf.subarray(0, nl).toString().split(' ');
+		if (kind === 'data') {
+			if (buf.length < nl + 1 + +n) return;
+			text.set(+id, (text.get(+id) || '') + buf.subarray(nl + 1, nl + 1 + +n).toString());
+			buf = buf.subarray(nl + 1 + +n);
+		} else {
+			buf = buf.subarray(nl + 1);
+			order.push(+id);
+			if (expect.has(+id)) {
+				const m = /0x([0-9a-f]+)/.exec(text.get(+id));
+				if (!m || parseInt(m[1], 16) !== expect.get(+id)) { bad++; if (bad < 4) console.log(id, text.get(+id)); }
+			}
+			if (++done === ops.length) {
+				const inorder = order.every((v, i) => i === 0 || v > order[i - 1]);
+				console.log(`threads=${threads} ${ops.length} requests, reads seeing the wrong write: ${bad}, answered in order: ${inorder}`);
+				p.stdin.end();
+			}
+		}
+	}
+});
+let out = '';
+ops.forEach((a, i) => { const s = a.join('\0') + '\0'; out += `${i} ${s.length}\n${s}`; });
+p.stdin.write(out);
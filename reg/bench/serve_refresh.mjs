@@ -0,0 +1,32 @@
+// refreshes the keys in a list (lines of "last_write key", as /ifmodified:@list takes) over SERVE: one QUERY /z each,
+// the same with /ifmodified:last_write, or one QUERY /ifmodified:@list: node serve_refresh.mjs reg plain|ifmodified|batch list
+import { spawn } from 'node:child_process';
+import { readFileSync } from 'node:fs';
+const [exe, mode, file] = process.argv.slice(2);
+const list = readFileSync(file, 'utf8').trim().split('\n').map(l => l.split(' '));
+const p = spawn(exe, ['SERVE', '/threads', '1'], { stdio: ['pipe', 'pipe', 'inherit'] });
+const ops = mode === 'batch' ? [['QUERY', 'HKCU\\Software', '/z', `/ifmodified:@${file}`]]
+	: list.map(([t, k]) => ['QUERY', `HKCU\\Software\\${k}`, '/z', ...(mode === 'plain' ? [] : [`/ifmodified:${t}`])]);
+let buf = '', done = 0, chars = 0;
+const t0 = process.hrtime.bigint();
+p.stdout.setEncoding('utf8');
+p.stdout.on('data', d => {
+	buf += d;
+	for (;;) {
+		const nl = buf.indexOf('\n');
+		if (nl < 0) return;
+		const [id, kind, n] = buf.substring(0, nl).split(' ');
+		if (kind === 'data') {
+			if (buf.length < nl + 1 + +n) return;
+			chars += +n;
+			buf = buf.substring(nl + 1 + +n);
+		} else {
+			buf = buf.substring(nl + 1);
+			if (++done === ops.length) {
+				console.log(`${mode}: ${ops.length} requests, ${chars} chars of output, ${(Number(process.hrtime.bigint() - t0) / 1e6).toFixed(1)}ms`);
+				p.stdin.end();
+			}
+		}
+	}
+});
+p.stdin.write(ops.map((a, i) => { const s = a.join('\0') + '\0'; return `${i} ${s.length}\n${s}`; }).join(''));
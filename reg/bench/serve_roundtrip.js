@@ -0,0 +1,49 @@
+// one QUERY at a time, first each in a process of its own and then over one SERVE session, then many pipelined over
+// SERVE: node serve_roundtrip.js reg [count] (with REGFAKE_SEED=2,2,1, the key queried)
+const {spawn, execFile} = require('child_process');
+const exe = process.argv[2], N = +(process.argv[3] || 2000);
+const args = ["QUERY", "HKCU\\Software\\Key1", "/z"];
+const req = args.map(x => x + "\0").join("");
+const ms = t0 => Number(process.hrtime.bigint() - t0) / 1e6;
+
+function spawned(n) {
+	return new Promise(done => {
+		const t0 = process.hrtime.bigint();
+		const next = i => i === n ? done(ms(t0)) : execFile(exe, args, () => next(i + 1));
+		next(0);
+	});
+}
+
+(async () => {
+	const spawns = Math.max(N / 10, 20);
+	const t = await spawned(spawns);
+	console.log(`process per QUERY   ${(t / spawns).toFixed(2)} ms`);
+
+	const p = spawn(exe, ['SERVE'], {stdio: ['pipe', 'pipe', 'inherit']});
+	p.stdout.setEncoding('utf8');
+	let buf = '', exits = 0, waiting;
+	p.stdout.on('data', d => {
+		buf += d;
+		for (let i; (i = buf.indexOf(' exit ')) >= 0 && buf.indexOf('\n', i) >= 0; buf = buf.slice(buf.indexOf('\n', i) + 1))
+			++exits;
+		if (waiting && waiting.until <= exits)
+			waiting();
+	});
+	const answered = until => new Promise(r => { waiting = r; waiting.until = until; });
+
+	let t0;
+	for (let i = 0; i < N + 100; i++) {
+		if (i === 100)
+			t0 = process.hrtime.bigint();
+		p.stdin.write(`${i} ${req.length}\n${req}`);
+		await answered(i + 1);
+	}
+	console.log(`SERVE, one at a time ${(ms(t0) * 1000 / N).toFixed(1)} us`);
+
+	t0 = process.hrtime.bigint();
+	for (let i = 0; i < N * 5; i++)
+		p.stdin.write(`${i} ${req.length}\n${req}`);
+	await answered(exits + N * 5);
+	console.log(`SERVE, ${N * 5} pipelined ${(ms(t0) / 1000).toFixed(2)} s`);
+	p.stdin.end();
+})();
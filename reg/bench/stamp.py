@@ -0,0 +1,10 @@
+# runs a command and reports when its output arrives (how many chunks, the first and last, lines in each): stamp.py cmd...
+import subprocess, sys, time, os
+p = subprocess.Popen(sys.argv[1:], stdout=subprocess.PIPE, env=os.environ)
+t0 = time.time(); chunks = []
+while True:
+    b = os.read(p.stdout.fileno(), 1 << 16)
+    if not b: break
+    chunks.append((time.time() - t0, b.count(b'\n')))
+print('chunks', len(chunks), 'first at %.0fms' % (chunks[0][0]*1000), 'last at %.0fms' % (chunks[-1][0]*1000), 'lines', sum(c for _, c in chunks))
+print(' '.join('%.0f:%d' % (t*1000, n) for t, n in chunks[:12]))
@@ -0,0 +1,29 @@
+// times three walks of every key and value in a hive file, with no output or matching: walk_hive file.hiv
+#define wmain orig_wmain
+#include "reg.cpp"
+#undef wmain
+#include <time.h>
+static double now() { timespec t; clock_gettime(CLOCK_MONOTONIC, &t); return t.tv_sec + t.tv_nsec * 1e-9; }
+struct SumVisitor {
+	uint64_t keys = 0, values = 0, bytes = 0, sum = 0;
+	template<typename K> bool enter(TreeWalk &w, const K &key, const typename K::Info &info) { ++keys; return true; }
+	void value(TreeWalk &w, const ValueView &v) { ++values; bytes += v.data.size(); sum += v.data.size() ? v.data.begin()[0] + v.data.end()[-1] : 0; sum += v.name.size(); }
+	template<typename K> bool subkeys(TreeWalk &w, const K &key, const typename K::Info &info) { return true; }
+	template<typename K> bool subkey(TreeWalk &w, const K &parent, int i, const wchar_t *name) { return true; }
+	template<typename K> bool leave(TreeWalk &w, const K *parent, const wchar_t *name) { return false; }
+};
+int wmain(int argc, wchar_t *argv[]) {
+	WinFileMapping	mapped(argv[1]);
+	Hive			h(mapped.data());
+	for (int r = 0; r < 3; r++) {
+		auto t0 = now();
+		HiveKey		root(h, h.root());
+		TreeWalk	walk;
+		SumVisitor	v;
+		walk.push(L"HKEY_LOCAL_MACHINE\\SOFTWARE");
+		walk.walk(root, v);
+		auto t = now() - t0;
+		printf("keys %llu values %llu data %llu MB: %.0f ms, %.0f MB/s of hive (sum %llu)\n", (unsigned long long)v.keys, (unsigned long long)v.values, (unsigned long long)(v.bytes >> 20), t * 1000, mapped.data().size() / t / 1e6, (unsigned long long)v.sum);
+	}
+	return 0;
+}
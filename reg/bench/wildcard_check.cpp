@@ -0,0 +1,93 @@
+// checks Wildcard against a brute-force glob on random patterns and texts, then times a case-folded *needle* search
+// over 8MB of text against the loop Wildcard replaced
+#include "match.h"
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+
+typedef std::u16string	S;
+
+// full match of p (with * and ?) against t, by dynamic programming
+bool glob(const S &p, const S &t, bool fold) {
+	size_t	n = p.size(), m = t.size();
+	std::vector<std::vector<char>>	d(n + 1, std::vector<char>(m + 1, 0));
+	d[0][0] = 1;
+	for (size_t i = 1; i <= n; i++) {
+		if (p[i - 1] == '*')
+			d[i][0] = d[i - 1][0];
+		for (size_t j = 1; j <= m; j++) {
+			if (p[i - 1] == '*') {
+				d[i][j] = d[i - 1][j] || d[i][j - 1];
+			} else {
+				wchar_t	c = fold ? fold_case(t[j - 1]) : t[j - 1];
+				d[i][j] = d[i - 1][j - 1] && (p[i - 1] == '?' || p[i - 1] == c);
+			}
+		}
+	}
+	return d[n][m];
+}
+
+// the case-sensitive loop Wildcard replaced
+bool old_wildcard(const wchar_t* line, const wchar_t* pattern, bool anchored = false) {
+	const wchar_t* placeholder = anchored ? nullptr : pattern;
+	while (*line && *pattern) {
+		auto c = *pattern++;
+		if (c == '?' || c == *line)
+			line++;
+		else if (c == '*')
+			placeholder = pattern;
+		else if (--pattern == placeholder)
+			line++;
+		else if (placeholder)
+			pattern = placeholder;
+		else
+			return false;
+	}
+	return !*pattern && (!anchored || !*line);
+}
+
+template<typename F> void time(const char *name, size_t bytes, F f) {
+	auto	t0		= std::chrono::steady_clock::now();
+	bool	found	= f();
+	auto	t1		= std::chrono::steady_clock::now();
+	printf("%s: found=%d %.0f MB/s\n", name, found, bytes / 1e6 / std::chrono::duration<double>(t1 - t0).count());
+}
+
+int main() {
+	std::mt19937	r(1);
+	const char16_t	alpha[] = u"aAbB?*İéÉKK";
+	long			bad = 0, n = 0;
+
+	for (int it = 0; it < 300000; it++, n++) {
+		S	p, t;
+		for (int i = 0, pl = r() % 6; i < pl; i++)
+			p += alpha[r() % 11];
+		for (int i = 0, tl = r() % 40; i < tl; i++)
+			t += alpha[r() % 4 + (r() % 5 == 0 ? 6 : 0)];
+
+		bool	fold = r() % 2, anchored = r() % 2;
+		S		pf = p;
+		if (fold) {
+			for (auto &c : pf)
+				c = fold_case(c);
+		}
+		Wildcard	w;
+		w.compile((const wchar_t*)pf.c_str(), anchored, fold);
+		bool	got			= w(string::view((const wchar_t*)t.data(), t.size()));
+		bool	expected	= glob(anchored ? pf : u"*" + pf + u"*", t, fold);
+		if (got != expected && bad++ < 5)
+			printf("mismatch fold=%d anchored=%d got=%d\n", fold, anchored, got);
+	}
+	printf("%ld/%ld bad\n", bad, n);
+
+	S	text;
+	for (int i = 0; i < 4000000; i++)
+		text += u"abcdefghijklmnopqrstuvwxyz ABCDEF\\0123"[r() % 38];
+
+	Wildcard	w;
+	w.compile(L"needle", false, true);
+	time("Wildcard, folded", text.size() * 2, [&] { return w(string::view((const wchar_t*)text.data(), text.size())); });
+	time("old loop, exact", text.size() * 2, [&] { return old_wildcard((const wchar_t*)text.c_str(), L"needle"); });
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include "base.h"
+#include "text.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HEX_SSSE3
+#include <intrin.h>
+#include <immintrin.h>
+// gcc and clang only allow SSSE3 intrinsics in functions marked for it; cl.exe has no such attribute, and needs none
+#if defined(__GNUC__) || defined(__clang__)
+#define HEX_TARGET_SSSE3	__attribute__((target("ssse3")))
+#else
+#define HEX_TARGET_SSSE3
+#endif
+#endif
+
+//-----------------------------------------------------------------------------
+//	hex decoding
+//-----------------------------------------------------------------------------
+
+inline int hexchar(wchar_t c) {
+	return c >= '0' && c <= '9' ? c - '0'
+		: c >= 'A' && c <= 'F' ? c - 'A' + 10
+		: c >= 'a' && c <= 'f' ? c - 'a' + 10
+		: -1;
+}
+
+#ifdef HEX_SSSE3
+inline bool has_ssse3() {
+	static const bool	ssse3 = [] {
+		int	info[4];
+		__cpuid(info, 1);
+		return !!(info[2] & (1 << 9));
+	}();
+	return ssse3;
+}
+
+// decodes runs of "xx," (the layout .reg files use) 8 bytes at a time, stopping at anything else for the scalar loop to deal with
+HEX_TARGET_SSSE3 inline byte *decode_hex_runs(const wchar_t *&src, const wchar_t *e, byte *d) {
+	const __m128i	zero	= _mm_setzero_si128();
+	const __m128i	comma	= _mm_set1_epi8(',');
+	const __m128i	ten		= _mm_set1_epi8(10);
+	// char positions 2,5,8,11,14 of the first 16, and 17,20,23 (1,4,7 of the last 8)
+	const int		commas0 = 0x4924, commas1 = 0x92;
+	const __m128i	hi0		= _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i	hi1		= _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i	lo0		= _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i	lo1		= _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, -1, -1, -1, -1, -1, -1, -1, -1);
+
+	auto s = src;
+	while (e - s >= 24) {
+		auto	w0 = _mm_loadu_si128((const __m128i*)s);
+		auto	w1 = _mm_loadu_si128((const __m128i*)(s + 8));
+		auto	w2 = _mm_loadu_si128((const __m128i*)(s + 16));
+		// anything above 0xff saturates to 0xff, which is neither a digit nor a comma
+		auto	c0 = _mm_packus_epi16(w0, w1);
+		auto	c1 = _mm_packus_epi16(w2, zero);
+
+		auto	t0 = _mm_sub_epi8(c0, _mm_set1_epi8('0'));
+		auto	t1 = _mm_sub_epi8(c1, _mm_set1_epi8('0'));
+		auto	a0 = _mm_sub_epi8(_mm_or_si128(c0, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+		auto	a1 = _mm_sub_epi8(_mm_or_si128(c1, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+		auto	digit0 = _mm_cmpeq_epi8(_mm_min_epu8(t0, _mm_set1_epi8(9)), t0);
+		auto	digit1 = _mm_cmpeq_epi8(_mm_min_epu8(t1, _mm_set1_epi8(9)), t1);
+		auto	alpha0 = _mm_cmpeq_epi8(_mm_min_epu8(a0, _mm_set1_epi8(5)), a0);
+		auto	alpha1 = _mm_cmpeq_epi8(_mm_min_epu8(a1, _mm_set1_epi8(5)), a1);
+
+		int		hex0	= _mm_movemask_epi8(_mm_or_si128(digit0, alpha0));
+		int		hex1	= _mm_movemask_epi8(_mm_or_si128(digit1, alpha1)) & 0xff;
+		int		sep0	= _mm_movemask_epi8(_mm_cmpeq_epi8(c0, comma));
+		int		sep1	= _mm_movemask_epi8(_mm_cmpeq_epi8(c1, comma)) & 0xff;
+		if (sep0 != commas0 || sep1 != commas1 || hex0 != (~commas0 & 0xffff) || hex1 != (~commas1 & 0xff))
+			break;
+
+		auto	n0	= _mm_or_si128(_mm_and_si128(digit0, t0), _mm_andnot_si128(digit0, _mm_add_epi8(a0, ten)));
+		auto	n1	= _mm_or_si128(_mm_and_si128(digit1, t1), _mm_andnot_si128(digit1, _mm_add_epi8(a1, ten)));
+		auto	hi	= _mm_or_si128(_mm_shuffle_epi8(n0, hi0), _mm_shuffle_epi8(n1, hi1));
+		auto	lo	= _mm_or_si128(_mm_shuffle_epi8(n0, lo0), _mm_shuffle_epi8(n1, lo1));
+		_mm_storel_epi64((__m128i*)d, _mm_or_si128(_mm_slli_epi16(hi, 4), lo));
+		d	+= 8;
+		s	+= 24;
+	}
+	src = s;
+	return d;
+}
+#endif
+
+// decodes hex digits into d, skipping ',', '\\' and whitespace (so continued .reg lines need no joining), and stopping at anything else
+// a lone digit makes a byte of its own; d needs room for (e - s + 1) / 2 bytes, and may be the same memory as s
+inline byte *decode_hex(const wchar_t *s, const wchar_t *e, byte *d) {
+#ifdef HEX_SSSE3
+	bool	simd = has_ssse3();
+#endif
+	for (;;) {
+		while (s < e && (*s == ',' || *s == '\\' || is_whitespace(*s)))
+			++s;
+		if (s == e)
+			break;
+#ifdef HEX_SSSE3
+		if (simd) {
+			auto	s0 = s;
+			d = decode_hex_runs(s, e, d);
+			if (s != s0)
+				continue;
+		}
+#endif
+
+		auto d0 = hexchar(*s++);
+		if (d0 < 0)
+			break;
+
+		auto d1 = s < e ? hexchar(*s) : -1;
+		if (d1 >= 0) {
+			d0 = (d0 << 4) | d1;
+			++s;
+		}
+		*d++ = d0;
+	}
+	return d;
+}
@@ -0,0 +1,916 @@
+#pragma once
+#include "base.h"
+#include "string.h"
+#include "match.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+//-----------------------------------------------------------------------------
+//	hive - a registry hive file (regf), read in place from a mapped file
+//
+//	base block:	4096 bytes, starting "regf", giving the root key's cell and the size of the bins
+//	bins:		from 4096 on, each "hbin" and its 32-byte header, then cells: a 32-bit size (negative while the cell is in use) and
+//				its contents; cells are 8-byte aligned and found by their offset from the first bin
+//
+//	a key (nk) has its values in a list of value (vk) cells, its subkeys in an lf, lh or li list (or an ri: a list of those), and its
+//	security in an sk cell, which QUERY and EXPORT have no use for (SAVE copies it); data too big for one cell is split into the segments
+//	of a db
+//-----------------------------------------------------------------------------
+
+#pragma pack(push, 1)
+struct HiveBaseBlock {
+	enum { MAGIC = 'r' | ('e' << 8) | ('g' << 16) | ('f' << 24), SIZE = 4096 };
+	uint32_t	magic, sequence1, sequence2;
+	uint64_t	last_write;
+	uint32_t	major, minor, type, format;
+	uint32_t	root;						// cell offset
+	uint32_t	bins_size;
+	uint32_t	clustering;
+	char16_t	name[32];
+	byte		reserved[396];
+	uint32_t	checksum;					// xor of the 127 dwords before it
+};
+
+struct HiveBinHeader {
+	enum { MAGIC = 'h' | ('b' << 8) | ('i' << 16) | ('n' << 24) };
+	uint32_t	magic;
+	uint32_t	offset, size;				// of the bin, from the first one
+	uint32_t	reserved[2];
+	uint64_t	timestamp;
+	uint32_t	spare;
+};
+
+struct HiveKeyNode {
+	enum { SIG = 'n' | ('k' << 8), ROOT = 0x04, NO_DELETE = 0x08, SYM_LINK = 0x10, COMP_NAME = 0x20, USER_FLAGS = 0xff80 };
+	uint16_t	sig, flags;
+	uint64_t	last_write;					// FILETIME
+	uint32_t	access;
+	uint32_t	parent;
+	uint32_t	num_subkeys, num_volatile_subkeys;
+	uint32_t	subkeys, volatile_subkeys;	// cell offsets of lists; volatile keys are never in a file
+	uint32_t	num_values, values;
+	uint32_t	security, class_name;
+	uint32_t	max_subkey_name, max_subkey_class, max_value_name, max_value_data;
+	uint32_t	work;
+	uint16_t	name_len, class_len;		// in bytes
+	// the name follows: Latin-1 with COMP_NAME, otherwise UTF-16
+};
+
+struct HiveValueNode {
+	enum { SIG = 'v' | ('k' << 8), COMP_NAME = 0x01 };
+	enum : uint32_t { DATA_INLINE = 0x80000000u };
+	uint16_t	sig, name_len;				// in bytes
+	uint32_t	size;						// with DATA_INLINE, the data (up to 4 bytes) is in data itself
+	uint32_t	data;						// cell offset
+	uint32_t	type;
+	uint16_t	flags, spare;
+	// the name follows, as a key's does
+};
+
+struct HiveBigData {
+	enum { SIG = 'd' | ('b' << 8), MAX_SEGMENT = 16344 };
+	uint16_t	sig, num_segments;
+	uint32_t	segments;					// cell offset of a list of the segments' cells
+};
+
+struct HiveSecurity {
+	enum { SIG = 's' | ('k' << 8) };
+	uint16_t	sig, reserved;
+	uint32_t	flink, blink;				// every sk cell is in one circular list
+	uint32_t	refs;						// keys using it
+	uint32_t	size;
+	// a self-relative security descriptor follows
+};
+
+struct HiveList {
+	enum { LF = 'l' | ('f' << 8), LH = 'l' | ('h' << 8), LI = 'l' | ('i' << 8), RI = 'r' | ('i' << 8) };
+	uint16_t	sig, count;
+	// lf and lh: count (cell offset, hint or hash) pairs; li: count cell offsets; ri: count cell offsets of lf, lh or li lists
+};
+#pragma pack(pop)
+
+// a key's or value's name where it lies in the file
+struct HiveName {
+	const byte	*p;
+	uint32_t	size;		// in bytes
+	bool		compressed;
+	uint32_t	length() const { return compressed ? size : size / 2; }
+};
+
+struct Hive {
+	enum : uint32_t { NONE = ~0u };
+	range<const byte*>		file;
+	range<const byte*>		bins;
+	const HiveBaseBlock		*base	= nullptr;
+
+	static bool is_hive(range<const byte*> file) {
+		return file.size() >= HiveBaseBlock::SIZE + sizeof(HiveBinHeader) && ((const HiveBaseBlock*)file.begin())->magic == HiveBaseBlock::MAGIC;
+	}
+
+	Hive(range<const byte*> file) : file(file) {
+		if (!is_hive(file))
+			return;
+		auto	b = (const HiveBaseBlock*)file.begin();
+		bins	= {file.begin() + HiveBaseBlock::SIZE, min<size_t>(b->bins_size, file.size() - HiveBaseBlock::SIZE)};
+		if (((const HiveBinHeader*)bins.begin())->magic != HiveBinHeader::MAGIC || !key(b->root))
+			return;
+		base	= b;
+	}
+	explicit operator bool() const { return !!base; }
+
+	uint32_t	root()	const	{ return base->root; }
+
+	// a cell's contents; anything not leading to a cell in use inside the bins comes back empty rather than faulting
+	range<const byte*> cell(uint32_t offset) const {
+		if ((offset & 7) != 0 || uint64_t(offset) + 8 > bins.size())
+			return {};
+		auto	used = *(const int32_t*)(bins.begin() + offset);
+		if (used >= -4)
+			return {};
+		size_t	size = -int64_t(used);
+		if (size > bins.size() || offset > bins.size() - size)
+			return {};
+		return {bins.begin() + offset + 4, size - 4};
+	}
+
+	const HiveKeyNode *key(uint32_t offset) const {
+		auto	c = cell(offset);
+		auto	k = (const HiveKeyNode*)c.begin();
+		return c.size() >= sizeof(HiveKeyNode) && k->sig == HiveKeyNode::SIG && sizeof(HiveKeyNode) + k->name_len <= c.size() ? k : nullptr;
+	}
+	static HiveName name(const HiveKeyNode &k) {
+		return {(const byte*)(&k + 1), k.name_len, !!(k.flags & HiveKeyNode::COMP_NAME)};
+	}
+	// the key's security descriptor, or empty
+	range<const byte*> security(const HiveKeyNode &k) const {
+		auto	c = cell(k.security);
+		auto	s = (const HiveSecurity*)c.begin();
+		if (c.size() < sizeof(HiveSecurity) || s->sig != HiveSecurity::SIG || sizeof(HiveSecurity) + s->size > c.size())
+			return {};
+		return {c.begin() + sizeof(HiveSecurity), s->size};
+	}
+
+	const HiveValueNode *value(const HiveKeyNode &k, uint32_t i) const {
+		auto	list = cell(k.values);
+		if (i >= k.num_values || (i + 1) * 4ull > list.size())
+			return nullptr;
+		auto	c = cell(((const uint32_t*)list.begin())[i]);
+		auto	v = (const HiveValueNode*)c.begin();
+		return c.size() >= sizeof(HiveValueNode) && v->sig == HiveValueNode::SIG && sizeof(HiveValueNode) + v->name_len <= c.size() ? v : nullptr;
+	}
+	static HiveName name(const HiveValueNode &v) {
+		return {(const byte*)(&v + 1), v.name_len, !!(v.flags & HiveValueNode::COMP_NAME)};
+	}
+	static uint32_t size(const HiveValueNode &v) {
+		return v.size & HiveValueNode::DATA_INLINE ? min(v.size & ~HiveValueNode::DATA_INLINE, 4u) : v.size;
+	}
+
+	// the db holding the value's data, if it is in one made of enough segments for it
+	const HiveBigData *big_data(const HiveValueNode &v) const {
+		auto	n = size(v);
+		if ((v.size & HiveValueNode::DATA_INLINE) || n <= HiveBigData::MAX_SEGMENT || base->minor < 4)
+			return nullptr;
+		auto	c = cell(v.data);
+		auto	d = (const HiveBigData*)c.begin();
+		return c.size() >= sizeof(HiveBigData) && d->sig == HiveBigData::SIG && n <= uint64_t(d->num_segments) * HiveBigData::MAX_SEGMENT ? d : nullptr;
+	}
+	// how much of a buffer data needs for the value: only data from a db is joined in one
+	uint32_t buffer_size(const HiveValueNode &v) const {
+		return big_data(v) ? size(v) : 0;
+	}
+
+	// the data in place, unless it is in a db, when its segments are joined in buffer (coming back empty if it doesn't fit)
+	range<const byte*> data(const HiveValueNode &v, byte *buffer, size_t buffer_size) const {
+		auto	n = size(v);
+		if (v.size & HiveValueNode::DATA_INLINE)
+			return {(const byte*)&v.data, n};
+
+		if (auto d = big_data(v)) {
+			if (n > buffer_size)
+				return {};
+			auto	list	= cell(d->segments);
+			auto	p		= buffer;
+			for (uint32_t i = 0; i < d->num_segments && (i + 1) * 4ull <= list.size() && p < buffer + n; i++) {
+				auto	seg		= cell(((const uint32_t*)list.begin())[i]);
+				if (seg.empty())
+					break;
+				auto	chunk	= min(min(seg.size(), size_t(HiveBigData::MAX_SEGMENT)), size_t(buffer + n - p));
+				memcpy(p, seg.begin(), chunk);
+				p += chunk;
+			}
+			return p == buffer + n ? range<const byte*>(buffer, n) : range<const byte*>();
+		}
+		auto	c = cell(v.data);
+		return c.size() >= n ? range<const byte*>(c.begin(), n) : range<const byte*>();
+	}
+
+	// the offset of the i-th entry of a subkey list, or NONE
+	uint32_t list_entry(uint32_t list, uint32_t i) const {
+		if (i >= list_count(list))
+			return NONE;
+		auto	l		= (const HiveList*)cell(list).begin();
+		auto	entries	= (const uint32_t*)(l + 1);
+		return l->sig == HiveList::LI ? entries[i] : entries[i * 2];
+	}
+	// entries in a subkey list (0 for an ri), as many as it has room for
+	uint32_t list_count(uint32_t list) const {
+		auto	c = cell(list);
+		auto	l = (const HiveList*)c.begin();
+		if (c.size() < sizeof(HiveList))
+			return 0;
+		switch (l->sig) {
+			case HiveList::LF:
+			case HiveList::LH:	return uint32_t(min<size_t>(l->count, (c.size() - sizeof(HiveList)) / 8));
+			case HiveList::LI:	return uint32_t(min<size_t>(l->count, (c.size() - sizeof(HiveList)) / 4));
+			default:			return 0;
+		}
+	}
+
+	// how many values and subkeys a key really has, when its lists hold fewer than it says
+	uint32_t num_values(const HiveKeyNode &k) const {
+		return uint32_t(min<size_t>(k.num_values, cell(k.values).size() / 4));
+	}
+	uint32_t num_subkeys(const HiveKeyNode &k) const {
+		auto	c = cell(k.subkeys);
+		auto	l = (const HiveList*)c.begin();
+		if (c.size() < sizeof(HiveList) || l->sig != HiveList::RI)
+			return min(k.num_subkeys, list_count(k.subkeys));
+		uint64_t	n = 0;
+		auto		lists = (const uint32_t*)(l + 1);
+		for (size_t i = 0, nl = min<size_t>(l->count, (c.size() - sizeof(HiveList)) / 4); i < nl; i++)
+			n += list_count(lists[i]);
+		return uint32_t(min<uint64_t>(k.num_subkeys, n));
+	}
+
+	// the i-th subkey's cell offset, or NONE; under an ri, cursor remembers which of its lists the last one was in (and how many
+	// keys came before that list), so going through them in order doesn't count through the ri each time
+	// a subkey has to name key as its parent and can't be the root, so a damaged file can't send a walk round in a loop
+	struct Cursor {
+		uint32_t	list = 0, first = 0;
+	};
+	uint32_t subkey(uint32_t key, uint32_t i, Cursor &cursor) const {
+		auto	sub = child(key, i, cursor);
+		auto	k	= this->key(sub);
+		return k && k->parent == key && sub != root() ? sub : NONE;
+	}
+	uint32_t child(uint32_t key, uint32_t i, Cursor &cursor) const {
+		auto	k = this->key(key);
+		if (!k || i >= k->num_subkeys)
+			return NONE;
+		auto	c = cell(k->subkeys);
+		auto	l = (const HiveList*)c.begin();
+		if (c.size() < sizeof(HiveList))
+			return NONE;
+		if (l->sig != HiveList::RI)
+			return list_entry(k->subkeys, i);
+
+		auto	lists	= (const uint32_t*)(l + 1);
+		auto	n		= min<size_t>(l->count, (c.size() - sizeof(HiveList)) / 4);
+		if (i < cursor.first || cursor.list >= n)
+			cursor = {0, 0};
+		for (; cursor.list < n; cursor.first += list_count(lists[cursor.list++])) {
+			if (i - cursor.first < list_count(lists[cursor.list]))
+				return list_entry(lists[cursor.list], i - cursor.first);
+		}
+		return NONE;
+	}
+};
+
+//-----------------------------------------------------------------------------
+//	HiveBuilder - keys and values as they are added, written out as a new hive
+//	keys are laid out a family at a time: a key's subkey list, then each subkey's nk with its value list, values and their small data,
+//	then each subkey's own family; so what a lookup compares, and what a walk reads next, is together, and none of a key's cells are
+//	split between bins if they fit in one
+//-----------------------------------------------------------------------------
+
+// the kernel keeps subkey lists in the order of their names upper-cased, and that is what an lh list's hashes are of
+// it upper-cases by a table of simple mappings, which the invariant locale's agree with (towupper does nothing outside ASCII in the C
+// locale); the table is made once, leaving out surrogates, which map to themselves
+inline wchar_t hive_upcase(wchar_t c) {
+	if (c < 0x80)
+		return c >= 'a' && c <= 'z' ? wchar_t(c - 32) : c;
+
+	static const wchar_t	*table = [] {
+		auto	from	= (wchar_t*)malloc(0x10000 * sizeof(wchar_t));
+		auto	to		= (wchar_t*)malloc(0x10000 * sizeof(wchar_t));
+		for (uint32_t i = 0; i < 0x10000; i++)
+			from[i] = to[i] = wchar_t(i);
+		LCMapStringEx(LOCALE_NAME_INVARIANT, LCMAP_UPPERCASE, from + 0x80, 0xd800 - 0x80, to + 0x80, 0xd800 - 0x80, nullptr, nullptr, 0);
+		LCMapStringEx(LOCALE_NAME_INVARIANT, LCMAP_UPPERCASE, from + 0xe000, 0x2000, to + 0xe000, 0x2000, nullptr, nullptr, 0);
+		free(from);
+		return to;
+	}();
+	return table[c];
+}
+inline int compare_upcase(string::view a, string::view b) {
+	for (auto p = a.begin(), q = b.begin(); p < a.end() && q < b.end(); ++p, ++q) {
+		auto	x = hive_upcase(*p), y = hive_upcase(*q);
+		if (x != y)
+			return x < y ? -1 : 1;
+	}
+	return int(a.size() > b.size()) - int(a.size() < b.size());
+}
+inline uint32_t hive_hash(string::view name) {
+	uint32_t	h = 0;
+	for (auto c : name)
+		h = h * 37 + hive_upcase(c);
+	return h;
+}
+
+// O:BAG:SYD:(A;CI;KA;;;SY)(A;CI;KA;;;BA)(A;CI;KR;;;BU), for keys that come with no security of their own
+inline range<const byte*> default_hive_security() {
+	static const byte	sd[] = {
+		1, 0, 0x04, 0x80,	96, 0, 0, 0,	112, 0, 0, 0,	0, 0, 0, 0,		20, 0, 0, 0,
+		2, 0, 76, 0,		3, 0, 0, 0,
+		0, 2, 20, 0,		0x3f, 0, 0x0f, 0,	1, 1, 0, 0, 0, 0, 0, 5,		18, 0, 0, 0,
+		0, 2, 24, 0,		0x3f, 0, 0x0f, 0,	1, 2, 0, 0, 0, 0, 0, 5,		32, 0, 0, 0,	0x20, 2, 0, 0,
+		0, 2, 24, 0,		0x19, 0, 0x02, 0,	1, 2, 0, 0, 0, 0, 0, 5,		32, 0, 0, 0,	0x21, 2, 0, 0,
+		1, 2, 0, 0, 0, 0, 0, 5,		32, 0, 0, 0,	0x20, 2, 0, 0,
+		1, 1, 0, 0, 0, 0, 0, 5,		18, 0, 0, 0,
+	};
+	return {sd, sizeof(sd)};
+}
+
+struct HiveBuilder {
+	enum : uint32_t {
+		NONE		= ~0u,
+		BIN			= 4096,
+		MAX_LEAF	= 507,		// entries in an lh list the size of a bin; more are split between lists under an ri
+		SMALL_DATA	= 256,		// data up to this size is kept with its key; more follows the key's other cells
+		MAX_NAME	= 0x7fff,
+		RECENT_GAPS	= 8,		// bins looked back at for room left in them
+	};
+	struct Key {
+		uint32_t	parent;
+		uint32_t	name, name_len;					// in names
+		uint64_t	last_write;
+		uint32_t	security;
+		uint16_t	flags;
+		bool		deleted;
+		uint32_t	first_value, last_value;		// a list through Value::next
+		uint32_t	num_values;
+		uint32_t	first_child, num_subkeys;		// in children, by write
+		uint32_t	cell;
+	};
+	struct Value {
+		uint32_t	next;
+		uint32_t	name, name_len;
+		uint32_t	type, size;
+		uint64_t	data;							// in blobs
+	};
+	struct Security {
+		uint64_t	data;
+		uint32_t	size, hash;
+		uint32_t	refs, cell;
+	};
+	struct Gap {
+		uint32_t		at, end;
+	};
+	struct Child {
+		const wchar_t	*name;
+		uint32_t		name_len, key;
+	};
+
+	// open addressing, of index + 1
+	struct Table {
+		uint32_t	*slots = nullptr, mask = 0, count = 0;
+		~Table() { free(slots); }
+
+		// the slot of the entry equal(i) accepts, or the empty one it would go in; hash(i) places entries again when the table grows
+		template<typename E, typename H> uint32_t &find(uint32_t h, E &&equal, H &&hash) {
+			if (count * 2 >= mask) {
+				auto	m = mask ? mask * 2 + 1 : 0xfff;
+				auto	t = (uint32_t*)calloc(m + 1, sizeof(uint32_t));
+				for (uint32_t i = 0; slots && i <= mask; i++) {
+					if (auto e = slots[i]) {
+						auto	j = hash(e - 1) & m;
+						while (t[j])
+							j = (j + 1) & m;
+						t[j] = e;
+					}
+				}
+				free(slots);
+				slots	= t;
+				mask	= m;
+			}
+			auto	j = h & mask;
+			while (slots[j] && !equal(slots[j] - 1))
+				j = (j + 1) & mask;
+			return slots[j];
+		}
+		void add(uint32_t &slot, uint32_t i) {
+			slot = i + 1;
+			++count;
+		}
+	};
+
+	dynamic_range<wchar_t>	names;
+	dynamic_range<byte>		blobs;
+	dynamic_range<Key>		keys;
+	dynamic_range<Value>	values;
+	dynamic_range<Security>	securities;
+	Table					subkey_table, security_table;
+	uint32_t				num_written_keys = 0, num_written_values = 0;
+
+	// while writing
+	dynamic_range<byte>		image;
+	Child					*children	= nullptr;
+	uint32_t				at = 0, bin_end = 0;		// from the first bin
+	dynamic_range<uint32_t>	scratch, lists, stack;
+	dynamic_range<Gap>		gaps;
+
+	~HiveBuilder() { free(children); }
+
+	uint32_t	num_keys()		const	{ return uint32_t(keys.p - keys.begin()); }
+	uint32_t	num_values()	const	{ return uint32_t(values.p - values.begin()); }
+
+	string::view		name(const Key &k)		const	{ return {names.begin() + k.name, k.name_len}; }
+	string::view		name(const Value &v)	const	{ return {names.begin() + v.name, v.name_len}; }
+	range<const byte*>	data(const Value &v)	const	{ return {blobs.begin() + v.data, v.size}; }
+
+	uint32_t add_name(string::view s) {
+		auto	offset = names.p - names.begin();
+		if (s.size())	// an empty view may have no pointer at all
+			memcpy(names.alloc(s.size()), s.begin(), s.size() * sizeof(wchar_t));
+		return uint32_t(offset);
+	}
+	uint64_t add_blob(range<const byte*> d) {
+		auto	offset = blobs.p - blobs.begin();
+		if (d.size())
+			memcpy(blobs.alloc(d.size()), d.begin(), d.size());
+		return offset;
+	}
+	static string::view clamp_name(string::view s) {
+		return string::view(s.begin(), min(s.size(), size_t(MAX_NAME)));
+	}
+
+	// the same descriptor is only stored once, and shared by every key that has it
+	uint32_t add_security(range<const byte*> sd) {
+		uint32_t	h = 2166136261u;
+		for (auto c : sd)
+			h = (h ^ c) * 16777619u;
+		auto	&slot = security_table.find(h,
+			[&](uint32_t i) {
+				auto	&s = securities.begin()[i];
+				return s.hash == h && s.size == sd.size() && memcmp(blobs.begin() + s.data, sd.begin(), sd.size()) == 0;
+			},
+			[this](uint32_t i) { return securities.begin()[i].hash; }
+		);
+		if (!slot) {
+			*securities.alloc(1) = {add_blob(sd), uint32_t(sd.size()), h, 0, 0};
+			security_table.add(slot, uint32_t(securities.p - securities.begin() - 1));
+		}
+		return slot - 1;
+	}
+
+	uint32_t add_key(uint32_t parent, string::view name, uint64_t last_write, uint32_t security, uint16_t flags = 0) {
+		auto	i = num_keys();
+		name	= clamp_name(name);
+		*keys.alloc(1) = {parent, add_name(name), uint32_t(name.size()), last_write, security, flags, false, NONE, NONE, 0, 0, 0, NONE};
+		return i;
+	}
+
+	void add_value(uint32_t key, string::view name, uint32_t type, range<const byte*> data) {
+		auto	i	= num_values();
+		auto	&k	= keys.begin()[key];
+		name		= clamp_name(name);
+		*values.alloc(1) = {NONE, add_name(name), uint32_t(name.size()), type, uint32_t(data.size()), add_blob(data)};
+		if (k.last_value == NONE)
+			k.first_value = i;
+		else
+			values.begin()[k.last_value].next = i;
+		k.last_value = i;
+		++k.num_values;
+	}
+	// adds to the most recently added key
+	void add_value(string::view name, uint32_t type, range<const byte*> data) {
+		add_value(num_keys() - 1, name, type, data);
+	}
+
+	// for building up keys out of order, as a .reg file can: names are found case-insensitively, and deleted keys are not found
+	uint32_t &subkey_slot(uint32_t parent, string::view name) {
+		return subkey_table.find(hive_hash(name) ^ (parent * 0x9E3779B1u),
+			[&](uint32_t i) {
+				auto	&k = keys.begin()[i];
+				return k.parent == parent && !k.deleted && compare_upcase(this->name(k), name) == 0;
+			},
+			[this](uint32_t i) {
+				auto	&k = keys.begin()[i];
+				return hive_hash(this->name(k)) ^ (k.parent * 0x9E3779B1u);
+			}
+		);
+	}
+	uint32_t find_subkey(uint32_t parent, string::view name) {
+		return subkey_slot(parent, clamp_name(name)) - 1;
+	}
+	uint32_t create_subkey(uint32_t parent, string::view name, uint64_t last_write, uint32_t security) {
+		name		= clamp_name(name);
+		auto	&slot = subkey_slot(parent, name);
+		if (!slot)
+			subkey_table.add(slot, add_key(parent, name, last_write, security));
+		return slot - 1;
+	}
+
+	// a value of the same name is replaced
+	void set_value(uint32_t key, string::view name, uint32_t type, range<const byte*> data) {
+		name = clamp_name(name);
+		for (auto i = keys.begin()[key].first_value; i != NONE; i = values.begin()[i].next) {
+			auto	&v = values.begin()[i];
+			if (compare_upcase(this->name(v), name) == 0) {
+				v.type	= type;
+				v.size	= uint32_t(data.size());
+				v.data	= add_blob(data);
+				return;
+			}
+		}
+		add_value(key, name, type, data);
+	}
+	void remove_value(uint32_t key, string::view name) {
+		auto	&k		= keys.begin()[key];
+		uint32_t	prev	= NONE;
+		name = clamp_name(name);
+		for (auto i = k.first_value; i != NONE; prev = i, i = values.begin()[i].next) {
+			auto	&v = values.begin()[i];
+			if (compare_upcase(this->name(v), name) == 0) {
+				(prev == NONE ? k.first_value : values.begin()[prev].next) = v.next;
+				if (k.last_value == i)
+					k.last_value = prev;
+				--k.num_values;
+				return;
+			}
+		}
+	}
+	// the key and everything below it; the root can't go, so is emptied instead
+	void delete_key(uint32_t key) {
+		if (key) {
+			keys.begin()[key].deleted = true;
+			return;
+		}
+		for (auto &k : make_range(keys.begin() + 1, keys.p)) {
+			if (k.parent == 0)
+				k.deleted = true;
+		}
+		auto	&root = keys.begin()[0];
+		root.first_value = root.last_value = NONE;
+		root.num_values = 0;
+	}
+
+	// laying out
+
+	byte *bins() { return image.begin() + HiveBaseBlock::SIZE; }
+	template<typename T> T *cell(uint32_t offset) { return (T*)(bins() + offset + 4); }
+
+	static bool compressible(string::view s) {
+		for (auto c : s) {
+			if (c > 0xff)
+				return false;
+		}
+		return true;
+	}
+	static uint32_t name_size(string::view s) {
+		return uint32_t(compressible(s) ? s.size() : s.size() * 2);
+	}
+	static void put_name(byte *p, string::view s) {
+		if (compressible(s)) {
+			for (auto c : s)
+				*p++ = byte(c);
+		} else {
+			memcpy(p, s.begin(), s.size() * 2);
+		}
+	}
+	static uint32_t cell_size(uint32_t n) {
+		return (n + 4 + 7) & ~7u;
+	}
+
+	// the rest of the bin being filled is kept for cells that fit in it later, and what is still left at the end becomes a free cell
+	void end_bin() {
+		if (at < bin_end)
+			*gaps.alloc(1) = {at, bin_end};
+		at = bin_end;
+	}
+	void free_gaps() {
+		end_bin();
+		for (auto &g : make_range(gaps.begin(), gaps.p)) {
+			if (g.at < g.end)
+				*(int32_t*)(bins() + g.at) = int32_t(g.end - g.at);
+		}
+	}
+	// a bin added at the end, with room for at least size
+	uint32_t add_bin(uint32_t size) {
+		auto	offset	= uint32_t(image.p - bins());
+		auto	n		= max<uint32_t>(BIN, (size + sizeof(HiveBinHeader) + BIN - 1) & ~(BIN - 1));
+		auto	b		= (HiveBinHeader*)memset(image.alloc(n), 0, n);
+		b->magic	= HiveBinHeader::MAGIC;
+		b->offset	= offset;
+		b->size		= n;
+		return offset;
+	}
+	void new_bin() {
+		end_bin();
+		at		= add_bin(BIN - sizeof(HiveBinHeader)) + sizeof(HiveBinHeader);
+		bin_end	= at - sizeof(HiveBinHeader) + BIN;
+	}
+	// cells to be allocated one after another with size between them go in one bin if they fit in one: this, what was left of one of the
+	// last few, or a new one; filling a gap swaps it with the bin being filled, until end_together swaps them back
+	uint32_t keep_together(uint32_t size) {
+		if (at + size <= bin_end || size > BIN - sizeof(HiveBinHeader))
+			return NONE;
+		for (size_t i = gaps.p - gaps.begin(), e = i - min(i, size_t(RECENT_GAPS)); i-- > e;) {
+			auto	g = gaps.begin() + i;
+			if (g->end - g->at >= size) {
+				swap(at, g->at);
+				swap(bin_end, g->end);
+				return uint32_t(i);
+			}
+		}
+		new_bin();
+		return NONE;
+	}
+	void end_together(uint32_t gap) {
+		if (gap != NONE) {
+			swap(at, gaps.begin()[gap].at);
+			swap(bin_end, gaps.begin()[gap].end);
+		}
+	}
+	// with anywhere, a cell that doesn't fit in the bin being filled can go in what was left of one of the last few
+	uint32_t alloc(uint32_t n, bool anywhere = false) {
+		auto	size = cell_size(n);
+		if (at + size > bin_end && anywhere) {
+			for (size_t i = gaps.p - gaps.begin(), e = i - min(i, size_t(RECENT_GAPS)); i-- > e;) {
+				auto	g = gaps.begin() + i;
+				if (g->end - g->at >= size) {
+					auto	offset = g->at;
+					*(int32_t*)(bins() + offset) = -int32_t(size);
+					g->at += size;
+					return offset;
+				}
+			}
+		}
+		if (at + size > bin_end) {
+			// a cell too big for a bin gets one of its own, and the one being filled carries on after it
+			if (size > BIN - sizeof(HiveBinHeader)) {
+				auto	b		= add_bin(size);
+				auto	offset	= b + sizeof(HiveBinHeader);
+				auto	end		= b + ((HiveBinHeader*)(bins() + b))->size;
+				*(int32_t*)(bins() + offset) = -int32_t(size);
+				if (offset + size < end)
+					*gaps.alloc(1) = {uint32_t(offset + size), end};
+				return offset;
+			}
+			new_bin();
+		}
+		auto	offset = at;
+		*(int32_t*)(bins() + at) = -int32_t(size);
+		at += size;
+		return offset;
+	}
+
+	uint32_t place_data(range<const byte*> d, bool anywhere) {
+		if (d.size() <= HiveBigData::MAX_SEGMENT) {
+			auto	c = alloc(uint32_t(d.size()), anywhere);
+			memcpy(cell<byte>(c), d.begin(), d.size());
+			return c;
+		}
+		uint32_t	num_segments = uint32_t((d.size() + HiveBigData::MAX_SEGMENT - 1) / HiveBigData::MAX_SEGMENT);
+		auto		db		= alloc(sizeof(HiveBigData));
+		auto		list	= alloc(num_segments * 4);
+		for (uint32_t i = 0; i < num_segments; i++) {
+			auto	n	= min(d.size() - i * HiveBigData::MAX_SEGMENT, size_t(HiveBigData::MAX_SEGMENT));
+			auto	c	= alloc(uint32_t(n));
+			memcpy(cell<byte>(c), d.begin() + i * HiveBigData::MAX_SEGMENT, n);
+			cell<uint32_t>(list)[i] = c;
+		}
+		auto	b = cell<HiveBigData>(db);
+		b->sig			= HiveBigData::SIG;
+		b->num_segments	= uint16_t(num_segments);
+		b->segments		= list;
+		return db;
+	}
+
+	// a key's nk, value list, values and their small data, then the rest of its data
+	void place_key(uint32_t i, uint32_t parent) {
+		auto	&k		= keys.begin()[i];
+		auto	name	= this->name(k);
+
+		auto	group	= cell_size(sizeof(HiveKeyNode) + name_size(name)) + (k.num_values ? cell_size(k.num_values * 4) : 0);
+		for (auto v = k.first_value; v != NONE; v = values.begin()[v].next) {
+			auto	&r = values.begin()[v];
+			group += cell_size(sizeof(HiveValueNode) + name_size(this->name(r)));
+			if (r.size > 4 && r.size <= SMALL_DATA)
+				group += cell_size(r.size);
+		}
+		auto	gap	= keep_together(group);
+
+		k.cell		= alloc(sizeof(HiveKeyNode) + name_size(name));
+		auto	list	= k.num_values ? alloc(k.num_values * 4) : NONE;
+
+		uint32_t	max_subkey_name = 0, max_value_name = 0, max_value_data = 0;
+		for (auto &c : make_range(children + k.first_child, k.num_subkeys))
+			max_subkey_name = max(max_subkey_name, c.name_len * 2);
+
+		scratch.p = scratch.begin();
+		uint32_t	n = 0;
+		for (auto v = k.first_value; v != NONE; v = values.begin()[v].next, n++) {
+			auto	&r		= values.begin()[v];
+			auto	vname	= this->name(r);
+			auto	vk		= alloc(sizeof(HiveValueNode) + name_size(vname));
+			auto	data	= r.size > 4 && r.size <= SMALL_DATA ? place_data(this->data(r), false) : NONE;
+			auto	p		= cell<HiveValueNode>(vk);
+			p->sig		= HiveValueNode::SIG;
+			p->name_len	= uint16_t(name_size(vname));
+			p->type		= r.type;
+			p->flags	= compressible(vname) ? HiveValueNode::COMP_NAME : 0;
+			put_name((byte*)(p + 1), vname);
+			if (r.size <= 4) {
+				p->size = r.size | HiveValueNode::DATA_INLINE;
+				memcpy(&p->data, blobs.begin() + r.data, r.size);
+			} else {
+				p->size = r.size;
+				p->data	= data;
+				if (data == NONE) {
+					*scratch.alloc(1) = vk;
+					*scratch.alloc(1) = v;
+				}
+			}
+			cell<uint32_t>(list)[n] = vk;
+			max_value_name	= max(max_value_name, r.name_len * 2);
+			max_value_data	= max(max_value_data, r.size);
+		}
+
+		auto	p = cell<HiveKeyNode>(k.cell);
+		p->sig				= HiveKeyNode::SIG;
+		p->flags			= (k.flags & (HiveKeyNode::SYM_LINK | HiveKeyNode::USER_FLAGS))
+							| (i == 0 ? HiveKeyNode::ROOT | HiveKeyNode::NO_DELETE : 0)
+							| (compressible(name) ? HiveKeyNode::COMP_NAME : 0);
+		p->last_write		= k.last_write;
+		p->parent			= parent;
+		p->num_subkeys		= k.num_subkeys;
+		p->subkeys			= NONE;
+		p->volatile_subkeys	= NONE;
+		p->num_values		= k.num_values;
+		p->values			= list;
+		p->security			= securities.begin()[k.security].cell;
+		p->class_name		= NONE;
+		p->max_subkey_name	= max_subkey_name;
+		p->max_value_name	= max_value_name;
+		p->max_value_data	= max_value_data;
+		p->name_len			= uint16_t(name_size(name));
+		put_name((byte*)(p + 1), name);
+		end_together(gap);
+
+		for (auto v = scratch.begin(); v < scratch.p; v += 2) {
+			auto	data = place_data(this->data(values.begin()[v[1]]), true);
+			cell<HiveValueNode>(v[0])->data = data;
+		}
+	}
+
+	// a key's subkey list (or lists, under an ri), then its subkeys
+	void place_subkeys(uint32_t i) {
+		auto	&k			= keys.begin()[i];
+		auto	subs		= children + k.first_child;
+		auto	num_lists	= (k.num_subkeys + MAX_LEAF - 1) / MAX_LEAF;
+		auto	top			= num_lists > 1 ? alloc(sizeof(HiveList) + num_lists * 4) : NONE;
+
+		lists.p = lists.begin();
+		for (uint32_t l = 0; l < num_lists; l++)
+			*lists.alloc(1) = alloc(sizeof(HiveList) + min(k.num_subkeys - l * MAX_LEAF, uint32_t(MAX_LEAF)) * 8);
+
+		for (auto &c : make_range(subs, k.num_subkeys))
+			place_key(c.key, k.cell);
+
+		for (uint32_t l = 0; l < num_lists; l++) {
+			auto	n		= min(k.num_subkeys - l * MAX_LEAF, uint32_t(MAX_LEAF));
+			auto	list	= cell<HiveList>(lists.begin()[l]);
+			auto	entries	= (uint32_t*)(list + 1);
+			list->sig	= HiveList::LH;
+			list->count	= uint16_t(n);
+			for (auto &c : make_range(subs + l * MAX_LEAF, n)) {
+				*entries++ = keys.begin()[c.key].cell;
+				*entries++ = hive_hash(string::view(c.name, c.name_len));
+			}
+		}
+		if (top != NONE) {
+			auto	list	= cell<HiveList>(top);
+			list->sig	= HiveList::RI;
+			list->count	= uint16_t(num_lists);
+			memcpy(list + 1, lists.begin(), num_lists * 4);
+		}
+		cell<HiveKeyNode>(k.cell)->subkeys = top != NONE ? top : lists.begin()[0];
+	}
+
+	// w(const void*, size_t) is called with the file in order; name is the file's, the end of which goes in the base block
+	template<typename W> void write(W &&w, string::view name) {
+		auto	nk	= num_keys();
+		auto	k	= keys.begin();
+
+		// a deleted key takes everything below it with it; subkeys are listed grouped by parent, in the kernel's order
+		for (auto &i : make_range(securities.begin(), securities.p))
+			i.refs = 0;
+		num_written_keys = num_written_values = 0;
+		for (uint32_t i = 0; i < nk; i++) {
+			k[i].num_subkeys = 0;
+			if (i && (k[i].deleted || k[k[i].parent].deleted)) {
+				k[i].deleted = true;
+				continue;
+			}
+			if (i)
+				++k[k[i].parent].num_subkeys;
+			++securities.begin()[k[i].security].refs;
+			++num_written_keys;
+			num_written_values += k[i].num_values;
+		}
+		free(children);
+		children = (Child*)malloc(max(nk, 1u) * sizeof(Child));
+		uint32_t	first = 0;
+		for (uint32_t i = 0; i < nk; i++) {
+			k[i].first_child	= first;
+			first				+= k[i].num_subkeys;
+			k[i].num_subkeys	= 0;
+		}
+		for (uint32_t i = 1; i < nk; i++) {
+			if (!k[i].deleted) {
+				auto	&parent = k[k[i].parent];
+				children[parent.first_child + parent.num_subkeys++] = {names.begin() + k[i].name, k[i].name_len, i};
+			}
+		}
+		// they mostly come in order already
+		auto	compare = [](const void *a, const void *b) {
+			auto	x = (const Child*)a, y = (const Child*)b;
+			return compare_upcase(string::view(x->name, x->name_len), string::view(y->name, y->name_len));
+		};
+		for (uint32_t i = 0; i < nk; i++) {
+			auto	subs = children + k[i].first_child;
+			for (uint32_t j = 1; j < k[i].num_subkeys; j++) {
+				if (compare(subs + j - 1, subs + j) > 0) {
+					qsort(subs, k[i].num_subkeys, sizeof(Child), compare);
+					break;
+				}
+			}
+		}
+
+		image.p = image.begin();
+		image.ensure(HiveBaseBlock::SIZE + (names.p - names.begin()) * 2 + (blobs.p - blobs.begin()) + nk * 112ull + num_values() * 48ull);
+		memset(image.alloc(HiveBaseBlock::SIZE), 0, HiveBaseBlock::SIZE);
+		at = bin_end = 0;
+		gaps.p = gaps.begin();
+
+		// security first, in a circular list
+		uint32_t	first_sk = NONE, last_sk = NONE;
+		for (auto &s : make_range(securities.begin(), securities.p)) {
+			if (!s.refs)
+				continue;
+			s.cell = alloc(sizeof(HiveSecurity) + s.size);
+			auto	p = cell<HiveSecurity>(s.cell);
+			p->sig		= HiveSecurity::SIG;
+			p->refs		= s.refs;
+			p->size		= s.size;
+			p->blink	= last_sk;
+			memcpy(p + 1, blobs.begin() + s.data, s.size);
+			if (last_sk == NONE)
+				first_sk = s.cell;
+			else
+				cell<HiveSecurity>(last_sk)->flink = s.cell;
+			last_sk = s.cell;
+		}
+		cell<HiveSecurity>(last_sk)->flink	= first_sk;
+		cell<HiveSecurity>(first_sk)->blink	= last_sk;
+
+		// then families, depth first
+		place_key(0, NONE);
+		stack.p = stack.begin();
+		if (k[0].num_subkeys)
+			*stack.alloc(1) = 0;
+		while (stack.p > stack.begin()) {
+			auto	i = *--stack.p;
+			place_subkeys(i);
+			for (auto c = children + k[i].first_child + k[i].num_subkeys; c-- > children + k[i].first_child;) {
+				if (k[c->key].num_subkeys)
+					*stack.alloc(1) = c->key;
+			}
+		}
+		free_gaps();
+
+		auto	b = (HiveBaseBlock*)image.begin();
+		b->magic		= HiveBaseBlock::MAGIC;
+		b->sequence1	= b->sequence2 = 1;
+		b->last_write	= k[0].last_write;
+		b->major		= 1;
+		b->minor		= 5;
+		b->format		= 1;
+		b->root			= k[0].cell;
+		b->bins_size	= uint32_t(image.p - bins());
+		b->clustering	= 1;
+		auto	tail = string::view(name.end() - min(name.size(), size_t(31)), name.end());
+		for (size_t i = 0; i < tail.size(); i++)
+			b->name[i] = tail.begin()[i];
+
+		uint32_t	checksum = 0;
+		for (auto p = (const uint32_t*)b; p < &b->checksum; ++p)
+			checksum ^= *p;
+		b->checksum = checksum == ~0u ? ~0u - 1 : checksum == 0 ? 1 : checksum;
+
+		w(image.begin(), image.p - image.begin());
+	}
+};
@@ -0,0 +1,252 @@
+#pragma once
+#include "base.h"
+#include "string.h"
+#include "match.h"
+#include "snapshot.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//-----------------------------------------------------------------------------
+//	search index - every trigram (3 case-folded chars) of each key's name, value names and data as QUERY prints it, with the keys it is in
+//	it follows a snapshot of the same keys (at the snapshot's size, 8-byte aligned), so the file is still a snapshot
+//
+//	header
+//	trigrams:	SearchIndexTrigram[num_trigrams], sorted
+//	postings:	each trigram's keys in ascending order, as LEB128 gaps (the first one from -1)
+//-----------------------------------------------------------------------------
+
+struct SearchIndexHeader {
+	enum { MAGIC = 'R' | ('E' << 8) | ('G' << 16) | ('I' << 24), VERSION = 1 };
+	uint32_t	magic, version;
+	uint32_t	num_keys, num_trigrams;
+	uint64_t	trigrams, postings;		// section offsets, from the start of the header
+	uint64_t	size;
+};
+
+struct SearchIndexTrigram {
+	uint64_t	trigram;				// chars packed 16 bits each, the first highest
+	uint64_t	postings;				// from the start of the postings section
+	uint32_t	num_keys, pad;
+};
+
+inline uint64_t make_trigram(const wchar_t *p) {
+	return (uint64_t(uint16_t(fold_case(p[0]))) << 32) | (uint32_t(uint16_t(fold_case(p[1]))) << 16) | uint16_t(fold_case(p[2]));
+}
+
+struct SearchIndex {
+	const SearchIndexHeader		*header		= nullptr;
+	const SearchIndexTrigram	*trigrams	= nullptr;
+	range<const byte*>			postings;
+
+	static uint64_t offset(uint64_t snapshot_size) { return (snapshot_size + 7) & ~7ull; }
+
+	SearchIndex(range<const byte*> file, uint64_t snapshot_size, uint32_t num_keys) {
+		auto	at = offset(snapshot_size);
+		if (!Snapshot::fits(at, sizeof(SearchIndexHeader), file.size()))
+			return;
+		auto	h = (const SearchIndexHeader*)(file.begin() + at);
+		if (h->magic != SearchIndexHeader::MAGIC || h->version != SearchIndexHeader::VERSION || h->num_keys != num_keys
+			|| !Snapshot::fits(at, h->size, file.size()) || h->postings > h->size
+			|| !Snapshot::fits(h->trigrams, uint64_t(h->num_trigrams) * sizeof(SearchIndexTrigram), h->postings)
+		)
+			return;
+		header		= h;
+		trigrams	= (const SearchIndexTrigram*)((const byte*)h + h->trigrams);
+		postings	= {(const byte*)h + h->postings, (const byte*)h + h->size};
+	}
+	explicit operator bool() const { return !!header; }
+
+	const SearchIndexTrigram *find(uint64_t trigram) const {
+		uint32_t	a = 0, b = header->num_trigrams;
+		while (a < b) {
+			auto	m = (a + b) / 2;
+			if (trigrams[m].trigram < trigram)
+				a = m + 1;
+			else
+				b = m;
+		}
+		return a < header->num_trigrams && trigrams[a].trigram == trigram ? trigrams + a : nullptr;
+	}
+
+	// calls f(key) for each key with the trigram, ascending; stops at anything that runs off the end or past num_keys
+	template<typename F> void keys(const SearchIndexTrigram &t, F &&f) const {
+		auto		p	= postings.begin() + min(t.postings, postings.size());
+		uint32_t	key	= ~0u;
+		for (uint32_t n = t.num_keys; n--;) {
+			uint32_t	gap = 0;
+			for (int shift = 0; ; shift += 7) {
+				if (p == postings.end() || shift > 28)
+					return;
+				gap |= uint32_t(*p & 0x7f) << shift;
+				if (!(*p++ & 0x80))
+					break;
+			}
+			key += gap;
+			if (key >= header->num_keys)
+				return;
+			f(key);
+		}
+	}
+
+	// narrows keys (ascending) to those that have every trigram of text; with all, keys is taken to hold every key to start with
+	// false if text is too short to have a trigram, so says nothing
+	bool narrow(string::view text, dynamic_range<uint32_t> &keys, bool all) const {
+		if (text.size() < 3)
+			return false;
+
+		// the rarest first, so the list being narrowed is short from the start
+		dynamic_range<const SearchIndexTrigram*>	found;
+		for (auto p = text.begin(); p + 3 <= text.end(); ++p) {
+			auto	t = find(make_trigram(p));
+			if (!t) {
+				keys.p = keys.begin();
+				return true;
+			}
+			*found.alloc(1) = t;
+		}
+		qsort(found.begin(), found.p - found.begin(), sizeof(*found.begin()), [](const void *a, const void *b) {
+			auto	na = (*(const SearchIndexTrigram**)a)->num_keys, nb = (*(const SearchIndexTrigram**)b)->num_keys;
+			return na < nb ? -1 : na > nb;
+		});
+
+		for (auto t : make_range(found.begin(), found.p)) {
+			if (all) {
+				keys.p = keys.begin();
+				this->keys(*t, [&](uint32_t key) { *keys.alloc(1) = key; });
+				all = false;
+				continue;
+			}
+			if (keys.p == keys.begin())
+				break;
+			auto	in = keys.begin(), out = keys.begin();
+			this->keys(*t, [&](uint32_t key) {
+				while (in < keys.p && *in < key)
+					++in;
+				if (in < keys.p && *in == key)
+					*out++ = *in++;
+			});
+			keys.p = out;
+		}
+		return true;
+	}
+};
+
+//-----------------------------------------------------------------------------
+//	SearchIndexBuilder - keys must be added in snapshot order, the text of each before the next is started
+//	each trigram's list is encoded as keys arrive, so nothing needs sorting but the trigrams themselves
+//-----------------------------------------------------------------------------
+
+struct SearchIndexBuilder {
+	struct List {
+		uint64_t	trigram;
+		byte		*postings;
+		uint32_t	size, capacity;
+		uint32_t	num_keys;
+		uint32_t	last;		// key + 1, so 0 is none yet
+	};
+	dynamic_range<List>	lists;
+	uint32_t			*table		= nullptr;	// open addressing, list index + 1
+	uint32_t			table_mask	= 0;
+	uint32_t			key			= 0;		// being added
+
+	~SearchIndexBuilder() {
+		for (auto &l : make_range(lists.begin(), lists.p))
+			free(l.postings);
+		free(table);
+	}
+
+	uint32_t	num_trigrams() const { return uint32_t(lists.p - lists.begin()); }
+
+	static uint32_t hash(uint64_t trigram) {
+		return uint32_t((trigram * 0x9E3779B97F4A7C15ull) >> 32);
+	}
+
+	void grow() {
+		auto	mask	= table_mask ? table_mask * 2 + 1 : 0xffff;
+		auto	t		= (uint32_t*)calloc(mask + 1, sizeof(uint32_t));
+		for (uint32_t i = 0, n = num_trigrams(); i < n; i++) {
+			auto	h = hash(lists.begin()[i].trigram) & mask;
+			while (t[h])
+				h = (h + 1) & mask;
+			t[h] = i + 1;
+		}
+		free(table);
+		table		= t;
+		table_mask	= mask;
+	}
+
+	List &list(uint64_t trigram) {
+		if (num_trigrams() * 2 >= table_mask)
+			grow();
+		auto	h = hash(trigram) & table_mask;
+		for (; table[h]; h = (h + 1) & table_mask) {
+			auto	&l = lists.begin()[table[h] - 1];
+			if (l.trigram == trigram)
+				return l;
+		}
+		*lists.alloc(1)	= {trigram, nullptr, 0, 0, 0, 0};
+		table[h]		= num_trigrams();
+		return lists.p[-1];
+	}
+
+	void add(uint64_t trigram) {
+		auto	&l = list(trigram);
+		if (l.last == key + 1)
+			return;
+		if (l.size + 5 > l.capacity) {
+			l.capacity	= max(l.capacity * 2, 8u);
+			l.postings	= (byte*)realloc(l.postings, l.capacity);
+		}
+		for (auto gap = key + 1 - l.last; ; gap >>= 7) {
+			if (gap < 0x80) {
+				l.postings[l.size++] = gap;
+				break;
+			}
+			l.postings[l.size++] = (gap & 0x7f) | 0x80;
+		}
+		l.last = key + 1;
+		++l.num_keys;
+	}
+
+	// text of the key being added; next_key moves on to the next one
+	void add_text(string::view text) {
+		for (auto p = text.begin(); p + 3 <= text.end(); ++p)
+			add(make_trigram(p));
+	}
+	void next_key() {
+		++key;
+	}
+
+	// w(const void*, size_t) is called with the index in order
+	template<typename W> void write(W &&w) {
+		auto	n = num_trigrams();
+		qsort(lists.begin(), n, sizeof(List), [](const void *a, const void *b) {
+			auto	ta = ((const List*)a)->trigram, tb = ((const List*)b)->trigram;
+			return ta < tb ? -1 : ta > tb;
+		});
+
+		uint64_t	total = 0;
+		for (auto &l : make_range(lists.begin(), lists.p))
+			total += l.size;
+
+		SearchIndexHeader	h;
+		h.magic			= SearchIndexHeader::MAGIC;
+		h.version		= SearchIndexHeader::VERSION;
+		h.num_keys		= key;
+		h.num_trigrams	= n;
+		h.trigrams		= sizeof(h);
+		h.postings		= h.trigrams + uint64_t(n) * sizeof(SearchIndexTrigram);
+		h.size			= h.postings + total;
+		w(&h, sizeof(h));
+
+		uint64_t	offset = 0;
+		for (auto &l : make_range(lists.begin(), lists.p)) {
+			SearchIndexTrigram	t = {l.trigram, offset, l.num_keys, 0};
+			w(&t, sizeof(t));
+			offset += l.size;
+		}
+		for (auto &l : make_range(lists.begin(), lists.p))
+			w(l.postings, l.size);
+	}
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include "base.h"
+#include "text.h"
+#include "string.h"
+
+//-----------------------------------------------------------------------------
+//	JSON output
+//-----------------------------------------------------------------------------
+
+// escapes only what JSON requires, plus surrogates (so a lone one survives being encoded to UTF-8); runs between escapes go out in one write
+inline void write_json_string(TextWriter<wchar_t> &out, string::view s) {
+	static const wchar_t	hex[] = L"0123456789abcdef";
+	out.write(L"\"", 1);
+	auto	run = s.begin();
+	for (auto p = run; p < s.end(); ++p) {
+		auto	c = *p;
+		if (c >= 0x20 && c != '"' && c != '\\' && (c < 0xd800 || c >= 0xe000))
+			continue;
+
+		out.write(run, p - run);
+		run = p + 1;
+		wchar_t	esc[6] = {'\\', c};
+		switch (c) {
+			case '"': case '\\':	out.write(esc, 2); break;
+			case '\n':	esc[1] = 'n'; out.write(esc, 2); break;
+			case '\r':	esc[1] = 'r'; out.write(esc, 2); break;
+			case '\t':	esc[1] = 't'; out.write(esc, 2); break;
+			default:
+				esc[1] = 'u';
+				esc[2] = hex[c >> 12];
+				esc[3] = hex[(c >> 8) & 15];
+				esc[4] = hex[(c >> 4) & 15];
+				esc[5] = hex[c & 15];
+				out.write(esc, 6);
+				break;
+		}
+	}
+	out.write(run, s.end() - run);
+	out.write(L"\"", 1);
+}
+
+// padded base64, a chunk at a time
+inline void write_base64(TextWriter<wchar_t> &out, range<const byte*> data) {
+	static const char	digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	wchar_t	chunk[256];
+	auto	d = chunk;
+	auto	p = data.begin(), e = data.end();
+	for (; e - p >= 3; p += 3) {
+		uint32_t	v = (p[0] << 16) | (p[1] << 8) | p[2];
+		d[0] = digits[v >> 18];
+		d[1] = digits[(v >> 12) & 63];
+		d[2] = digits[(v >> 6) & 63];
+		d[3] = digits[v & 63];
+		if ((d += 4) == chunk + 256) {
+			out.write(chunk, 256);
+			d = chunk;
+		}
+	}
+	if (p < e) {
+		uint32_t	v = (p[0] << 16) | (e - p > 1 ? p[1] << 8 : 0);
+		d[0] = digits[v >> 18];
+		d[1] = digits[(v >> 12) & 63];
+		d[2] = e - p > 1 ? digits[(v >> 6) & 63] : '=';
+		d[3] = '=';
+		d += 4;
+	}
+	out.write(chunk, d - chunk);
+}
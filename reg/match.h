@@ -0,0 +1,299 @@
+#pragma once
+#include "base.h"
+#include "string.h"
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define MATCH_SSE2
+#include <emmintrin.h>
+#endif
+
+//-----------------------------------------------------------------------------
+//	case folding
+//-----------------------------------------------------------------------------
+
+// what case-insensitive searches compare; patterns are folded once up front, text as it is compared
+inline wchar_t fold_case(wchar_t c) {
+	return c < 0x80 ? (wchar_t)to_lower((char)c) : (wchar_t)towlower(c);
+}
+
+// whether anything outside ASCII folds to c (so a vector compare on folded ASCII alone could miss it)
+inline bool folds_from_nonascii(wchar_t c) {
+	if (c >= 0x80)
+		return true;
+	for (uint32_t i = 0x80; i < 0x10000; i++) {
+		if (fold_case((wchar_t)i) == c)
+			return true;
+	}
+	return false;
+}
+
+inline bool equal_folded(string::view text, string::view folded) {
+	if (text.size() != folded.size())
+		return false;
+	for (auto a = text.begin(), b = folded.begin(); a < text.end(); ++a, ++b) {
+		if (fold_case(*a) != *b)
+			return false;
+	}
+	return true;
+}
+
+// orders names ignoring case
+inline int compare_folded(string::view a, string::view b) {
+	for (auto p = a.begin(), q = b.begin(); p < a.end() && q < b.end(); ++p, ++q) {
+		auto	x = fold_case(*p), y = fold_case(*q);
+		if (x != y)
+			return x < y ? -1 : 1;
+	}
+	return int(a.size() > b.size()) - int(a.size() < b.size());
+}
+
+//-----------------------------------------------------------------------------
+//	Wildcard - a pattern ('*' for any run, '?' for any one char) compiled into the literal pieces between the '*'s
+//	the first and last pieces are pinned to the ends of the text when the pattern is anchored and doesn't start or end with '*';
+//	the rest are found left to right, the leftmost occurrence always being the right one
+//-----------------------------------------------------------------------------
+
+struct Wildcard {
+	struct Piece {
+		const wchar_t	*p;
+		uint32_t		len;
+		bool			wide_first, wide_last;	// some non-ASCII char folds to the first/last char
+	};
+	dynamic_range<Piece>	pieces;
+	bool					anchor_start	= false;
+	bool					anchor_end		= false;
+	bool					fold			= false;
+
+	// with fold, pattern must already be case-folded; it needs to outlive the Wildcard
+	void compile(const wchar_t *pattern, bool anchored, bool fold) {
+		auto	end			= pattern + string_length(pattern);
+		this->fold			= fold;
+		anchor_start		= anchored && pattern < end && pattern[0] != '*';
+		anchor_end			= anchored && (pattern == end || end[-1] != '*');
+
+		for (auto p = pattern; p <= end;) {
+			auto	e = p;
+			while (e < end && *e != '*')
+				++e;
+			if (e > p) {
+				auto	first = p[0], last = e[-1];
+				*pieces.alloc(1) = {p, uint32_t(e - p),
+					first != '?' && (fold ? folds_from_nonascii(first) : first >= 0x80),
+					last != '?' && (fold ? folds_from_nonascii(last) : last >= 0x80)
+				};
+			}
+			p = e + 1;
+		}
+	}
+
+	bool equal(const Piece &piece, const wchar_t *t) const {
+		for (uint32_t i = 0; i < piece.len; i++) {
+			auto	c = piece.p[i];
+			if (c != (fold ? fold_case(t[i]) : t[i]) && c != '?')
+				return false;
+		}
+		return true;
+	}
+
+#ifdef MATCH_SSE2
+	static __m128i fold_ascii(__m128i x) {
+		auto	upper = _mm_and_si128(_mm_cmpgt_epi16(x, _mm_set1_epi16('A' - 1)), _mm_cmplt_epi16(x, _mm_set1_epi16('Z' + 1)));
+		return _mm_add_epi16(x, _mm_and_si128(upper, _mm_set1_epi16(0x20)));
+	}
+	static __m128i nonascii(__m128i x) {
+		return _mm_or_si128(_mm_cmplt_epi16(x, _mm_setzero_si128()), _mm_cmpgt_epi16(x, _mm_set1_epi16(0x7f)));
+	}
+	// lanes that could hold c once folded
+	__m128i candidates(__m128i x, wchar_t c, bool wide) const {
+		if (!fold)
+			return _mm_cmpeq_epi16(x, _mm_set1_epi16(c));
+		auto	m = _mm_cmpeq_epi16(fold_ascii(x), _mm_set1_epi16(c));
+		return wide ? _mm_or_si128(m, nonascii(x)) : m;
+	}
+
+	// checks 8 positions at a time for the piece's first and last chars, and only compares the whole piece where both are there
+	// leaves a where the scalar search should take over if it runs out of room
+	bool find_sse2(const Piece &piece, const wchar_t *&a, const wchar_t *b) const {
+		auto	last = piece.len - 1;
+		for (; b - a >= ptrdiff_t(last + 8); a += 8) {
+			auto	m0	= candidates(_mm_loadu_si128((const __m128i*)a), piece.p[0], piece.wide_first);
+			auto	m1	= candidates(_mm_loadu_si128((const __m128i*)(a + last)), piece.p[last], piece.wide_last);
+			for (uint32_t mask = _mm_movemask_epi8(_mm_and_si128(m0, m1)); mask;) {
+				auto	i = lowest_set_bit(mask) / 2;
+				mask &= ~(3u << (i * 2));
+				if (equal(piece, a + i)) {
+					a += i;
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+#endif
+
+	const wchar_t *find(const Piece &piece, const wchar_t *a, const wchar_t *b) const {
+#ifdef MATCH_SSE2
+		if (piece.p[0] != '?' && piece.p[piece.len - 1] != '?' && find_sse2(piece, a, b))
+			return a;
+#endif
+		for (; b - a >= ptrdiff_t(piece.len); ++a) {
+			if (equal(piece, a))
+				return a;
+		}
+		return nullptr;
+	}
+
+	// an uncompiled Wildcard matches everything
+	bool operator()(string::view text) const {
+		auto	a		= text.begin(), b = text.end();
+		auto	first	= pieces.begin(), last = pieces.p;
+
+		if (anchor_start && first < last) {
+			if (size_t(b - a) < first->len || !equal(*first, a))
+				return false;
+			a += first++->len;
+		}
+		bool	end_pinned = anchor_end && first < last;
+		if (end_pinned) {
+			--last;
+			if (size_t(b - a) < last->len || !equal(*last, b - last->len))
+				return false;
+			b -= last->len;
+		}
+		for (; first < last; ++first) {
+			if (!(a = find(*first, a, b)))
+				return false;
+			a += first->len;
+		}
+		return !anchor_end || end_pinned || a == b;
+	}
+};
+
+//-----------------------------------------------------------------------------
+//	MultiMatch - any number of literal patterns, found together in one pass over the text (Aho-Corasick)
+//	chars are mapped to classes first (one per distinct pattern char, everything else sharing class 0) so every state gets a full row of
+//	transitions; with fold the class table does the folding too, so the text is never folded at all
+//-----------------------------------------------------------------------------
+
+struct MultiMatch {
+	enum : uint32_t { NONE = ~0u, MAX_TABLE = 1 << 24 };
+	struct Pattern {
+		uint32_t	offset, len;
+		uint32_t	next;		// another pattern ending in the same state
+	};
+	dynamic_range<wchar_t>	chars;
+	dynamic_range<Pattern>	patterns;
+	dynamic_range<uint32_t>	delta;		// num_states * num_classes
+	dynamic_range<uint32_t>	output;		// per state: a pattern ending there, or NONE
+	dynamic_range<uint32_t>	suffix;		// per state: the longest proper suffix of it that has an output, or 0
+	uint16_t				*classes	= nullptr;
+	uint32_t				num_classes	= 0;
+
+	~MultiMatch() { free(classes); }
+	explicit operator bool() const { return num_classes != 0; }
+
+	uint32_t		count()				const	{ return uint32_t(patterns.p - patterns.begin()); }
+	uint32_t		length(uint32_t i)	const	{ return patterns.begin()[i].len; }
+	string::view	pattern(uint32_t i)	const	{ auto &p = patterns.begin()[i]; return {chars.begin() + p.offset, p.len}; }
+
+	// empty patterns are skipped; pattern is copied, and kept as it was given for reporting
+	void add(string::view pattern) {
+		if (pattern.empty())
+			return;
+		auto	offset = chars.p - chars.begin();
+		memcpy(chars.alloc(pattern.size()), pattern.begin(), pattern.size() * sizeof(wchar_t));
+		*patterns.alloc(1) = {uint32_t(offset), uint32_t(pattern.size()), NONE};
+	}
+
+	uint32_t *row(uint32_t s) const { return delta.begin() + s * num_classes; }
+
+	uint32_t add_state() {
+		memset(delta.alloc(num_classes), 0, num_classes * sizeof(uint32_t));
+		*output.alloc(1) = NONE;
+		*suffix.alloc(1) = 0;
+		return uint32_t(output.p - output.begin() - 1);
+	}
+
+	// fails if the table would be unreasonably big (thousands of distinct chars in long patterns)
+	bool compile(bool fold) {
+		auto	cs = chars.begin(), ce = chars.p;
+		auto	pattern_class = (uint16_t*)calloc(0x10000, sizeof(uint16_t));
+		uint32_t	nc = 1;
+		for (auto p = cs; p < ce && nc < 0x10000; ++p) {
+			auto	c = (uint16_t)(fold ? fold_case(*p) : *p);
+			if (!pattern_class[c])
+				pattern_class[c] = nc++;
+		}
+		if (nc == 0x10000 || (ce - cs + 1) * uint64_t(nc) > MAX_TABLE) {
+			free(pattern_class);
+			return false;
+		}
+		classes = (uint16_t*)malloc(0x10000 * sizeof(uint16_t));
+		for (uint32_t c = 0; c < 0x10000; c++)
+			classes[c] = pattern_class[fold ? (uint16_t)fold_case((wchar_t)c) : c];
+		free(pattern_class);
+		num_classes	= nc;
+
+		// the trie (classes[] folds the patterns' own chars too)
+		add_state();
+		for (uint32_t i = 0, n = count(); i < n; i++) {
+			uint32_t	s = 0;
+			for (auto c : pattern(i)) {
+				auto	k = classes[(uint16_t)c];
+				auto	t = row(s)[k];
+				if (!t) {
+					t = add_state();
+					row(s)[k] = t;
+				}
+				s = t;
+			}
+			patterns.begin()[i].next	= output.begin()[s];
+			output.begin()[s]			= i;
+		}
+
+		// breadth first, so a state's failure (always shallower) has its row filled in before the state needs it; missing transitions become the failure's
+		uint32_t	num_states	= uint32_t(output.p - output.begin());
+		auto		fail		= (uint32_t*)calloc(num_states, sizeof(uint32_t));
+		auto		queue		= (uint32_t*)malloc(num_states * sizeof(uint32_t));
+		uint32_t	head = 0, tail = 0;
+		for (uint32_t k = 0; k < nc; k++) {
+			if (auto t = row(0)[k])
+				queue[tail++] = t;
+		}
+		while (head < tail) {
+			auto	s	= queue[head++];
+			auto	f	= fail[s];
+			suffix.begin()[s] = output.begin()[f] != NONE ? f : suffix.begin()[f];
+			auto	rs	= row(s), rf = row(f);
+			for (uint32_t k = 0; k < nc; k++) {
+				if (auto t = rs[k]) {
+					fail[t]			= rf[k];
+					queue[tail++]	= t;
+				} else {
+					rs[k] = rf[k];
+				}
+			}
+		}
+		free(fail);
+		free(queue);
+		return true;
+	}
+
+	// calls hit(pattern index, end of the occurrence) for every occurrence of every pattern
+	template<typename F> void scan(string::view text, F &&hit) const {
+		auto		d	= delta.begin();
+		auto		out	= output.begin(), suf = suffix.begin();
+		uint32_t	s	= 0;
+		for (auto p = text.begin(); p < text.end(); ++p) {
+			s = d[s * num_classes + classes[(uint16_t)*p]];
+			for (auto o = out[s] != NONE ? s : suf[s]; o; o = suf[o]) {
+				for (auto i = out[o]; i != NONE; i = patterns.begin()[i].next)
+					hit(i, p + 1);
+			}
+		}
+	}
+};
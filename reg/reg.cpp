@@ -1,13 +1,20 @@
 #include "base.h"
 #include "text.h"
 #include "string.h"
+#include "hex.h"
+#include "json.h"
+#include "snapshot.h"
+#include "hive.h"
+#include "index.h"
+#include "match.h"
+#include "regex.h"
 
 #include <windows.h>
-#include <io.h>
-#include <fcntl.h>
+#include "thread.h"
 #include <stdio.h>
 #include <string.h>
 #include <wchar.h>
+#include <new>
 
 //static auto& out = std::wcout;
 
@@ -16,6 +23,12 @@ struct WinFile {
 	WinFile(HANDLE h) : h(h) {}
 	~WinFile() { CloseHandle(h); }
 	explicit operator bool() const { return h != INVALID_HANDLE_VALUE; }
+	// however the two were named
+	bool same_file(const WinFile &b) const {
+		BY_HANDLE_FILE_INFORMATION	x, y;
+		return GetFileInformationByHandle(h, &x) && GetFileInformationByHandle(b.h, &y)
+			&& x.dwVolumeSerialNumber == y.dwVolumeSerialNumber && x.nFileIndexHigh == y.nFileIndexHigh && x.nFileIndexLow == y.nFileIndexLow;
+	}
 };
 
 struct WinFileWriter : WinFile {
@@ -40,62 +53,334 @@ struct WinFileReader : WinFile {
 	}
 };
 
-struct FileWriter : TextWriter<wchar_t> {
-	FILE	*h;
-	int		column;
+struct WinFileMapping : WinFileReader {
+	HANDLE		mapping	= nullptr;
+	const byte	*p		= nullptr;
+	size_t		size	= 0;
+
+	WinFileMapping(const wchar_t *filename) : WinFileReader(filename) {
+		LARGE_INTEGER	len;
+		if (*this && GetFileSizeEx(h, &len) && len.QuadPart) {
+			if ((mapping = CreateFileMapping(h, NULL, PAGE_READONLY, 0, 0, NULL))) {
+				if ((p = (const byte*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)))
+					size = len.QuadPart;
+			}
+		}
+	}
+	~WinFileMapping() {
+		if (p)
+			UnmapViewOfFile(p);
+		if (mapping)
+			CloseHandle(mapping);
+	}
+	range<const byte*> data() const { return {p, size}; }
+};
 
-	FileWriter(FILE *h) : h(h) {}
-	FileWriter(const wchar_t *filename) {
-		_wfopen_s(&h, filename, L"w, ccs=UTF-8");
+// formats into one reusable buffer (grown as needed), tracking the column for .reg line wrapping
+struct BufferWriter : TextWriter<wchar_t> {
+	wchar_t	*buffer, *p, *end;
+	size_t	line	= 0;	// offset of the current line in buffer
+	int		carried	= 0;	// chars of the current line already drained out of buffer
+
+	BufferWriter(size_t capacity = 64 * 1024) : buffer((wchar_t*)malloc(capacity * sizeof(wchar_t))), p(buffer), end(buffer + capacity) {}
+	~BufferWriter() { free(buffer); }
+
+	virtual void make_room(size_t n) {
+		auto	used	= size_t(p - buffer);
+		auto	cap		= max(size_t(end - buffer) * 2, used + n);
+		buffer	= (wchar_t*)realloc(buffer, cap * sizeof(wchar_t));
+		p		= buffer + used;
+		end		= buffer + cap;
 	}
-	~FileWriter() { fflush(h); fclose(h); }
-	operator FILE*() const { return h; }
 
-	size_t write(const wchar_t* buffer, size_t size) {
-		auto n = fwrite(buffer, sizeof(wchar_t), size, h);
-		column += n;
+	size_t write(const wchar_t* s, size_t n) {
+		if (n > size_t(end - p))
+			make_room(n);
+		memcpy(p, s, n * sizeof(wchar_t));
+		for (auto i = p + n; i-- != p;) {
+			if (*i == '\n') {
+				line	= i + 1 - buffer;
+				carried	= 0;
+				break;
+			}
+		}
+		p += n;
 		return n;
 	}
-	void flush() { fflush(h); column = 0;}
+
+	int		column()	const	{ return carried + int(p - buffer - line); }
+	size_t	length()	const	{ return p - buffer; }
+	range<const wchar_t*> text() const { return {buffer, p}; }
+	void	clear()	{
+		carried	= column();
+		line	= 0;
+		p		= buffer;
+	}
 };
 
-struct FileReader {
-	FILE	*h;
-	FileReader(FILE *h) : h(h) {}
-	FileReader(const wchar_t *filename) {
-		if (_wfopen_s(&h, filename, L"rb") == 0) {
-			auto b0 = getc(h);
-			if (b0 == 0xef) {
-				if (getc(h) == 0xbb && getc(h) == 0xbf) {
-					_setmode(_fileno(h), _O_U8TEXT);//8
-					return;
-				}
-			} else if (b0 == 0xff) {
-				if (getc(h) == 0xfe) {
-					_setmode(_fileno(h), _O_U16TEXT);//16le
-					return;
-				}
-			} else if (b0 == 0xfe) {
-				if (getc(h) == 0xff) {
-					_setmode(_fileno(h), _O_U16TEXT);//16be
-					return;
-				}
+// a BufferWriter that drains to a file in large blocks, encoding UTF-16LE as-is or converting to UTF-8
+// endl does not reach the file; everything is written as the buffer fills and on destruction
+struct BufferedFileWriter : BufferWriter, WinFileWriter {
+	enum ENCODING { UTF16LE, UTF8 };
+	ENCODING	encoding;
+	char		*encoded = nullptr;
+	uint64_t	written	= 0;	// in chars
+
+	BufferedFileWriter(const wchar_t *filename, ENCODING encoding = UTF16LE) : WinFileWriter(filename), encoding(encoding) {}
+	~BufferedFileWriter() {
+		drain();
+		free(encoded);
+	}
+
+	void encode(const wchar_t *s, size_t n) {
+		written += n;
+		if (encoding == UTF8) {
+			auto	cap = max(end - buffer, (ptrdiff_t)n) * 3;
+			encoded	= (char*)realloc(encoded, cap);
+			writebuff(encoded, WideCharToMultiByte(CP_UTF8, 0, s, n, encoded, cap, NULL, NULL));
+		} else {
+			writebuff(s, n * sizeof(wchar_t));
+		}
+	}
+
+	void drain() {
+		size_t	n		= p - buffer;
+		// a surrogate pair split across blocks would be lost converting to UTF-8, so the high half waits for the next one
+		size_t	keep	= encoding == UTF8 && n && IS_HIGH_SURROGATE(p[-1]);
+		n -= keep;
+		if (n)
+			encode(buffer, n);
+		clear();
+		if (keep) {
+			*p++ = buffer[n];
+			--carried;
+		}
+	}
+
+	uint64_t position() const { return written + (p - buffer); }
+
+	void make_room(size_t n) override {
+		drain();
+		if (n > size_t(end - p))
+			BufferWriter::make_room(n);
+	}
+
+	// lines end "\r\n" in the file, as regedit writes them
+	size_t write(const wchar_t* s, size_t n) override {
+		for (auto e = s + n; ;) {
+			auto	nl = s;
+			while (nl < e && *nl != '\n')
+				++nl;
+			BufferWriter::write(s, nl - s);
+			if (nl == e)
+				break;
+			BufferWriter::write(L"\r\n", 2);
+			s = nl + 1;
+		}
+		return n;
+	}
+	// text already in the file's form, like a section of a previous export
+	size_t copy(const wchar_t* s, size_t n) {
+		return BufferWriter::write(s, n);
+	}
+};
+
+// stdout, written when the buffer fills, when what is in it has waited LATENCY ms (checked at each endl, and by a thread while nothing is
+// being written), or on drain; so the first results of a slow search still show at once, and a fast one makes a write per buffer, not per line
+struct StdoutWriter : BufferWriter {
+	enum { LATENCY = 50 };
+	enum ENCODING { CONSOLE, UTF8, UTF16LE };
+	HANDLE		h;
+	ENCODING	encoding;
+	char		*encoded	= nullptr;
+	ULONGLONG	since		= 0;		// when the buffer stopped being empty, 0 while it is
+	Mutex		m;
+	Condition	waiting;
+	HANDLE		timer		= nullptr;
+	bool		quit		= false;
+	BufferWriter	header{64};
+
+	// the SERVE request running on this thread, which gets everything written here instead
+	static thread_local TextWriter<wchar_t>	*redirect;
+
+	static DWORD WINAPI timer_proc(void *p) {
+		((StdoutWriter*)p)->timer_loop();
+		return 0;
+	}
+	void timer_loop() {
+		Lock	lock(m);
+		while (!quit) {
+			auto	now = GetTickCount64();
+			if (since && now - since >= LATENCY) {
+				encode_buffer();
+				continue;
+			}
+			waiting.wait(m, since ? DWORD(since + LATENCY - now) : INFINITE);
+		}
+	}
+
+	StdoutWriter() : BufferWriter(64 * 1024), h(GetStdHandle(STD_OUTPUT_HANDLE)) {
+		DWORD	mode;
+		encoding = GetConsoleMode(h, &mode) ? CONSOLE : UTF8;
+	}
+	~StdoutWriter() {
+		if (timer) {
+			{
+				Lock	lock(m);
+				quit = true;
 			}
-			fseek(h, 0, SEEK_SET);
+			waiting.notify();
+			WaitForSingleObject(timer, INFINITE);
+			CloseHandle(timer);
+		}
+		encode_buffer();
+		free(encoded);
+	}
+
+	void encode(const wchar_t *s, size_t n) {
+		DWORD	written;
+		if (encoding == CONSOLE) {
+			WriteConsoleW(h, s, n, &written, NULL);
+		} else if (encoding == UTF8) {
+			auto	cap = max(end - buffer, (ptrdiff_t)n) * 3;
+			encoded	= (char*)realloc(encoded, cap);
+			WriteFile(h, encoded, WideCharToMultiByte(CP_UTF8, 0, s, n, encoded, cap, NULL, NULL), &written, NULL);
+		} else {
+			WriteFile(h, s, n * sizeof(wchar_t), &written, NULL);
+		}
+	}
+
+	// with m held
+	void encode_buffer(bool all = false) {
+		size_t	n		= p - buffer;
+		// a surrogate pair split across writes would be lost converting, so the high half waits for the next one
+		size_t	keep	= !all && encoding != UTF16LE && n && IS_HIGH_SURROGATE(p[-1]);
+		n -= keep;
+		if (n)
+			encode(buffer, n);
+		clear();
+		if (keep) {
+			*p++ = buffer[n];
+			--carried;
+		}
+		since = keep ? GetTickCount64() : 0;
+	}
+
+	void make_room(size_t n) override {
+		encode_buffer();
+		if (n > size_t(end - p))
+			BufferWriter::make_room(n);
+	}
+
+	size_t write(const wchar_t* s, size_t n) override {
+		if (redirect)
+			return redirect->write(s, n);
+		Lock	lock(m);
+		if (!since && n) {
+			since = GetTickCount64();
+			if (!timer)
+				timer = CreateThread(NULL, 0, timer_proc, this, 0, NULL);
+			waiting.notify();
 		}
+		return BufferWriter::write(s, n);
+	}
+
+	// endl calls this; it only writes once there has been something waiting long enough
+	void flush() override {
+		if (redirect)
+			return redirect->flush();
+		Lock	lock(m);
+		if (since && GetTickCount64() - since >= LATENCY)
+			encode_buffer();
 	}
-	~FileReader() { fclose(h); }
-	operator FILE*() const { return h; }
 
-	int readbuff(void* buffer, size_t size) {
-		return fread(buffer, 1, size, h);
+	// where what is written here ends up, for writing to from other threads
+	TextWriter<wchar_t> &target() {
+		return redirect ? *redirect : *this;
 	}
-	template<typename T> bool get(T &t) {
-		return readbuff(&t, sizeof(T)) == sizeof(T);
+
+	// everything written so far goes out now
+	void drain() {
+		Lock	lock(m);
+		encode_buffer();
+	}
+
+	// raw UTF-16LE from now on, for binary output; not for a SERVE request, whose frames are text
+	bool set_binary() {
+		if (redirect)
+			return false;
+		drain();
+		encoding = UTF16LE;
+		return true;
+	}
+
+	// SERVE: a request's output goes out as
+	//	<id> data <n>\n	followed by n UTF-16 units of output (as UTF-8), any number of times
+	//	<id> exit <code>\n
+	// each frame whole, whichever thread sends it
+	void send_frame(string::view id, const wchar_t *s, size_t n) {
+		Lock	lock(m);
+		encode_buffer(true);
+		header.clear();
+		header << id << L" data " << n << L'\n';
+		encode(header.buffer, header.length());
+		encode(s, n);
+	}
+	void send_exit(string::view id, int code) {
+		Lock	lock(m);
+		encode_buffer(true);
+		header.clear();
+		header << id << L" exit " << code << L'\n';
+		encode(header.buffer, header.length());
 	}
 };
 
-FileWriter	out(stdout);
+thread_local TextWriter<wchar_t>	*StdoutWriter::redirect = nullptr;
+
+StdoutWriter	out;
+
+// one SERVE request's output, sent in frames once it fills the buffer or has waited long enough
+struct FrameWriter : BufferWriter {
+	string		id;
+	ULONGLONG	since	= 0;		// when the buffer stopped being empty, 0 while it is
+
+	FrameWriter(string::view id) : BufferWriter(4096), id(id) {}
+
+	void send(bool all) {
+		size_t	n		= p - buffer;
+		// as StdoutWriter, the high half of a split surrogate pair waits for the rest
+		size_t	keep	= !all && n && IS_HIGH_SURROGATE(p[-1]);
+		n -= keep;
+		if (n)
+			out.send_frame(id, buffer, n);
+		clear();
+		if (keep) {
+			*p++ = buffer[n];
+			--carried;
+		}
+		since = keep ? GetTickCount64() : 0;
+	}
+
+	void make_room(size_t n) override {
+		send(false);
+		if (n > size_t(end - p))
+			BufferWriter::make_room(n);
+	}
+	size_t write(const wchar_t* s, size_t n) override {
+		if (!since && n)
+			since = GetTickCount64();
+		return BufferWriter::write(s, n);
+	}
+	void flush() override {
+		if (since && GetTickCount64() - since >= StdoutWriter::LATENCY)
+			send(false);
+	}
+
+	void finish(int code) {
+		send(true);
+		out.send_exit(id, code);
+	}
+};
 
 //-----------------------------------------------------------------------------
 // base
@@ -131,31 +416,11 @@ template<int B, int N = -1, char TEN = 'a', typename T> auto base(T t) {
 //	helpers
 //-----------------------------------------------------------------------------
 
-bool wildcard_check(const wchar_t* line, const wchar_t* pattern, bool anchored = false) {
-	const wchar_t* placeholder = anchored ? nullptr : pattern;
-
-	while (*line && *pattern) {
-		auto c = *pattern++;
-		if (c == '?' || c == *line)
-			line++;
-		else if (c == '*')
-			placeholder = pattern;
-		else if (--pattern == placeholder)
-			line++;
-		else if (placeholder)
-			pattern = placeholder;
-		else
-			return false;
-	}
-
-	return !*pattern && (!anchored || !*line);
-}
-
 auto unescape(string::view v, wchar_t *dest, wchar_t separator = 0) {
 	auto p = dest;
 	for (auto s = v.begin(), e = v.end(); s < e;) {
 		auto c = *s++;
-		if (c == '\\' && s[0]) {
+		if (c == '\\' && s < e) {
 			switch (c = *s++) {
 				case '\\': break;
 				case '"': break;
@@ -174,39 +439,36 @@ auto unescape(string::view v, wchar_t *dest, wchar_t separator = 0) {
 	return p - dest;
 }
 
-auto escape(string::view v, wchar_t *dest, wchar_t separator = 0) {
-	auto p = dest;
-	for (auto s = v.begin(), e = v.end(); s < e;) {
-		auto c = *s++;
-		switch (c) {
-			case '\\': *p++ = '\\'; break;
-			case '"':  *p++ = '\\'; break;
-			case '\0': *p++ = '\\'; c = '0'; break;
-			case '\n': *p++ = '\\'; c = 'n'; break;
-			case '\r': *p++ = '\\'; c = 'r'; break;
-			case '\t': *p++ = '\\'; c = 't'; break;
+// writes v with .reg escapes, copying the runs between escaped chars straight through
+void escape(TextWriter<wchar_t> &w, string::view v, wchar_t separator = 0) {
+	auto run = v.begin();
+	for (auto s = run, e = v.end(); s < e; ++s) {
+		wchar_t	c;
+		switch (*s) {
+			case '\\': c = '\\'; break;
+			case '"':  c = '"'; break;
+			case '\0': c = '0'; break;
+			case '\n': c = 'n'; break;
+			case '\r': c = 'r'; break;
+			case '\t': c = 't'; break;
 			default:
-				if (c == separator) {
-					*p++ = '\\';
-					c = '0';
-				}
+				if (*s != separator)
+					continue;
+				c = '0';
 				break;
 		}
-		*p++ = c;
+		const wchar_t	pair[2] = {'\\', c};
+		w.write(run, s - run);
+		w.write(pair, 2);
+		run = s + 1;
 	}
-	*p = 0;
-	return p - dest;
+	w.write(run, v.end() - run);
 }
+
 /*
 const char *hex = "0123456789abcdef";
 */
 
-auto hexchar(wchar_t c) {
-	return c >= '0' && c <= '9' ? c - '0'
-		: c >= 'A' && c <= 'F' ? c - 'A' + 10
-		: c >= 'a' && c <= 'f' ? c - 'a' + 10
-		: -1;
-}
 //-----------------------------------------------------------------------------
 //	registry stuff
 //-----------------------------------------------------------------------------
@@ -220,9 +482,12 @@ enum class OP : uint8_t {
 	DEL,
 	EXPORT,
 	IMPORT,
-	/* COPY, SAVE, RESTORE,*/
+	SAVE,
+	/* COPY, RESTORE,*/
 	LOAD,
 	UNLOAD,
+	SERVE,
+	WATCH,
 	/* COMPARE, FLAGS*/
 	NUM
 };
@@ -232,11 +497,13 @@ static const wchar_t* ops[] = {
 	L"DELETE",
 	L"EXPORT",
 	L"IMPORT",
+	L"SAVE",
 //	L"COPY",
-//	L"SAVE",
 //	L"RESTORE",
 	L"LOAD",
 	L"UNLOAD",
+	L"SERVE",
+	L"WATCH",
 //	L"COMPARE",
 //	L"FLAGS"
 };
@@ -326,6 +593,14 @@ enum class OPT : uint8_t {
 	type,
 	data,
 	separator,
+	threads,
+	incremental,
+	patterns,
+	depth,
+	ifmodified,
+	interval,
+	hive,
+	import_file,
 
 //bool options
 	all_subkeys	= 0,
@@ -339,6 +614,14 @@ enum class OPT : uint8_t {
 	force,
 	view32,
 	view64,
+	snapshot,
+	regex,
+	unordered,
+	index,
+	jsonl,
+	binary,
+	subkeys_only,
+	counts,
 
 //flags
 	alternative	= 1 << 6,
@@ -369,14 +652,26 @@ static const OPOptions op_options[] = {
 	{OPT::value,		L"v",     	L"ValueName",	L"Queries for a specific registry key values.\nIf omitted, all values for the key are queried.\nArgument to this switch can be optional only when specified along with /f switch. This specifies to search in valuenames only."},
 	{OPT::def_value|OPT::alternative,	L"ve",    	nullptr,		L"Queries for the default value or empty value name (Default)."},
 	{OPT::all_subkeys,	L"s",     	nullptr,		L"Queries all subkeys and values recursively (like dir /s)."},
+	{OPT::depth,		L"depth:",	L"N",			L"Queries subkeys recursively, as /s does, but lists no keys more than N levels below KeyName (1 being its own subkeys).\nThe keys on the last level have their values listed, but not their subkeys."},
+	{OPT::subkeys_only,	L"keysonly",nullptr,		L"Lists subkeys only, without reading any values. With /f, only key names are searched."},
+	{OPT::counts,		L"counts",	nullptr,		L"Follows each subkey listed with its number of subkeys and values."},
+	{OPT::ifmodified,	L"ifmodified:",L"FileTime",	L"Lists the key only if it has been written since FileTime (a last write time: 100ns units since 1601, in decimal), after LastWrite and its new time;\notherwise prints only Unchanged KeyName. Deciding takes one RegQueryInfoKey, and no values are read for an unchanged key.\n/ifmodified:@ListFile checks every line of ListFile, a FileTime then a subkey of KeyName (or nothing, for KeyName itself), printing Missing KeyName for one that is gone or can't be read.\nWith /format:jsonl these are {\"lastwrite\":N}, {\"unchanged\":path} and {\"missing\":path}; with /format:binary, W (the 64-bit time), U and D (the path).\nCan't be used with /s, /f, /patterns, /snapshot or /hive."},
 	{OPT::data,			L"f",     	L"Data",		L"Specifies the data or pattern to search for.\nUse double quotes if a string contains spaces. Default is \"*\"."},
 	{OPT::keys_only,	L"k",     	nullptr,		L"Specifies to search in key names only."},
 	{OPT::data_only,	L"d",     	nullptr,		L"Specifies the search in data only."},
 	{OPT::case_sensitive,L"c",     	nullptr,		L"Specifies that the search is case sensitive.\nThe default search is case insensitive."},
 	{OPT::exact,		L"e",     	nullptr,		L"Specifies to return only exact matches.\nBy default all the matches are returned."},
+	{OPT::regex,		L"r",     	nullptr,		L"Specifies that the /f pattern is a regular expression, found anywhere in the text (or matching all of it with /e).\nSupports . [] [^] \\d \\w \\s \\D \\W \\S * + ? {n,m} ( ) | ^ $"},
 	{OPT::type,			L"t",     	L"Type",		L"Specifies registry value data type.\nValid types are:\nREG_SZ, REG_MULTI_SZ, REG_EXPAND_SZ, REG_DWORD, REG_QWORD, REG_BINARY, REG_NONE\nDefaults to all types."},
 	{OPT::numeric_type,	L"z",     	nullptr,		L"Verbose: Shows the numeric equivalent for the type of the valuename."},
 	{OPT::separator,	L"se",    	L"Separator",	L"Specifies the separator (length of 1 character only) in data string for REG_MULTI_SZ. Defaults to \"\\0\" as the separator."},
+	{OPT::file,			L"snapshot",L"FileName",	L"Queries a snapshot file written by EXPORT /snapshot instead of the registry.\nIf it was written by EXPORT /index, searches only visit the keys its index says could match."},
+	{OPT::hive,			L"hive",	L"HiveFile",	L"Queries a registry hive file (as REG SAVE writes) directly, without loading it. The file's root is taken to be where Windows loads such a hive at: HKCU (or HKCR or HKCC) itself, or a key directly under HKLM or HKU,\nso HKLM\\SOFTWARE\\Microsoft is the Microsoft key of a SOFTWARE hive."},
+	{OPT::threads,		L"threads",	L"N",			L"Number of threads reading subkeys in parallel with /s. Defaults to the number of processors; 1 queries serially.\nThe output is the same as a serial query's."},
+	{OPT::unordered,	L"unordered",nullptr,		L"With /s on more than one thread, writes each key's results as soon as they are found instead of in order."},
+	{OPT::patterns,		L"patterns",L"PatternFile",	L"Searches for every pattern in PatternFile (one per line, taken literally; blank lines and lines starting with ';' are skipped) at once, instead of /f.\nEach match is followed by the patterns that it matched."},
+	{OPT::jsonl,		L"format:jsonl",nullptr,	L"Writes a JSON object per line instead of text: {\"key\":path} for each key (with \"subkeys\":N,\"values\":N for /counts), {\"name\":name,\"type\":N,...} for each of its values that follow,\n{\"matched\":pattern} for /patterns and {\"found\":{...}} at the end of a search.\nThe type is the raw number. A value has \"data\", a string (SZ or EXPAND_SZ, without its terminating 0), a number (DWORD) or a string of decimal digits (QWORD, which a JSON number can't always hold exactly),\nor else \"raw\", its bytes in base64."},
+	{OPT::binary|OPT::alternative,	L"format:binary",nullptr,	L"Writes length-prefixed records: a 16-bit kind ('K', 'V', 'M' or 'F'), a 32-bit length in bytes, then that many bytes, padded to an even length.\nK is a key's path, V a value (32-bit type, 32-bit name length in chars, the name, the data), M a matched pattern and F the 32-bit key, item and value counts of a search;\nwith /counts, each K is followed by N, the key's 32-bit subkey and value counts.\nNames and paths are UTF-16LE, and everything is little-endian."},
 	opt_reg32,
 	opt_reg64,
 	opt_end
@@ -410,6 +705,11 @@ static const OPOptions op_options[] = {
 	opt_key,
 	{OPT::file,			nullptr,	L"FileName",	L"The name of the disk file to export."},
 	{OPT::force,		L"y",     	nullptr,		L"Force overwriting the existing file without prompt."},
+	{OPT::snapshot,		L"snapshot",nullptr,		L"Writes a binary snapshot of the key instead of a .reg file.\nIMPORT and QUERY /snapshot read it back."},
+	{OPT::index,		L"index",	nullptr,		L"Writes a snapshot with a search index of its key names, value names and data, for QUERY /snapshot to answer searches from.\nIf FileName is already one, keys not written since it was made are copied from it instead of being read again."},
+	{OPT::incremental,	L"incremental",L"PrevFile",	L"Copies keys that have not been written since PrevFile was exported from it, instead of reading them again; PrevFile can't be FileName itself.\nPrevFile.manifest (written by the last /incremental export) gives each key's last write time; a FileName.manifest is written for the next one."},
+	{OPT::threads,		L"threads",	L"N",			L"Number of threads reading subkeys in parallel. Defaults to the number of processors; 1 exports serially."},
+	{OPT::hive,			L"hive",	L"HiveFile",	L"Exports from a registry hive file (as REG SAVE writes) directly, without loading it. The file's root is taken to be where Windows loads such a hive at: HKCU (or HKCR or HKCC) itself, or a key directly under HKLM or HKU,\nso HKLM\\SOFTWARE\\Microsoft is the Microsoft key of a SOFTWARE hive."},
 	opt_reg32,
 	opt_reg64,
 	opt_end
@@ -421,6 +721,17 @@ static const OPOptions op_options[] = {
 	opt_reg64,
 	opt_end
 }},
+//SAVE
+{(Option[]){
+	opt_key,
+	{OPT::file,			nullptr,	L"FileName",	L"The name of the hive file to write. Each key's subkey list is followed by its subkeys, each with its values and their small data, so what is read together is together;\nREG LOAD loads it, and QUERY and EXPORT /hive read it."},
+	{OPT::force,		L"y",		nullptr,		L"Force overwriting the existing file without prompt."},
+	{OPT::hive,			L"hive",	L"HiveFile",	L"Saves from a hive file instead of the registry, which compacts it: only its keys, values and security descriptors are copied, not the space it had free.\nKeyName is found in it as QUERY /hive finds it, so HKLM\\SOFTWARE saves the whole of a SOFTWARE hive."},
+	{OPT::import_file,	L"import",	L"RegFile",		L"Saves the keys in a .reg file (or a snapshot written by EXPORT /snapshot) at or below KeyName instead of the registry, without importing them.\nThey are applied in order, as IMPORT would, to what starts as an empty key; keys from a .reg file are given the time of the save and full access for SYSTEM and Administrators."},
+	opt_reg32,
+	opt_reg64,
+	opt_end
+}},
 //LOAD
 {(Option[]){
 	opt_key,
@@ -434,6 +745,23 @@ static const OPOptions op_options[] = {
 	opt_key,
 	opt_end
 }},
+//SERVE
+{(Option[]){
+	{OPT::threads,		L"threads",	L"N",			L"Number of requests run at once. Defaults to the number of processors; 1 runs them one at a time, in order.\nRequests naming the same key start in the order they came, and one that writes to it (ADD, DELETE) waits for those before it to finish, and holds up those after it.\nIMPORT, LOAD and UNLOAD are ordered only with each other."},
+	opt_end
+}},
+//WATCH
+{(Option[]){
+	opt_key,
+	{OPT::all_subkeys,	L"s",		nullptr,		L"Watches all subkeys and values recursively. Otherwise only the key's own values, and which subkeys it has."},
+	{OPT::interval,		L"interval:",L"ms",			L"The least time between looks at the registry, so a burst of changes is reported together. Defaults to 100.\nWhere change notifications aren't available (as on remote machines) the key is polled instead, every ms at first and backing off to 32 times that while nothing changes."},
+	{OPT::numeric_type,	L"z",		nullptr,		L"Verbose: Shows the numeric equivalent for the type of the valuename."},
+	{OPT::separator,	L"se",		L"Separator",	L"Specifies the separator (length of 1 character only) in data string for REG_MULTI_SZ. Defaults to \"\\0\" as the separator."},
+	{OPT::jsonl,		L"format:jsonl",nullptr,	L"Writes a JSON object per line instead of text: {\"watching\":path} once the key has been read, then {\"change\":c,\"key\":path} for each key and\n{\"change\":c,\"name\":name,\"type\":N,...} for each value (as QUERY /format:jsonl, with no type or data for one removed), where c is \"+\", \"-\" or \"*\"."},
+	opt_reg32,
+	opt_reg64,
+	opt_end
+}},
 };
 
 wchar_t *get_options(Option *opts, int argc, wchar_t *argv[], wchar_t **string_args, uint32_t &bool_args) {
@@ -450,6 +778,13 @@ wchar_t *get_options(Option *opts, int argc, wchar_t *argv[], wchar_t **string_a
 		if (a[0] == '/') {
 			bool found = false;
 			for (auto o = opts; o->desc; ++o) {
+				// a switch ending in ':' has its argument joined on
+				auto	len = wcslen(o->sw);
+				if (o->sw[len - 1] == ':' && wcsncmp(a + 1, o->sw, len) == 0) {
+					string_args[(int)o->opt] = a + 1 + len;
+					found = true;
+					break;
+				}
 				if (wcscmp(a + 1, o->sw) == 0) {
 					if (o->arg) {
 						string_args[(int)o->opt] = (*argv)[0] == '/' ? (wchar_t*)L"" : *argv++;
@@ -466,7 +801,7 @@ wchar_t *get_options(Option *opts, int argc, wchar_t *argv[], wchar_t **string_a
 	return nullptr;
 }
 
-void write_command_data(TextWriter<wchar_t> &out, BYTE *data, DWORD size, TYPE type, wchar_t *sep) {
+void write_command_data(TextWriter<wchar_t> &out, const BYTE *data, DWORD size, TYPE type, wchar_t *sep) {
 	switch (type) {
 		case TYPE::SZ:
 		case TYPE::EXPAND_SZ: {
@@ -493,15 +828,15 @@ void write_command_data(TextWriter<wchar_t> &out, BYTE *data, DWORD size, TYPE t
 			break;
 		}
 		case TYPE::DWORD:
-			out << L"0x" << base<16>(*(DWORD*)data);
+			out << L"0x" << base<16>(*(const DWORD*)data);
 			break;
 
 		case TYPE::DWORD_BIG_ENDIAN:
-			out << L"0x" << base<16>(_byteswap_ulong(*(DWORD*)data));
+			out << L"0x" << base<16>(_byteswap_ulong(*(const DWORD*)data));
 			break;
 
 		case TYPE::QWORD:
-			out << L"0x" << base<16>(*(uint64_t*)data);
+			out << L"0x" << base<16>(*(const uint64_t*)data);
 			break;
 
 		default:
@@ -513,6 +848,57 @@ void write_command_data(TextWriter<wchar_t> &out, BYTE *data, DWORD size, TYPE t
 	}
 }
 
+// "data" as a string or number when the value is a well-formed one (so it can be written back exactly), otherwise "raw" with the bytes in base64
+void write_json_data(TextWriter<wchar_t> &out, range<const BYTE*> data, TYPE type) {
+	switch (type) {
+		case TYPE::SZ:
+		case TYPE::EXPAND_SZ: {
+			auto	text = string::view((const wchar_t*)data.begin(), data.size() / 2);
+			if (data.size() % 2 == 0 && text.size() && text.back() == 0 && text.find(L'\0') == text.end() - 1) {
+				out << L"\"data\":";
+				write_json_string(out, string::view(text.begin(), text.end() - 1));
+				return;
+			}
+			break;
+		}
+		case TYPE::DWORD:
+			if (data.size() == 4)
+				return (void)(out << L"\"data\":" << *(const DWORD*)data.begin());
+			break;
+		case TYPE::DWORD_BIG_ENDIAN:
+			if (data.size() == 4)
+				return (void)(out << L"\"data\":" << _byteswap_ulong(*(const DWORD*)data.begin()));
+			break;
+		case TYPE::QWORD:
+			if (data.size() == 8)
+				return (void)(out << L"\"data\":\"" << *(const uint64_t*)data.begin() << L'"');	// as a string, since a JSON number only holds 53 bits exactly
+			break;
+		default:
+			break;
+	}
+	out << L"\"raw\":\"";
+	write_base64(out, data);
+	out << L'"';
+}
+
+// a /format:binary record, written as 16-bit units so it can go through the same writers as text; only the last part may have an odd size
+void write_record(TextWriter<wchar_t> &out, wchar_t kind, range<const byte*> a, range<const byte*> b = {}, range<const byte*> c = {}) {
+	uint32_t	len		= a.size() + b.size() + c.size();
+	wchar_t		head[3]	= {kind, wchar_t(len), wchar_t(len >> 16)};
+	out.write(head, 3);
+	for (auto &part : {a, b, c}) {
+		out.write((const wchar_t*)part.begin(), part.size() / 2);
+		if (part.size() & 1) {
+			wchar_t	last = part.back();
+			out.write(&last, 1);
+		}
+	}
+}
+
+range<const byte*> as_bytes(string::view s) {
+	return {(const byte*)s.begin(), s.size() * sizeof(wchar_t)};
+}
+
 size_t parse_command_data(wchar_t *data, TYPE type, char separator) {
 	switch (type) {
 		case TYPE::NONE:
@@ -529,34 +915,28 @@ size_t parse_command_data(wchar_t *data, TYPE type, char separator) {
 			*(uint64_t*)data = wcstoll(data, nullptr, 10);
 			return 8;
 
-		case TYPE::BINARY: {
-			BYTE *d = (BYTE*)data;
-			for (const wchar_t *p = data; ; p++) {
-				auto d0 = hexchar(p[0]);
-				auto d1 = hexchar(p[1]);
-				if (d0 >= 0 && d1 >= 0)
-					*d++ = (d0 << 4) | d1;
-				p += 2;
-			}
-			return d - (BYTE*)data;
-		}
+		case TYPE::BINARY:
+			return decode_hex(data, data + string_length(data), (byte*)data) - (byte*)data;
+
 		default:
 			return 0;
 	}
 }
 
-void write_reg_data(FileWriter &out, BYTE *data, DWORD size, TYPE type) {
+void write_reg_data(BufferWriter &out, const BYTE *data, DWORD size, TYPE type) {
 	switch (type) {
 		case TYPE::SZ: {
-			auto p = (wchar_t*)malloc(size * 2);
-			escape(string::view((const wchar_t*)data, size / 2 - 1), p);
-			out << L'"' << p << L'"' << endl; 
-			free(p);
+			auto	len = size / 2;
+			if (len && !((const wchar_t*)data)[len - 1])
+				--len;
+			out << L'"';
+			escape(out, string::view((const wchar_t*)data, len));
+			out << L'"' << endl;
 			break;
 		}
 		case TYPE::DWORD:
 //			out << "dword:" << std::setfill(L'0') << std::setw(8) << std::hex << *(DWORD*)data << std::dec << endl;
-			out << L"dword:" << base<16, 8>(*(DWORD*)data) << endl;
+			out << L"dword:" << base<16, 8>(*(const DWORD*)data) << endl;
 			break;
 
 		//case TYPE::QWORD:
@@ -574,7 +954,7 @@ void write_reg_data(FileWriter &out, BYTE *data, DWORD size, TYPE type) {
 				out << base<16,2>(b);
 				if (i != size - 1) {
 					out << L',';
-					if (out.column > 76)
+					if (out.column() > 76)
 						out << L'\\' << endl << L"  ";
 				}
 			}
@@ -583,55 +963,77 @@ void write_reg_data(FileWriter &out, BYTE *data, DWORD size, TYPE type) {
 	}
 }
 
-dynamic_range<byte> parse_reg_data(const string &line, TYPE &type) {
-	dynamic_range<byte>	data;
+// appends the decoded data part of a .reg entry to data; returns false on bad data
+bool parse_reg_data(string::view value, TYPE &type, dynamic_range<byte> &data) {
+	auto	start = data.p - data.a;
 
-	if (line[0] == '"') {
-		auto end = line.find_last('"');
-		if (end) {
+	if (value.size() && value[0] == '"') {
+		auto end = value.find_last('"');
+		if (end && end > value.begin()) {
 			type = TYPE::SZ;
-			auto size = unescape(string::view(line.begin() + 1, end), (wchar_t*)data.ensure((end - line) * 2)) * 2 + 2;
+			auto size = unescape(string::view(value.begin() + 1, end), (wchar_t*)data.ensure((end - value.begin()) * 2)) * 2 + 2;
 			data.alloc(size);
 		}
 
-	} else if (line.startsWith(L"dword:")) {
+	} else if (value.startsWith(L"dword:"_s)) {
+		TextReader<wchar_t>	r(value.begin() + 6, value.size() - 6);
 		type = TYPE::DWORD;
-		*((DWORD*)data.alloc(sizeof(DWORD))) = wcstoul(&line[6], nullptr, 16);
+		*((DWORD*)data.alloc(sizeof(DWORD))) = read_digits<DWORD>(r, 16);
 
-	} else if (line.startsWith(L"qword:")) {
+	} else if (value.startsWith(L"qword:"_s)) {
+		TextReader<wchar_t>	r(value.begin() + 6, value.size() - 6);
 		type = TYPE::QWORD;
-		*((uint64_t*)data.alloc(sizeof(uint64_t))) = wcstoull(&line[6], nullptr, 16);
+		*((uint64_t*)data.alloc(sizeof(uint64_t))) = read_digits<uint64_t>(r, 16);
 
-	} else if (line.startsWith(L"hex")) {
-		auto p = &line[3];
+	} else if (value.startsWith(L"hex"_s)) {
+		TextReader<wchar_t>	r(value.begin() + 3, value.size() - 3);
 	 	type = TYPE::BINARY;
 
-		if (p[0] == '(') {
-			type = (TYPE)wcstoul(p + 1, (wchar_t**)&p, 16);
-			++p;
+		if (r.skip(L'(')) {
+			type = (TYPE)read_digits<uint32_t>(r, 16);
+			r.skip(L')');
 		}
+		r.skip(L':');
 
-		if (p[0] == ':')
-			p++;
-
-		for (;;) {
-			wchar_t	*p2;
-			auto v = wcstoul(p, &p2, 16);
-			if (p == p2)
-				break;
-			*data.alloc(1) = v;
-			p 		= p2;
-			if (*p == ',')
-				++p;
-		}
+		data.p = decode_hex(r.p, r.end, data.ensure(r.available() / 2 + 1));
 	}
-	return data;
+	return data.p - data.a != start;
 }
 
 //-----------------------------------------------------------------------------
 //	RegKey
 //-----------------------------------------------------------------------------
 
+// a value whose name and data point into buffers owned by someone else
+struct ValueView {
+	string::view		name;
+	TYPE				type	= TYPE::NONE;
+	range<const BYTE*>	data;
+	explicit operator bool() const { return !data.empty(); }
+};
+
+// iterates a key's values as ValueViews, reusing the same buffers for each
+template<typename K> struct ValueRange {
+	const K		&key;
+	int			n;
+	wchar_t		*name;
+	BYTE		*data;
+	DWORD		data_size;
+
+	struct iterator {
+		const ValueRange	*r;
+		int					i;
+		ValueView	operator*()							const	{ return r->key.value(i, r->name, r->data, r->data_size); }
+		iterator&	operator++()								{ ++i; return *this; }
+		bool		operator!=(const iterator &b)		const	{ return i != b.i; }
+	};
+	iterator	begin()	const	{ return {this, 0}; }
+	iterator	end()	const	{ return {this, n}; }
+};
+
+struct SharedKey;
+void release(SharedKey *k);
+
 struct RegKey {
 	struct Info {
 		wchar_t	class_name[MAX_PATH] = L"";		// buffer for class name 
@@ -642,11 +1044,12 @@ struct RegKey {
 		DWORD	max_value 	= 0;				// longest value name 
 		DWORD	max_data 	= 0;				// longest value data 
 		DWORD	cbSecurityDescriptor = 0; 		// size of security descriptor 
-		FILETIME last_write;					// last write time 
+		FILETIME last_write	= {0, 0};			// last write time 
+		LSTATUS	status;							// of the query; nothing else means anything if it failed
 
 		Info(HKEY h) {
 			DWORD	class_size = MAX_PATH;		// size of class string 
-			::RegQueryInfoKey(
+			status = ::RegQueryInfoKey(
 				h,								// key handle 
 				class_name,						// buffer for class name 
 				&class_size,					// size of class string 
@@ -672,10 +1075,11 @@ struct RegKey {
 	};
 
 
-	HKEY h = nullptr;
+	HKEY		h		= nullptr;
+	SharedKey	*shared	= nullptr;		// h came from a KeyCache, which closes it once nothing is using it
 
 	RegKey(HKEY h = nullptr)	: h(h) {}
-	RegKey(RegKey &&b) 			: h(b.h) { b.h = nullptr; }
+	RegKey(RegKey &&b) 			: h(b.h), shared(b.shared) { b.h = nullptr; b.shared = nullptr; }
 	RegKey(const wchar_t *k, REGSAM sam = KEY_READ) {
 		auto	subkey	= wcschr(k, '\\');
 		auto 	hive	= get_hive(subkey ? string(k, subkey - k) : string(k));
@@ -688,9 +1092,14 @@ struct RegKey {
 		if (ret != ERROR_SUCCESS)
 			h = nullptr;
 	}
-	~RegKey() { if (h) ::RegCloseKey(h); }
+	~RegKey() {
+		if (shared)
+			release(shared);
+		else if (h)
+			::RegCloseKey(h);
+	}
 
-	RegKey& operator=(RegKey &&b) { swap(h, b.h); return *this; }
+	RegKey& operator=(RegKey &&b) { swap(h, b.h); swap(shared, b.shared); return *this; }
 
 	operator HKEY()		const { return h; }
 	auto info() 		const { return Info(h); }
@@ -705,6 +1114,19 @@ struct RegKey {
 			: Value();
 	}
 
+	// name needs room for MAX_VALUE_NAME chars
+	ValueView value(int i, wchar_t *name, BYTE *data, DWORD data_size) const {
+		DWORD 	name_size 	= MAX_VALUE_NAME;
+		DWORD	type		= 0;
+		auto 	ret		= ::RegEnumValue(h, i, name, &name_size, NULL, &type, data, &data_size);
+		if (ret != ERROR_SUCCESS)
+			return {};
+		return {string::view(name, name_size), (TYPE)type, {data, data_size}};
+	}
+	auto values(int n, wchar_t *name, BYTE *data, DWORD data_size) const {
+		return ValueRange<RegKey>{*this, n, name, data, data_size};
+	}
+
 	auto value(const wchar_t *name, BYTE *data, DWORD data_size) const {
 		DWORD	type		= 0;
 		auto 	ret		= ::RegQueryValueEx(h, name, 0, &type, data, &data_size);
@@ -723,6 +1145,24 @@ struct RegKey {
 		);
 		return ret == ERROR_SUCCESS ? string(name) : string();
 	}
+	string::view subkey(int i, wchar_t (&name)[MAX_KEY_LENGTH + 1]) const {
+		DWORD 	name_size	= MAX_KEY_LENGTH + 1;
+		auto 	ret			= ::RegEnumKeyEx(h, i, name, &name_size, NULL, NULL, NULL, NULL);
+		return ret == ERROR_SUCCESS ? string::view(name, name_size) : string::view();
+	}
+	// with its last write time too
+	string::view subkey(int i, wchar_t (&name)[MAX_KEY_LENGTH + 1], uint64_t &last_write) const {
+		DWORD 		name_size	= MAX_KEY_LENGTH + 1;
+		FILETIME	time;
+		auto 		ret			= ::RegEnumKeyEx(h, i, name, &name_size, NULL, NULL, NULL, &time);
+		if (ret != ERROR_SUCCESS)
+			return string::view();
+		last_write = (uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+		return string::view(name, name_size);
+	}
+	RegKey open_subkey(int i, const wchar_t *name, REGSAM sam = KEY_READ) const {
+		return RegKey(h, name, sam);
+	}
 
 	auto set_value(const wchar_t *name, TYPE type, BYTE *data, DWORD size) {
 		return ::RegSetValueEx(h, name, 0, (int)type, data, size);
@@ -733,442 +1173,2740 @@ struct RegKey {
 	}
 };
 
-//-----------------------------------------------------------------------------
-//	Reg
-//-----------------------------------------------------------------------------
-
-struct ParsedKey {
-	string	host;
-	HIVE	hive;
-	string	subkey;
+// the same interface over a key in a snapshot, for QUERY to read a snapshot file instead of the registry
+struct SnapshotKey {
+	struct Info {
+		DWORD		num_subkeys = 0, num_values = 0, max_data = 0;
+		FILETIME	last_write	= {0, 0};
+	};
+	static_assert(sizeof(wchar_t) == sizeof(char16_t), "snapshot names are UTF-16");
 
-	ParsedKey(string::view k) {
-		auto p = k.begin();
-		if (p[0] == '\\' && p[1] == '\\') {
-			auto a = p + 2;
-			p 		= wcschr(a, '\\');
-			host	= string(a, p++);
-		}
+	const Snapshot	&s;
+	int				i;
+	uint32_t		end;		// of the keys below it that a walk may reach; see Snapshot::subkey
 
-		auto a	= p;
-		p		= wcschr(p, '\\');
-		if (p)
-			subkey = string(p + 1, k.end());
-		else
-			p = k.end();
+	SnapshotKey(const Snapshot &s, int i, uint32_t end) : s(s), i(i), end(end) {}
+	SnapshotKey(const Snapshot &s, int i) : SnapshotKey(s, i, s.header->num_keys) {}
+	explicit operator bool() const { return i >= 0; }
 
-		hive	= get_hive(string(a, p).toupper());
+	const wchar_t *name(uint64_t offset) const {
+		auto	n = s.name(offset);
+		return n.empty() ? L"" : (const wchar_t*)n.begin();
 	}
-
-	HKEY get_rootkey() {
-		auto h = hive_to_hkey(hive);
-		if (!host.empty()) {
-			auto ret = RegConnectRegistry(host, h, &h);
-			if (ret != ERROR_SUCCESS)
-				return nullptr;
+	Info info() const {
+		Info	info;
+		if (i >= 0) {
+			auto	&k = s.key(i);
+			info = {s.num_subkeys(i), s.num_values(i), k.max_data, {DWORD(k.last_write), DWORD(k.last_write >> 32)}};
 		}
-		return h;
+		return info;
 	}
-	auto get_keyname() {
-		string	key = hives[(int)hive][0];
-		return subkey ? key + L'\\' + subkey : key;
+	RegKey::Value value(int v, BYTE *data, DWORD data_size) const {
+		auto	r = i >= 0 ? s.value(i, v) : nullptr;
+		if (!r)
+			return {};
+		auto	d = s.data(*r);
+		if (d.size() > data_size)
+			return {};
+		if (data)
+			memcpy(data, d.begin(), d.size());
+		return RegKey::Value(name(r->name), (TYPE)r->type, d.size());
 	}
-
-	auto open_key(REGSAM sam, HKEY *h) {
-		return RegOpenKeyEx(get_rootkey(), subkey, 0, sam, h);
+	// names and data are used straight out of the mapping
+	ValueView value(int v, wchar_t *, BYTE *, DWORD) const {
+		auto	r = i >= 0 ? s.value(i, v) : nullptr;
+		if (!r)
+			return {};
+		auto	n = s.name(r->name);
+		return {string::view((const wchar_t*)n.begin(), n.size()), (TYPE)r->type, s.data(*r)};
 	}
-	auto delete_key(REGSAM sam) {
-		return RegDeleteKeyEx(get_rootkey(), subkey, sam, 0);
+	auto values(int n, wchar_t *name, BYTE *data, DWORD data_size) const {
+		return ValueRange<SnapshotKey>{*this, n, name, data, data_size};
 	}
-	auto create_key(REGSAM sam, HKEY *h) {
-		return RegCreateKeyEx(get_rootkey(), subkey, 0, NULL, REG_OPTION_NON_VOLATILE, sam, NULL, h, NULL);
+	int sub(int n, uint32_t &sub_end) const {
+		sub_end = end;
+		return i >= 0 ? s.subkey(i, n, sub_end) : -1;
+	}
+	string subkey(int n) const {
+		uint32_t	e;
+		auto		k = sub(n, e);
+		return k >= 0 ? string(name(s.key(k).name)) : string();
+	}
+	string::view subkey(int n, wchar_t (&)[MAX_KEY_LENGTH + 1]) const {
+		uint32_t	e;
+		auto		k = sub(n, e);
+		if (k < 0)
+			return {};
+		auto	name = s.name(s.key(k).name);
+		return string::view((const wchar_t*)name.begin(), name.size());
+	}
+	SnapshotKey open_subkey(int n, const wchar_t *name, REGSAM sam = KEY_READ) const {
+		uint32_t	e;
+		auto		k = sub(n, e);
+		return SnapshotKey(s, k, e);
 	}
 };
 
-struct Reg {
-	union {
-		wchar_t *string_args[6] = {nullptr};
-		struct {
-			wchar_t *key, *value, *file, *type, *data, *sep;
-		};
-	};
-
-	union {
-		uint32_t	bool_args	= 0;
-		struct {
-			bool all_subkeys 		: 1;
-			bool all_values 		: 1;
-			bool def_value 			: 1;
-			bool numeric_type 		: 1;
-			bool keys_only			: 1;
-			bool data_only			: 1;
-			bool case_sensitive		: 1;
-			bool exact	 			: 1;
-			bool force 	 			: 1;
-			bool view32 			: 1;
-			bool view64 			: 1;
-		};
-	};
-	bool	values_only	= false;
-	TYPE	types_only	= TYPE::NUM;
-	wchar_t separator	= L'\0';
-
-	int		found_keys	= 0, found_values = 0, found_data = 0;
+snapshot_name to_snapshot(string::view v) {
+	return {(const char16_t*)v.begin(), v.size()};
+}
 
-	REGSAM	get_sam() const {
-		REGSAM	sam = 0;
-		if (view32)
-			sam |= KEY_WOW64_32KEY;
-		else if (view64)
-			sam |= KEY_WOW64_64KEY;
-		return sam;
+// the subkey of key called name, or -1; hint is where to start looking, and is left just after the one found
+int find_snapshot_subkey(const Snapshot &s, uint32_t key, string::view name, uint32_t &hint) {
+	auto	n = s.num_subkeys(key);
+	for (uint32_t j = 0; j < n; j++) {
+		auto	c	= (hint + j) % n;
+		auto	sub	= s.subkey(key, c);
+		if (sub >= 0) {
+			auto	sn = s.name(s.key(sub).name);
+			if (sn.size() == name.size() && _wcsnicmp((const wchar_t*)sn.begin(), name.begin(), name.size()) == 0) {
+				hint = c + 1;
+				return sub;
+			}
+		}
 	}
+	return -1;
+}
 
-	bool check_value(const string &name) {
-		return !value || !value[0] || wildcard_check((case_sensitive ? name : name.tolower()), value, true);
+// keyname is a full path, which may be the snapshot's root or anything below it
+int find_snapshot_key(const Snapshot &s, string::view keyname) {
+	auto	root	= s.name(s.key(0).name);
+	if (keyname.size() < root.size() || _wcsnicmp(keyname.begin(), (const wchar_t*)root.begin(), root.size()) != 0)
+		return -1;
+
+	int		key		= 0;
+	auto	p		= keyname.begin() + root.size();
+	if (p < keyname.end() && *p != '\\')
+		return -1;
+
+	while (key >= 0 && p < keyname.end()) {
+		auto		a		= p + 1;
+		uint32_t	hint	= 0;
+		p			= string::view(a, keyname.end()).find('\\');
+		key			= find_snapshot_subkey(s, key, string::view(a, p), hint);
 	}
-	bool check_data(const string &name) {
-		return exact
-			? (case_sensitive ? name : name.tolower()) == data
-			: wildcard_check((case_sensitive ? name : name.tolower()), data);
+	return key;
+}
 
-	}
-	void query(const RegKey &r, string keyname, bool print_key);
+// what a search through an index visits: the keys that could match, whose values are all it reads, and the keys above them
+// (or every key, when the search prints them all anyway)
+struct IndexedView {
+	enum { HIDDEN, ABOVE, CANDIDATE };
+	const Snapshot			&s;
+	dynamic_range<byte>		shown;
+	dynamic_range<uint32_t>	first, count;	// per key, its shown subkeys in children
+	dynamic_range<uint32_t>	children;
+
+	IndexedView(const Snapshot &s, const dynamic_range<uint32_t> &candidates, bool all_keys) : s(s) {
+		auto	n		= s.header->num_keys;
+		auto	shown	= (byte*)memset(this->shown.alloc(n), all_keys ? ABOVE : HIDDEN, n);
+
+		// each key's parent and where its run of keys ends (see Snapshot::subkey), as a walk from the root finds them; a parent comes
+		// before its subkeys, so one pass does it, and a key no walk reaches is left with no end
+		auto	parents	= (uint32_t*)malloc(n * sizeof(uint32_t));
+		auto	ends	= (uint32_t*)calloc(n, sizeof(uint32_t));
+		memset(parents, 0xff, n * sizeof(uint32_t));
+		ends[0] = n;
+		for (uint32_t k = 0; k < n; k++) {
+			for (uint32_t c = 0, nc = ends[k] ? s.num_subkeys(k) : 0; c < nc; c++) {
+				auto	e	= ends[k];
+				auto	sub	= s.subkey(k, c, e);
+				if (sub >= 0) {
+					parents[sub]	= k;
+					ends[sub]		= e;
+				}
+			}
+		}
 
+		if (all_keys) {
+			for (auto k : make_range(candidates.begin(), candidates.p))
+				shown[k] = CANDIDATE;
+		} else {
+			for (auto k : make_range(candidates.begin(), candidates.p)) {
+				shown[k] = CANDIDATE;
+				for (auto a = parents[k]; a != ~0u && !shown[a]; a = parents[a])
+					shown[a] = ABOVE;
+			}
+		}
 
-	int doQUERY();
-	int doADD();
-	int doDELETE();
-	int doEXPORT();
-	int doIMPORT();
-//	int doCOPY()	{ return 0; }
-//	int doSAVE()	{ return 0; }
-//	int doRESTORE() { return 0; }
-	int doLOAD();
-	int doUNLOAD();
-//	int doCOMPARE() { return 0; }
-//	int doFLAGS()	{ return 0; }
+		auto	first = this->first.alloc(n), count = this->count.alloc(n);
+		for (uint32_t k = 0; k < n; k++) {
+			first[k] = children.p - children.begin();
+			count[k] = 0;
+			for (uint32_t c = 0, nc = shown[k] && ends[k] ? s.num_subkeys(k) : 0; c < nc; c++) {
+				auto	e	= ends[k];
+				auto	sub	= s.subkey(k, c, e);
+				if (sub >= 0 && shown[sub]) {
+					*children.alloc(1) = sub;
+					++count[k];
+				}
+			}
+		}
+		free(parents);
+		free(ends);
+	}
+	int child(int i, uint32_t n) const {
+		return i >= 0 && n < count.begin()[i] ? children.begin()[first.begin()[i] + n] : -1;
+	}
 };
 
-//-----------------------------------------------------------------------------
-// query
+struct IndexedKey : SnapshotKey {
+	const IndexedView	&v;
+
+	IndexedKey(const IndexedView &v, int i) : SnapshotKey(v.s, i), v(v) {}
+	Info info() const {
+		auto	info = SnapshotKey::info();
+		if (i >= 0) {
+			info.num_subkeys = v.count.begin()[i];
+			if (v.shown.begin()[i] != IndexedView::CANDIDATE)
+				info.num_values = 0;
+		}
+		return info;
+	}
+	string::view subkey(int n, wchar_t (&)[MAX_KEY_LENGTH + 1]) const {
+		auto	sub = v.child(i, n);
+		if (sub < 0)
+			return {};
+		auto	name = s.name(s.key(sub).name);
+		return string::view((const wchar_t*)name.begin(), name.size());
+	}
+	IndexedKey open_subkey(int n, const wchar_t *name, REGSAM sam = KEY_READ) const {
+		return IndexedKey(v, v.child(i, n));
+	}
+};
+
+// the same interface over a key in a hive file, for QUERY and EXPORT to read one without loading it into the registry
+struct HiveKey {
+	struct Info {
+		DWORD		num_subkeys = 0, num_values = 0, max_data = 0;
+		FILETIME	last_write	= {0, 0};
+	};
+	static_assert(sizeof(wchar_t) == sizeof(char16_t), "hive names are UTF-16");
+
+	const Hive				&h;
+	uint32_t				offset;
+	const HiveKeyNode		*k;
+	mutable Hive::Cursor	cursor;		// subkeys are mostly gone through in order
+
+	HiveKey(const Hive &h, uint32_t offset) : h(h), offset(offset), k(offset == Hive::NONE ? nullptr : h.key(offset)) {}
+	explicit operator bool() const { return !!k; }
+
+	// UTF-16 names are used where they lie; compressed ones are widened into buffer
+	static string::view name(const HiveName &n, wchar_t *buffer, size_t room) {
+		if (!n.compressed)
+			return string::view((const wchar_t*)n.p, n.size / 2);
+		auto	len = min<size_t>(n.size, room);
+		for (size_t i = 0; i < len; i++)
+			buffer[i] = n.p[i];
+		return string::view(buffer, len);
+	}
+
+	Info info() const {
+		Info	info;
+		if (k) {
+			info.num_subkeys	= h.num_subkeys(*k);
+			info.num_values		= h.num_values(*k);
+			info.last_write		= {DWORD(k->last_write), DWORD(k->last_write >> 32)};
+			// the buffer values are read into only holds data joined from a db
+			for (uint32_t i = 0; i < info.num_values; i++) {
+				if (auto v = h.value(*k, i))
+					info.max_data = max(info.max_data, h.buffer_size(*v));
+			}
+		}
+		return info;
+	}
+	// name needs room for MAX_VALUE_NAME chars
+	ValueView value(int i, wchar_t *name, BYTE *data, DWORD data_size) const {
+		auto	v = k ? h.value(*k, i) : nullptr;
+		if (!v)
+			return {};
+		return {HiveKey::name(Hive::name(*v), name, MAX_VALUE_NAME), (TYPE)v->type, h.data(*v, data, data_size)};
+	}
+	auto values(int n, wchar_t *name, BYTE *data, DWORD data_size) const {
+		return ValueRange<HiveKey>{*this, n, name, data, data_size};
+	}
+	string subkey(int n) const {
+		wchar_t	name[MAX_KEY_LENGTH + 1];
+		return string(subkey(n, name));
+	}
+	string::view subkey(int n, wchar_t (&name)[MAX_KEY_LENGTH + 1]) const {
+		auto	sub = k ? h.key(h.subkey(offset, n, cursor)) : nullptr;
+		return sub ? HiveKey::name(Hive::name(*sub), name, MAX_KEY_LENGTH + 1) : string::view();
+	}
+	HiveKey open_subkey(int n, const wchar_t *name, REGSAM sam = KEY_READ) const {
+		return HiveKey(h, k ? h.subkey(offset, n, cursor) : Hive::NONE);
+	}
+};
+
+// the key at path (subkeys separated by '\'; empty for key itself) below key, or Hive::NONE
+uint32_t find_hive_subkey(const Hive &h, uint32_t key, string::view path) {
+	wchar_t	buffer[MAX_KEY_LENGTH + 1];
+	for (auto p = path.begin(); key != Hive::NONE && p < path.end();) {
+		auto	a		= p;
+		p				= string::view(a, path.end()).find('\\');
+		auto	name	= string::view(a, p);
+		p				+= p < path.end();
+		if (name.empty())
+			continue;
+
+		HiveKey	parent(h, key);
+		key = Hive::NONE;
+		for (uint32_t i = 0, n = parent ? h.num_subkeys(*parent.k) : 0; i < n; i++) {
+			if (compare_folded(parent.subkey(i, buffer), name) == 0) {
+				key = h.subkey(parent.offset, i, parent.cursor);
+				break;
+			}
+		}
+	}
+	return key;
+}
+
+// a key below root by its path from there
+inline RegKey	open_path(const RegKey &root, const string &path)	{ return RegKey(root, path); }
+inline HiveKey	open_path(const HiveKey &root, const string &path)	{ return HiveKey(root.h, find_hive_subkey(root.h, root.offset, path)); }
+
+// only registry keys hold anything open; keys in a snapshot are never closed to make room
+inline bool close_key(RegKey &k)	{ k = RegKey(); return true; }
+template<typename K> bool close_key(K &k) { return false; }
+inline void reopen_key(RegKey &k, const RegKey &from, const wchar_t *path, REGSAM sam) { k = RegKey(from.h, path, sam); }
+template<typename K> void reopen_key(K &k, const K &from, const wchar_t *path, REGSAM sam) {}
+
+//-----------------------------------------------------------------------------
+//	TreeWalk - visits a key and everything below it depth first, without recursing
+//	the path is appended to and cut back in one buffer, and at most MAX_OPEN keys on the way down are held open; one closed to make room
+//	is opened again, by its path from the nearest one still open, when the walk gets back to it
+//
+//	the visitor has
+//		bool enter(TreeWalk&, const K&, const Info&)		at each key; false skips its values
+//		void value(TreeWalk&, const ValueView&)				each value
+//		bool subkeys(TreeWalk&, const K&, const Info&)		after the values; false skips the subkeys
+//		bool subkey(TreeWalk&, const K &parent, int i, const wchar_t *name)
+//															each subkey, with its name on the end of the path; false leaves it unvisited
+//		bool leave(TreeWalk&, const K *parent, const wchar_t *name)
+//															after the subkeys, with the key closed (parent is null at the root); true if the
+//															key is now gone, so its later siblings have moved up one
 //-----------------------------------------------------------------------------
 
-void Reg::query(const RegKey &r, string keyname, bool printed_key) {
-	auto info 		= r.info();
-	auto tab		= L"    ";
-	auto space		= (BYTE*)malloc(info.max_data + 1);
+struct TreeWalk {
+	enum { MAX_OPEN = 64 };
+	struct Frame {
+		DWORD	next, num_subkeys;
+		size_t	end;		// of the key's path
+		bool	closed;
+	};
+	dynamic_range<wchar_t>	path;		// of the current key, always followed by a 0
+	dynamic_range<Frame>	frames;		// the root's first
+	dynamic_range<byte>		keys;		// open keys below the root, of whatever type is being walked
+	dynamic_range<byte>		data;
+	wchar_t					value_name[MAX_VALUE_NAME];
+	REGSAM					sam			= KEY_READ;
+
+	string::view	keyname()	const	{ return {path.begin(), path.p}; }
+	int				depth()		const	{ return int(frames.p - frames.begin()) - 1; }
+	size_t			push(string::view name) {
+		size_t	len	= path.p - path.begin();
+		auto	p	= path.alloc(name.size() + !!len);
+		if (len)
+			*p++ = '\\';
+		memcpy(p, name.begin(), name.size() * sizeof(wchar_t));
+		*path.ensure(1) = 0;
+		return len;
+	}
+	void			pop(size_t len) {
+		path.p	= path.begin() + len;
+		*path.ensure(1) = 0;
+	}
 
-	// Enumerate the values
-	if (!data || data_only || values_only) {
-		for (int i = 0; i < info.num_values; i++) {
-			if (auto value = r.value(i, space, info.max_data)) {
-				if (!check_value(value.name))
-					continue;
+	template<typename K> const K &key(const K &root, int d) {
+		if (d == 0)
+			return root;
+		auto	k	= (K*)keys.begin() + d - 1;
+		auto	f	= frames.begin() + d;
+		if (f->closed) {
+			auto	a = d - 1;
+			while (a && frames.begin()[a].closed)
+				--a;
+			auto	end	= path.begin() + f->end, from = path.begin() + frames.begin()[a].end + 1;
+			auto	c	= *end;
+			*end = 0;
+			reopen_key(*k, key(root, a), from, sam);
+			*end = c;
+			f->closed = false;
+		}
+		return *k;
+	}
+
+	template<typename K, typename V> void visit(const K &k, V &visitor) {
+		auto	info = k.info();
+		if (visitor.enter(*this, k, info)) {
+			for (auto value : k.values(info.num_values, value_name, data.ensure(info.max_data + 1), info.max_data)) {
+				if (value)
+					visitor.value(*this, value);
+			}
+		}
+		frames.p[-1].num_subkeys = visitor.subkeys(*this, k, info) ? info.num_subkeys : 0;
+	}
+
+	// the path should already be root's
+	template<typename K, typename V> void walk(const K &root, V &visitor) {
+		frames.p	= frames.begin();
+		keys.p		= keys.begin();
+		*path.ensure(1)		= 0;
+		*frames.alloc(1)	= {0, 0, size_t(path.p - path.begin()), false};
+		visit(root, visitor);
 
-				if (types_only != TYPE::NUM && value.type != types_only)
+		for (;;) {
+			// room for one more, so neither moves while referred to
+			keys.ensure(sizeof(K));
+			frames.ensure(1);
+			auto	&f		= frames.p[-1];
+			auto	&parent	= key(root, depth());
+
+			if (f.next < f.num_subkeys) {
+				wchar_t	buffer[MAX_KEY_LENGTH + 1];
+				auto	i	= f.next++;
+				auto	sub	= parent.subkey(i, buffer);
+				if (sub.empty())
 					continue;
 
-				bool values_pass	= !values_only || check_data(value.name);
+				auto	len		= push(sub);
+				auto	name	= path.p - sub.size();
+				if (!visitor.subkey(*this, parent, i, name)) {
+					pop(len);
+					continue;
+				}
+				auto	child	= new(keys.alloc(sizeof(K))) K(parent.open_subkey(i, name, sam));
+				*frames.alloc(1) = {0, 0, size_t(path.p - path.begin()), false};
+				if (depth() > MAX_OPEN && close_key(((K*)keys.begin())[depth() - MAX_OPEN - 1]))
+					frames.begin()[depth() - MAX_OPEN].closed = true;
+				visit(*child, visitor);
+
+			} else if (depth() == 0) {
+				visitor.leave(*this, (const K*)nullptr, path.begin());
+				break;
 
-				string	data_string;
-				if (data_only || values_pass) {
-					StringBuilder	b(data_string);
-					write_command_data(b, space, value.size, value.type, sep);
+			} else {
+				keys.p -= sizeof(K);
+				((K*)keys.p)->~K();
+				--frames.p;
+				auto	&up		= frames.p[-1];
+				auto	gone	= visitor.leave(*this, &key(root, depth()), path.begin() + up.end + 1);
+				pop(up.end);
+				if (gone) {
+					--up.next;
+					--up.num_subkeys;
 				}
+			}
+		}
+	}
+};
 
-				bool data_pass		= !data_only || check_data(data_string);
-				
-				if (values_only && data_only ? values_pass || data_pass : values_pass && data_pass) {
-					found_values	+= values_pass;
-					found_data		+= data_pass;
+//-----------------------------------------------------------------------------
+//	Reg
+//-----------------------------------------------------------------------------
 
-					if (!printed_key) {
-						out << keyname << endl;
-						printed_key = true;
-					}
+//-----------------------------------------------------------------------------
+//	KeyCache - recently opened keys by host, case-folded path and access, reused to open the same key again or anything below it;
+//	and one connection per remote hive, kept until exit
+//	past MAX_KEYS the least recently used are dropped, but a key stays open while anything is using it
+//-----------------------------------------------------------------------------
+
+struct SharedKey {
+	SharedKey		*next;				// in its bucket
+	SharedKey		*newer, *older;		// in order of use
+	string			path;
+	REGSAM			sam;
+	HKEY			h;
+	LONG volatile	refs;				// one while it is cached, and one per RegKey using it
+};
+
+void release(SharedKey *k) {
+	if (!InterlockedDecrement(&k->refs)) {
+		RegCloseKey(k->h);
+		delete k;
+	}
+}
+
+struct KeyCache {
+	enum { NUM_BUCKETS = 1024, MAX_KEYS = 1024 };
+	struct Connection {
+		Connection	*next;
+		string		host;
+		HKEY		hive, h;
+	};
+	Mutex		m;
+	SharedKey	*buckets[NUM_BUCKETS] = {};
+	SharedKey	*newest = nullptr, *oldest = nullptr;
+	int			num_keys	= 0;
+	Connection	*connections = nullptr;
+	uint64_t	hits = 0, near_hits = 0, misses = 0, connects = 0;	// near_hits missed, but were opened from a cached key above them
+
+	~KeyCache() {
+		forget(L"");
+		while (auto c = connections) {
+			connections = c->next;
+			RegCloseKey(c->h);
+			delete c;
+		}
+	}
+
+	static uint32_t hash(string::view path) {
+		uint32_t	h = 2166136261u;
+		for (auto c : path)
+			h = (h ^ c) * 16777619u;
+		return h % NUM_BUCKETS;
+	}
 
-					out << tab;
-					if (value.name.length())
-						out << value.name;
-					else
-						out << L"(Default)";
-					out << tab << types[value.type < TYPE::NUM ? (int)value.type : 0];
+	// the rest with m held
+	SharedKey *find(string::view path, REGSAM sam) {
+		auto	k = buckets[hash(path)];
+		while (k && (k->sam != sam || string::view(k->path) != path))
+			k = k->next;
+		return k;
+	}
+	void unlink(SharedKey *k) {
+		(k->newer ? k->newer->older : newest) = k->older;
+		(k->older ? k->older->newer : oldest) = k->newer;
+	}
+	void make_newest(SharedKey *k) {
+		k->newer	= nullptr;
+		k->older	= newest;
+		(newest ? newest->newer : oldest) = k;
+		newest		= k;
+	}
+	void drop(SharedKey *k) {
+		auto	link = &buckets[hash(k->path)];
+		while (*link != k)
+			link = &(*link)->next;
+		*link = k->next;
+		unlink(k);
+		--num_keys;
+		release(k);
+	}
+	static void share(SharedKey *k, RegKey &key) {
+		InterlockedIncrement(&k->refs);
+		key			= RegKey();
+		key.h		= k->h;
+		key.shared	= k;
+	}
 
-					if (numeric_type)
-						out << L" (" << (int)value.type << L')';
+	// hive's root on host ("" for this machine)
+	HKEY root(string::view host, HKEY hive) {
+		if (!host.size())
+			return hive;
+		Lock	lock(m);
+		for (auto c = connections; c; c = c->next) {
+			if (c->hive == hive && string::view(c->host) == host)
+				return c->h;
+		}
+		HKEY	h;
+		++connects;
+		if (RegConnectRegistry(string(host), hive, &h) != ERROR_SUCCESS)
+			return nullptr;
+		connections = new Connection{connections, string(host), hive, h};
+		return h;
+	}
 
-					out << tab << data_string << endl;
+	// subkey (which may be null) of root, where path is the folded name of the whole key, ending with subkey
+	LSTATUS open(HKEY root, const wchar_t *subkey, string::view path, REGSAM sam, RegKey &key) {
+		auto		view	= sam & (KEY_WOW64_32KEY | KEY_WOW64_64KEY);
+		auto		sublen	= subkey ? string_length(subkey) : 0;
+		auto		top		= path.begin() + path.size() - sublen;		// past the hive, which is root
+		SharedKey	*from	= nullptr;
+		bool		hit		= false;
+		{
+			Lock	lock(m);
+			if (auto k = find(path, sam)) {
+				++hits;
+				unlink(k);
+				make_newest(k);
+				share(k, key);
+				hit = true;
+			}
+			// the nearest key above it that's open in the same view; the access it was opened with doesn't matter for opening below it
+			for (auto e = path.end(); !hit && !from;) {
+				while (--e > top && *e != '\\')
+					;
+				if (e <= top)
+					break;
+				auto	above = string::view(path.begin(), e);
+				for (from = buckets[hash(above)]; from; from = from->next) {
+					if ((from->sam & (KEY_WOW64_32KEY | KEY_WOW64_64KEY)) == view && string::view(from->path) == above)
+						break;
 				}
 			}
+			if (from) {
+				InterlockedIncrement(&from->refs);
+				unlink(from);
+				make_newest(from);
+				++near_hits;
+			} else if (!hit) {
+				++misses;
+			}
+		}
+
+		// another process may have deleted the key (and maybe made it again) since it was cached, which the handle only says when used
+		if (hit) {
+			if (RegQueryInfoKey(key.h, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL) != ERROR_KEY_DELETED)
+				return ERROR_SUCCESS;
+			key = RegKey();
+			forget(path);
+			return open(root, subkey, path, sam, key);
+		}
+
+		// opened without the lock so a slow open holds nobody else up; if another request got there first meanwhile, theirs is kept
+		HKEY	h;
+		auto	ret = from
+			? RegOpenKeyEx(from->h, subkey + sublen - (path.size() - from->path.length() - 1), 0, sam, &h)
+			: RegOpenKeyEx(root, subkey, 0, sam, &h);
+		if (from) {
+			if (ret == ERROR_KEY_DELETED)
+				forget(from->path);
+			release(from);
+			if (ret == ERROR_KEY_DELETED)
+				return open(root, subkey, path, sam, key);
+		}
+		if (ret)
+			return ret;
+
+		Lock	lock(m);
+		auto	k = find(path, sam);
+		if (k) {
+			RegCloseKey(h);
+			unlink(k);
+		} else {
+			auto	&bucket = buckets[hash(path)];
+			k		= new SharedKey{bucket, nullptr, nullptr, string(path), sam, h, 1};
+			bucket	= k;
+			if (++num_keys > MAX_KEYS)
+				drop(oldest);
+		}
+		make_newest(k);
+		share(k, key);
+		return ERROR_SUCCESS;
+	}
+
+	// the key at path and everything below it (which may have been deleted); "" is everything
+	void forget(string::view path) {
+		Lock	lock(m);
+		for (auto k = newest; k;) {
+			auto	older	= k->older;
+			auto	p		= string::view(k->path);
+			if (p.startsWith(path) && (!path.size() || p.size() == path.size() || p.begin()[path.size()] == '\\'))
+				drop(k);
+			k = older;
+		}
+	}
+};
+
+KeyCache	key_cache;
+
+struct ParsedKey {
+	string	host;
+	HIVE	hive;
+	string	subkey;
+
+	ParsedKey(string::view k) {
+		auto p = k.begin();
+		if (k.size() > 2 && p[0] == '\\' && p[1] == '\\') {
+			auto a = p + 2;
+			p 		= string::view(a, k.end()).find('\\');
+			host	= string(a, p);
+			p		+= p < k.end();
 		}
 
-		if (printed_key)
+		auto a	= p;
+		p		= string::view(p, k.end()).find('\\');
+		if (p < k.end())
+			subkey = string(p + 1, k.end());
+
+		hive	= get_hive(string(a, p).toupper());
+	}
+
+	HKEY get_rootkey() {
+		return key_cache.root(host, hive_to_hkey(hive));
+	}
+	auto get_keyname() const {
+		string	key = hives[(int)hive][0];
+		return subkey ? key + L'\\' + subkey : key;
+	}
+
+	// what KeyCache and SERVE's ordering know a key by: its host and full name, case-folded
+	string folded() const {
+		string	key = hive < HIVE::NUM ? hives[(int)hive][0] : L"";
+		if (subkey)
+			key = key + L'\\' + subkey;
+		if (host)
+			key = L"\\\\" + host + L'\\' + key;
+		for (auto &c : key)
+			c = fold_case(c);
+		return key;
+	}
+
+	auto open_key(REGSAM sam, HKEY *h) {
+		return RegOpenKeyEx(get_rootkey(), subkey, 0, sam, h);
+	}
+	// through the cache, so shared with anything else that opens it
+	LSTATUS open(REGSAM sam, RegKey &key) {
+		return key_cache.open(get_rootkey(), subkey, folded(), sam, key);
+	}
+	auto delete_key(REGSAM sam) {
+		return RegDeleteKeyEx(get_rootkey(), subkey, sam, 0);
+	}
+	auto create_key(REGSAM sam, HKEY *h) {
+		return RegCreateKeyEx(get_rootkey(), subkey, 0, NULL, REG_OPTION_NON_VOLATILE, sam, NULL, h, NULL);
+	}
+};
+
+struct QueryTask;
+struct ParallelQuery;
+
+// everything a query (or one thread of a parallel one) changes as it goes, reused so once it has grown to fit visiting a key allocates nothing
+struct QueryScratch {
+	TextWriter<wchar_t>		*out	= &::out;
+	TreeWalk				walk;
+	int						depth	= 0;	// of the walk's root, below the queried key
+	BufferWriter			text{256};	// the current value's data, as printed
+
+	int						found_keys	= 0, found_values = 0, found_data = 0;
+	Regex					regex;		// its DFA is built as it goes, so each thread needs its own
+
+	// which patterns the current key or value has matched, each listed once
+	dynamic_range<uint32_t>	hits;
+	dynamic_range<uint32_t>	hit_item;	// per pattern, the item it was last listed for
+	uint32_t				item		= 0;
+
+	// for a parallel query
+	ParallelQuery			*parallel	= nullptr;
+	BufferWriter			output{4096};
+	QueryTask				*task		= nullptr;
+	int						worker		= 0;
+
+	string::view	keyname()	const	{ return walk.keyname(); }
+	void			next_item() {
+		++item;
+		hits.p = hits.begin();
+	}
+};
+
+struct Reg {
+	union {
+		wchar_t *string_args[14] = {nullptr};
+		struct {
+			wchar_t *key, *value, *file, *type, *data, *sep, *threads, *incremental, *patterns, *depth, *ifmodified, *interval, *hive, *import_file;
+		};
+	};
+
+	union {
+		uint32_t	bool_args	= 0;
+		struct {
+			bool all_subkeys 		: 1;
+			bool all_values 		: 1;
+			bool def_value 			: 1;
+			bool numeric_type 		: 1;
+			bool keys_only			: 1;
+			bool data_only			: 1;
+			bool case_sensitive		: 1;
+			bool exact	 			: 1;
+			bool force 	 			: 1;
+			bool view32 			: 1;
+			bool view64 			: 1;
+			bool snapshot			: 1;
+			bool regex				: 1;
+			bool unordered			: 1;
+			bool index				: 1;
+			bool jsonl				: 1;
+			bool binary				: 1;
+			bool subkeys_only		: 1;
+			bool counts				: 1;
+		};
+	};
+	bool	values_only	= false;
+	bool	searching	= false;	// /f or /patterns
+	int		max_depth	= 0;		// /depth, or 0 for no limit
+	TYPE	types_only	= TYPE::NUM;
+	wchar_t separator	= L'\0';
+
+	Wildcard	value_match, data_match;
+	MultiMatch	patterns_match;
+
+	REGSAM	get_sam() const {
+		REGSAM	sam = 0;
+		if (view32)
+			sam |= KEY_WOW64_32KEY;
+		else if (view64)
+			sam |= KEY_WOW64_64KEY;
+		return sam;
+	}
+
+	bool check_value(string::view name) const {
+		return !value || !value[0] || value_match(name);
+	}
+	bool check_data(QueryScratch &scratch, string::view name) const {
+		if (patterns_match)
+			return check_patterns(scratch, name);
+		if (regex)
+			return scratch.regex(name);
+		return !exact ? data_match(name)
+			: case_sensitive ? name == string::view(data)
+			: equal_folded(name, data);
+	}
+	bool check_patterns(QueryScratch &scratch, string::view name) const {
+		bool	found = false;
+		patterns_match.scan(name, [&](uint32_t i, const wchar_t *end) {
+			if (exact && (end != name.end() || patterns_match.length(i) != name.size()))
+				return;
+			found = true;
+			if (scratch.hit_item.begin()[i] != scratch.item) {
+				scratch.hit_item.begin()[i] = scratch.item;
+				*scratch.hits.alloc(1) = i;
+			}
+		});
+		return found;
+	}
+	bool text_output() const { return !jsonl && !binary; }
+
+	// with /counts, the key's own subkey and value counts too
+	void print_key(QueryScratch &scratch, DWORD num_subkeys = 0, DWORD num_values = 0) const {
+		auto	&out = *scratch.out;
+		if (jsonl) {
+			out << L"{\"key\":";
+			write_json_string(out, scratch.keyname());
+			if (counts)
+				out << L",\"subkeys\":" << num_subkeys << L",\"values\":" << num_values;
+			out << L'}' << endl;
+		} else if (binary) {
+			write_record(out, 'K', as_bytes(scratch.keyname()));
+			if (counts) {
+				DWORD	n[2] = {num_subkeys, num_values};
+				write_record(out, 'N', {(const byte*)n, sizeof(n)});
+			}
+		} else {
+			out << scratch.keyname();
+			if (counts)
+				out << L"    " << num_subkeys << L" subkey(s)    " << num_values << L" value(s)";
 			out << endl;
+		}
+	}
+	// /ifmodified: LastWrite goes before the key it is for, Unchanged or Missing instead of it
+	void print_last_write(QueryScratch &scratch, uint64_t time) const {
+		auto	&out = *scratch.out;
+		if (jsonl)
+			out << L"{\"lastwrite\":" << time << L'}' << endl;
+		else if (binary)
+			write_record(out, 'W', {(const byte*)&time, sizeof(time)});
+		else
+			out << L"LastWrite " << time << endl;
 	}
+	void print_unchanged(QueryScratch &scratch, bool missing) const {
+		auto	&out = *scratch.out;
+		if (jsonl) {
+			out << (missing ? L"{\"missing\":" : L"{\"unchanged\":");
+			write_json_string(out, scratch.keyname());
+			out << L'}' << endl;
+		} else if (binary) {
+			write_record(out, missing ? 'D' : 'U', as_bytes(scratch.keyname()));
+		} else {
+			out << (missing ? L"Missing " : L"Unchanged ") << scratch.keyname() << endl;
+		}
+	}
+	// WATCH: the key being looked at was added ('+'), removed ('-') or had values change ('*'); ' ' is the key being watched, once it has been read
+	void print_change(QueryScratch &scratch, wchar_t mark) const {
+		auto	&out = *scratch.out;
+		if (jsonl) {
+			if (mark == ' ')
+				out << L"{\"watching\":";
+			else
+				out << L"{\"change\":\"" << mark << L"\",\"key\":";
+			write_json_string(out, scratch.keyname());
+			out << L'}' << endl;
+		} else if (mark == ' ') {
+			out << L"Watching " << scratch.keyname() << endl;
+		} else {
+			out << mark << scratch.keyname() << endl;
+		}
+	}
+	// whether to go into a subkey at depth; a keys-only query has nothing to read from the keys on the last level
+	bool descend(int depth) const {
+		return all_subkeys && (!subkeys_only || !max_depth || depth < max_depth);
+	}
+	// WATCH marks each value '+' (added), '*' (changed) or '-' (removed, so only the name is printed)
+	void print_value(QueryScratch &scratch, const ValueView &value, string::view data_string, wchar_t mark = 0) const {
+		auto	&out	= *scratch.out;
+		auto	tab		= L"    ";
+		if (jsonl) {
+			out << L'{';
+			if (mark)
+				out << L"\"change\":\"" << mark << L"\",";
+			out << L"\"name\":";
+			write_json_string(out, value.name);
+			if (mark != '-') {
+				out << L",\"type\":" << (int)value.type << L',';
+				write_json_data(out, value.data, value.type);
+			}
+			out << L'}' << endl;
 
-	free(space);
+		} else if (binary) {
+			uint32_t	head[2] = {(uint32_t)value.type, (uint32_t)value.name.size()};
+			write_record(out, 'V', {(const byte*)head, sizeof(head)}, as_bytes(value.name), value.data);
 
-	// Enumerate the subkeys
-	for (int i = 0; i < info.num_subkeys; i++) {
-		auto name = r.subkey(i);
-		if (name.length()) {
-			auto check = !keys_only || check_data(name);
-			if (check) {
-				out << keyname << L'\\' << name << endl;
-				++found_keys;
+		} else {
+			out << tab;
+			if (mark)
+				out << mark;
+			if (value.name.size())
+				out << value.name;
+			else
+				out << L"(Default)";
+			if (mark == '-') {
+				out << endl;
+				return;
+			}
+			out << tab << types[value.type < TYPE::NUM ? (int)value.type : 0];
+
+			if (numeric_type)
+				out << L" (" << (int)value.type << L')';
+
+			out << tab << data_string << endl;
+		}
+	}
+	void print_hits(QueryScratch &scratch, const wchar_t *indent) const {
+		auto	&out = *scratch.out;
+		for (auto i : make_range(scratch.hits.begin(), scratch.hits.p)) {
+			auto	pattern = patterns_match.pattern(i);
+			if (jsonl) {
+				out << L"{\"matched\":";
+				write_json_string(out, pattern);
+				out << L'}' << endl;
+			} else if (binary) {
+				write_record(out, 'M', as_bytes(pattern));
+			} else {
+				out << indent << L"Matched: " << pattern << endl;
 			}
-			if (all_subkeys)
-				query(RegKey(r, name, KEY_READ | get_sam()), keyname + L"\\" + name, check);
 		}
 	}
+	void print_found(const QueryScratch &scratch) const;
+	bool prepare(QueryScratch &scratch) const;
+	bool index_candidates(const SearchIndex &index, const QueryScratch &scratch, dynamic_range<uint32_t> &keys) const;
+	bool split(const RegKey &r, QueryScratch &scratch, int depth, bool printed_key, size_t header) const;
+	bool split(const SnapshotKey &r, QueryScratch &scratch, int depth, bool printed_key, size_t header) const { return false; }
+	bool split(const HiveKey &r, QueryScratch &scratch, int depth, bool printed_key, size_t header) const { return false; }
+	template<typename K> void query(const K &r, QueryScratch &scratch, bool print_key) const;
+
+
+	int doQUERY();
+	int query_modified(const ParsedKey &parsed, const RegKey &root, QueryScratch &scratch) const;
+	int doADD();
+	int doDELETE();
+	int doEXPORT();
+	template<typename K> int export_keys(const K &root, const string &keyname);
+	int doIMPORT();
+//	int doCOPY()	{ return 0; }
+	int doSAVE();
+//	int doRESTORE() { return 0; }
+	int doLOAD();
+	int doUNLOAD();
+	int doSERVE();
+	int doWATCH();
+//	int doCOMPARE() { return 0; }
+//	int doFLAGS()	{ return 0; }
+};
+
+//-----------------------------------------------------------------------------
+// query
+//-----------------------------------------------------------------------------
+
+int load_patterns(const wchar_t *file, MultiMatch &m, bool fold);
+
+// compiles what a scratch needs its own copy of
+bool Reg::prepare(QueryScratch &scratch) const {
+	if (data && regex && !scratch.regex.compile(data, !case_sensitive, exact))
+		return false;
+	scratch.walk.sam = KEY_READ | get_sam();
+	memset(scratch.hit_item.alloc(patterns_match.count()), 0, patterns_match.count() * sizeof(uint32_t));
+	return true;
 }
 
-int Reg::doQUERY() {
-	ParsedKey	parsed(key);
-	HKEY		h;
-	if (auto ret = parsed.open_key(KEY_READ | get_sam(), &h))
-		return ret;
+// the keys a search could match, going by the trigrams any match must have; false if that rules nothing out
+bool Reg::index_candidates(const SearchIndex &index, const QueryScratch &scratch, dynamic_range<uint32_t> &keys) const {
+	// data printed with another separator isn't what was indexed
+	if (data_only && wcscmp(sep, L"\\0") != 0)
+		return false;
+
+	if (patterns_match) {
+		auto	n		= index.header->num_keys;
+		auto	marks	= (byte*)calloc(n, 1);
+		bool	narrowed = true;
+		dynamic_range<uint32_t>	found;
+		for (uint32_t i = 0; i < patterns_match.count() && narrowed; i++) {
+			narrowed = index.narrow(patterns_match.pattern(i), found, true);
+			for (auto k : make_range(found.begin(), found.p))
+				marks[k] = 1;
+		}
+		for (uint32_t k = 0; k < n && narrowed; k++) {
+			if (marks[k])
+				*keys.alloc(1) = k;
+		}
+		free(marks);
+		return narrowed;
+	}
 
-	if (!case_sensitive) {
-		if (data) {
-			for (auto p = data; *p; ++p)
-				*p = tolower(*p);
+	if (regex) {
+		auto	&literal = scratch.regex.literal;
+		return literal.p > literal.begin() && index.narrow(string::view(literal.begin(), literal.p - 1), keys, true);
+	}
+
+	if (exact)
+		return index.narrow(data, keys, true);
+
+	// every piece between wildcards
+	bool	all = true;
+	for (auto p = data; *p;) {
+		auto	e = p;
+		while (*e && *e != '*' && *e != '?')
+			++e;
+		if (index.narrow(string::view(p, e), keys, all))
+			all = false;
+		p = e + !!*e;
+	}
+	return !all;
+}
+
+// a subtree of a parallel query, run as one job; its output is its own text with the output of the subtrees it handed off spliced in where they belong
+struct QueryTask {
+	struct Piece {
+		wchar_t		*text;
+		size_t		len;
+		QueryTask	*child;		// whose output follows the text
+	};
+	string					keyname;
+	string					header;		// unordered, the lines for the key that its parent wrote
+	int						depth;
+	bool					printed_key;
+	dynamic_range<Piece>	pieces;		// these two guarded by ParallelQuery::m
+	bool					done	= false;
+
+	QueryTask(string::view keyname, int depth, bool printed_key) : keyname(keyname), depth(depth), printed_key(printed_key) {}
+	size_t	num_pieces() const { return pieces.p - pieces.begin(); }
+};
+
+// subkeys are handed off as jobs while the worker that found them has few waiting; otherwise it walks them itself
+// ordered, the main thread writes each task's pieces in turn, waiting for them as need be, so the output is just what a serial query writes;
+// unordered, workers write whole keys as they finish them
+struct ParallelQuery {
+	enum { MAX_WAITING = 2, SEAL_SIZE = 1 << 16 };
+	const Reg		&reg;
+	HKEY			root;
+	size_t			root_len;	// of the queried key's name
+	TextWriter<wchar_t>	&dest	= out.target();	// caught on the thread that starts the query
+	bool			ordered;
+	StealingPool	pool;
+	QueryScratch	*scratch;	// one per worker
+	Mutex			m;
+	Condition		ready;
+
+	ParallelQuery(const Reg &reg, HKEY root, size_t root_len, int threads, bool ordered) : reg(reg), root(root), root_len(root_len), ordered(ordered), pool(threads) {
+		scratch = new QueryScratch[pool.num_threads];
+		for (int i = 0; i < pool.num_threads; i++) {
+			reg.prepare(scratch[i]);
+			scratch[i].out		= &scratch[i].output;
+			scratch[i].parallel	= this;
+			scratch[i].worker	= i;
 		}
-		if (value) {
-			for (auto p = value; *p; ++p)
-				*p = tolower(*p);
+	}
+	~ParallelQuery() {
+		pool.wait();
+		delete[] scratch;
+	}
+
+	// hands on what the task has written so far (up to keep, which stays), to be followed by child's output
+	void seal(QueryScratch &s, QueryTask *child, size_t keep = ~size_t(0)) {
+		auto	len		= min(s.output.length(), keep);
+		if (!ordered) {
+			if (len) {
+				Lock	lock(m);
+				dest.write(s.output.buffer, len);
+			}
+		} else {
+			auto	text	= (wchar_t*)malloc(max(len, size_t(1)) * sizeof(wchar_t));
+			memcpy(text, s.output.buffer, len * sizeof(wchar_t));
+			{
+				Lock	lock(m);
+				*s.task->pieces.alloc(1) = {text, len, child};
+			}
+			ready.notify_all();
 		}
+		auto	rest	= s.output.length() - len;
+		memmove(s.output.buffer, s.output.buffer + len, rest * sizeof(wchar_t));
+		s.output.p = s.output.buffer + rest;
 	}
 
-	if (!sep)
-		sep = (wchar_t*)L"\\0";
+	void run(QueryTask *task, int w) {
+		auto	&s	= scratch[w];
+		s.task		= task;
+		s.depth		= task->depth;
+		s.walk.pop(0);
+		s.walk.push(task->keyname);
+		if (task->header.length())
+			s.output << task->header;
+		auto	path = task->keyname.length() > root_len ? task->keyname.begin() + root_len + 1 : L"";
+		reg.query(RegKey(root, path, KEY_READ | reg.get_sam()), s, task->printed_key);
+
+		seal(s, nullptr);
+		if (!ordered) {
+			delete task;
+			return;
+		}
+		{
+			Lock	lock(m);
+			task->done = true;
+		}
+		ready.notify_all();
+	}
 
-	values_only = value && !*value;
-	if (data && !values_only && !data_only && !keys_only)
-		data_only = keys_only = values_only = true;	//now they mean 'as well'
+	// the subkey at the end of the path (at depth) becomes a job of its own; unordered, what has been written for it since header goes
+	// with it, so nothing can come between a key's lines
+	void split(QueryScratch &s, int depth, bool printed_key, size_t header) {
+		auto	task = new QueryTask(s.keyname(), depth, printed_key);
+		if (!ordered) {
+			task->header	= string(string::view(s.output.buffer + header, s.output.p));
+			s.output.p		= s.output.buffer + header;
+		}
+		seal(s, task);
+		pool.submit([this, task](int w) { run(task, w); }, s.worker);
+	}
+
+	void write(QueryTask *task) {
+		for (size_t i = 0;; i++) {
+			QueryTask::Piece	piece;
+			{
+				Lock	lock(m);
+				while (i == task->num_pieces() && !task->done)
+					ready.wait(m);
+				if (i == task->num_pieces())
+					break;
+				piece = task->pieces.begin()[i];
+			}
+			dest.write(piece.text, piece.len);
+			free(piece.text);
+			if (piece.child) {
+				write(piece.child);
+				delete piece.child;
+			}
+		}
+	}
+
+	void query(string::view keyname) {
+		auto	task = new QueryTask(keyname, 0, false);
+		pool.submit([this, task](int w) { run(task, w); });
+		if (ordered) {
+			write(task);
+			delete task;
+		}
+		pool.wait();
+	}
+};
+
+// header is where the lines for this subkey start in the output
+bool Reg::split(const RegKey &r, QueryScratch &scratch, int depth, bool printed_key, size_t header) const {
+	auto	q = scratch.parallel;
+	if (!q)
+		return false;
+	if (scratch.output.length() > ParallelQuery::SEAL_SIZE) {
+		q->seal(scratch, nullptr, header);
+		header = 0;
+	}
+	if (q->pool.waiting(scratch.worker) >= ParallelQuery::MAX_WAITING)
+		return false;
+	q->split(scratch, depth, printed_key, header);
+	return true;
+}
+
+template<typename K> void Reg::query(const K &root, QueryScratch &scratch, bool printed_key) const {
+	struct Visitor {
+		const Reg		&reg;
+		QueryScratch	&scratch;
+		bool			printed_key;	// of the key being entered, by its parent
+		bool			values;
+		DWORD			num_subkeys, num_values;	// of the key being entered, for /counts if its values print it
+
+		bool enter(TreeWalk &w, const K &r, const typename K::Info &info) {
+			num_subkeys	= info.num_subkeys;
+			num_values	= info.num_values;
+			return values = !reg.subkeys_only && (!reg.searching || reg.data_only || reg.values_only);
+		}
+
+		void value(TreeWalk &w, const ValueView &value) {
+			if (!reg.check_value(value.name))
+				return;
+
+			if (reg.types_only != TYPE::NUM && value.type != reg.types_only)
+				return;
+
+			scratch.next_item();
+			bool values_pass	= !reg.values_only || reg.check_data(scratch, value.name);
+
+			scratch.text.clear();
+			if (reg.data_only || (values_pass && reg.text_output()))
+				write_command_data(scratch.text, value.data.begin(), value.data.size(), value.type, reg.sep);
+
+			auto data_string	= string::view(scratch.text.buffer, scratch.text.length());
+			bool data_pass		= !reg.data_only || reg.check_data(scratch, data_string);
+
+			if (reg.values_only && reg.data_only ? values_pass || data_pass : values_pass && data_pass) {
+				scratch.found_values	+= values_pass;
+				scratch.found_data		+= data_pass;
+
+				if (!printed_key) {
+					reg.print_key(scratch, num_subkeys, num_values);
+					printed_key = true;
+				}
+				reg.print_value(scratch, value, data_string);
+				reg.print_hits(scratch, L"        ");
+			}
+		}
+
+		bool subkeys(TreeWalk &w, const K &r, const typename K::Info &info) {
+			if (values && printed_key && reg.text_output())
+				*scratch.out << endl;
+			return !reg.max_depth || scratch.depth + w.depth() < reg.max_depth;
+		}
+
+		bool subkey(TreeWalk &w, const K &r, int i, const wchar_t *name) {
+			auto	depth	= scratch.depth + w.depth() + 1;
+			auto	header	= scratch.output.length();
+			scratch.next_item();
+			auto	check	= !reg.keys_only || reg.check_data(scratch, string::view(name, w.path.p));
+			if (check) {
+				if (reg.counts) {
+					auto	sub = r.open_subkey(i, name, w.sam).info();
+					reg.print_key(scratch, sub.num_subkeys, sub.num_values);
+				} else {
+					reg.print_key(scratch);
+				}
+				reg.print_hits(scratch, L"    ");
+				++scratch.found_keys;
+			}
+			printed_key = check;
+			return reg.descend(depth) && !reg.split(r, scratch, depth, check, header);
+		}
+
+		bool leave(TreeWalk &w, const K *parent, const wchar_t *name) {
+			return false;
+		}
+	};
+
+	Visitor	v{*this, scratch, printed_key, false, 0, 0};
+	scratch.walk.walk(root, v);
+}
+
+// a hive file's root stands for the key Windows loads such a hive at: HKCU (or HKCR or HKCC) itself, or a key directly under HKLM or
+// HKU, whatever that is called
+uint32_t find_hive_key(const Hive &h, const ParsedKey &parsed) {
+	string::view	path = parsed.subkey;
+	if (parsed.hive == HIVE::HKPD || parsed.hive >= HIVE::NUM)
+		return Hive::NONE;
+	if (parsed.hive == HIVE::HKLM || parsed.hive == HIVE::HKU) {
+		if (path.empty())
+			return Hive::NONE;
+		auto	p = path.find('\\');
+		path = string::view(p + (p < path.end()), path.end());
+	}
+	return find_hive_subkey(h, h.root(), path);
+}
+
+int Reg::doQUERY() {
+	ParsedKey	parsed(key);
+	RegKey		root;
+	if (binary && !out.set_binary()) {
+		out << L"/format:binary is not available over SERVE" << endl;
+		return ERROR_INVALID_PARAMETER;
+	}
+	if (file && hive) {
+		out << L"/snapshot and /hive can't be used together" << endl;
+		return ERROR_INVALID_PARAMETER;
+	}
+	if (!file && !hive) {
+		if (auto ret = parsed.open(KEY_READ | get_sam(), root))
+			return ret;
+	}
+
+	if (!case_sensitive) {
+		if (data && !regex) {
+			for (auto p = data; *p; ++p)
+				*p = fold_case(*p);
+		}
+		if (value) {
+			for (auto p = value; *p; ++p)
+				*p = fold_case(*p);
+		}
+	}
+
+	if (!sep)
+		sep = (wchar_t*)L"\\0";
+
+	if (depth && (max_depth = wcstol(depth, nullptr, 10)) > 0)
+		all_subkeys = true;
+
+	if (patterns) {
+		if (auto ret = load_patterns(patterns, patterns_match, !case_sensitive))
+			return ret;
+	}
+
+	searching	= data || patterns;
+	values_only = value && !*value;
+	if (subkeys_only) {
+		keys_only	= searching;
+		values_only = data_only = false;
+	}
+	if (searching && !values_only && !data_only && !keys_only)
+		data_only = keys_only = values_only = true;	//now they mean 'as well'
+
+
+	types_only = type ? get_type(type) : TYPE::NUM;
+
+	if (value)
+		value_match.compile(value, true, !case_sensitive);
+	if (data && !regex)
+		data_match.compile(data, false, !case_sensitive);
+
+	QueryScratch	scratch;
+	if (!prepare(scratch)) {
+		out << L"Invalid regular expression: " << scratch.regex.error << endl;
+		return ERROR_INVALID_PARAMETER;
+	}
+
+	if (ifmodified) {
+		if (all_subkeys || searching || file || hive) {
+			out << L"/ifmodified checks keys one at a time, so can't be used with /s, /f, /patterns, /snapshot or /hive" << endl;
+			return ERROR_INVALID_PARAMETER;
+		}
+		return query_modified(parsed, root, scratch);
+	}
+
+	int		num	= threads ? wcstol(threads, nullptr, 10) : num_cpus();
+	if (file) {
+		WinFileMapping	mapped(file);
+		if (!mapped)
+			return GetLastError();
+		Snapshot		snap(mapped.data());
+		if (!snap) {
+			out << L"Not a snapshot file: " << file << endl;
+			return ERROR_BAD_FORMAT;
+		}
+		auto	keyname = parsed.get_keyname();
+		auto	i		= find_snapshot_key(snap, keyname);
+		if (i < 0)
+			return ERROR_FILE_NOT_FOUND;
+		scratch.walk.push(keyname);
+
+		SearchIndex				index(mapped.data(), snap.header->size, snap.header->num_keys);
+		dynamic_range<uint32_t>	candidates;
+		if (searching && index && index_candidates(index, scratch, candidates)) {
+			IndexedView	view(snap, candidates, !keys_only);	// which means every subkey is printed
+			query(IndexedKey(view, i), scratch, false);
+		} else {
+			query(SnapshotKey(snap, i), scratch, false);
+		}
+
+	} else if (hive) {
+		WinFileMapping	mapped(hive);
+		if (!mapped)
+			return GetLastError();
+		Hive			h(mapped.data());
+		if (!h) {
+			out << L"Not a hive file: " << hive << endl;
+			return ERROR_BAD_FORMAT;
+		}
+		HiveKey			r(h, find_hive_key(h, parsed));
+		if (!r)
+			return ERROR_FILE_NOT_FOUND;
+		scratch.walk.push(parsed.get_keyname());
+		query(r, scratch, false);
+
+	} else if (all_subkeys && num > 1) {
+		auto			keyname = parsed.get_keyname();
+		ParallelQuery	parallel(*this, root, keyname.length(), num, !unordered);
+		parallel.query(keyname);
+		for (auto &i : make_range(parallel.scratch, parallel.pool.num_threads)) {
+			scratch.found_keys		+= i.found_keys;
+			scratch.found_values	+= i.found_values;
+			scratch.found_data		+= i.found_data;
+		}
+
+	} else {
+		scratch.walk.push(parsed.get_keyname());
+		query(root, scratch, false);
+	}
+
+	if (searching)
+		print_found(scratch);
+	return 0;
+}
+
+void Reg::print_found(const QueryScratch &scratch) const {
+	if (jsonl) {
+		out << L"{\"found\":{";
+		if (keys_only)
+			out << L"\"keys\":" << scratch.found_keys;
+		if (values_only)
+			out << onlyif(keys_only, L",") << L"\"items\":" << scratch.found_values;
+		if (data_only)
+			out << onlyif(keys_only || values_only, L",") << L"\"values\":" << scratch.found_data;
+		out << L"}}" << endl;
+
+	} else if (binary) {
+		uint32_t	found[3] = {uint32_t(scratch.found_keys), uint32_t(scratch.found_values), uint32_t(scratch.found_data)};
+		write_record(out, 'F', {(const byte*)found, sizeof(found)});
+
+	} else {
+		out << L"End of search: ";
+		if (keys_only)
+			out << scratch.found_keys << L" key(s)";
+		if (values_only)
+			out << onlyif(keys_only, L", ") << scratch.found_values << L" item(s)";
+		if (data_only)
+			out << onlyif(keys_only || values_only, L", ") << scratch.found_data << L" values(s)";
+		out << L" found.";
+	}
+}
+
+//-----------------------------------------------------------------------------
+// add
+//-----------------------------------------------------------------------------
+
+int Reg::doADD() {
+	ParsedKey	parsed(key);
+	auto 		access = KEY_ALL_ACCESS | get_sam();
+	HKEY		h;
+
+	auto ret = parsed.create_key(access, &h);
+	if (ret != ERROR_SUCCESS || (!value && !def_value))
+		return ret;
+
+	wchar_t separator = L'\0';
+	if (sep) {
+		if (unescape(sep, sep) != 1)
+			return ERROR_INVALID_FUNCTION;//bad sep
+		separator = sep[0];
+	}{}
+
+	TYPE	itype = get_type(type);
+	if (itype == TYPE::NUM)
+		return 1;
+
+	DWORD	size = parse_command_data(data, itype, separator);
+	RegKey	r(h);
+	return r.set_value(value, itype, (BYTE*)data, size);
+}
+
+//-----------------------------------------------------------------------------
+// delete
+//-----------------------------------------------------------------------------
+
+// removes every key below the one walked, leaving it empty; each goes once the walk has left it, so all of its own subkeys are gone
+struct DeleteVisitor {
+	LSTATUS	ret = 0;	// the last failure, if any
+
+	bool enter(TreeWalk &w, const RegKey &key, const RegKey::Info &info)				{ return false; }
+	void value(TreeWalk &w, const ValueView &value)										{}
+	bool subkeys(TreeWalk &w, const RegKey &key, const RegKey::Info &info)				{ return true; }
+	bool subkey(TreeWalk &w, const RegKey &parent, int i, const wchar_t *name)			{ return true; }
+	bool leave(TreeWalk &w, const RegKey *parent, const wchar_t *name) {
+		if (!parent)
+			return false;
+		auto	r = RegDeleteKeyEx(*parent, name, w.sam, 0);
+		if (r)
+			ret = r;
+		return !r;
+	}
+};
+
+int Reg::doDELETE() {
+	ParsedKey	parsed(key);
+	auto 		access = KEY_ALL_ACCESS | get_sam();
+
+	if (!value && !def_value && !all_values) {
+		RegKey		root;
+		if (auto ret = parsed.open(access, root))
+			return ret;
+
+		// the subkeys have to go first, deepest first
+		TreeWalk		walk;
+		DeleteVisitor	v;
+		walk.sam = access;
+		walk.push(parsed.get_keyname());
+		walk.walk(root, v);
+		auto	ret = v.ret ? v.ret : parsed.delete_key(access);
+		key_cache.forget(parsed.folded());
+		return ret;
+	}
+
+	RegKey		r;
+	if (auto ret = parsed.open(access, r))
+		return ret;
+
+	if (all_values) {
+		auto 	info	= r.info();
+		for (int i = 0; i < info.num_values; i++) {
+			if (auto value = r.value(i, nullptr, 0)) {
+				if (auto ret = r.remove_value(value.name))
+					return ret;
+			}
+		}
+		return 0;
+	}
+
+	return r.remove_value(value);
+}
+
+//-----------------------------------------------------------------------------
+// import
+//-----------------------------------------------------------------------------
+
+// the whole file as UTF-16; a UTF-16LE file (what EXPORT writes) is used straight out of the mapping
+struct RegFileText : WinFileMapping {
+	wchar_t			*converted	= nullptr;
+	string::view	text;
+
+	RegFileText(const wchar_t *filename) : WinFileMapping(filename) {
+		auto	d = data();
+		if (Snapshot::is_snapshot(d)) {
+			// left for doIMPORT to read as it is
+
+		} else if (d.size() >= 2 && d[0] == 0xff && d[1] == 0xfe) {
+			text = string::view((const wchar_t*)(d.begin() + 2), (d.size() - 2) / 2);
+
+		} else if (d.size() >= 2 && d[0] == 0xfe && d[1] == 0xff) {
+			auto	n	= (d.size() - 2) / 2;
+			converted	= (wchar_t*)malloc(n * sizeof(wchar_t));
+			for (size_t i = 0; i < n; i++)
+				converted[i] = (d[2 + i * 2] << 8) | d[3 + i * 2];
+			text = string::view(converted, n);
+
+		} else if (d.size() >= 2 && d[1] == 0) {
+			text = string::view((const wchar_t*)d.begin(), d.size() / 2);
+
+		} else {
+			if (d.size() >= 3 && d[0] == 0xef && d[1] == 0xbb && d[2] == 0xbf)
+				d = d.slice(3);
+
+			// UTF-8 never needs more UTF-16 units than it has bytes; convert in chunks that split on a lead byte
+			auto	dest = converted = (wchar_t*)malloc(d.size() * sizeof(wchar_t));
+			for (auto s = d.begin(); s < d.end();) {
+				auto	e = s + min(d.size() - (s - d.begin()), size_t(1) << 30);
+				while (e < d.end() && (*e & 0xc0) == 0x80)
+					--e;
+				dest += MultiByteToWideChar(CP_UTF8, 0, (const char*)s, int(e - s), dest, int(e - s));
+				s = e;
+			}
+			text = string::view(converted, dest);
+		}
+	}
+	~RegFileText() { free(converted); }
+};
+
+// splits the text into lines without copying anything
+struct RegLines {
+	const wchar_t	*p, *end;
+
+	RegLines(string::view text) : p(text.begin()), end(text.end()) {}
+
+	// one physical line, without the '\n'
+	bool next(string::view &line) {
+		if (p >= end)
+			return false;
+		auto	a = p;
+		while (p < end && *p != '\n')
+			++p;
+		line = string::view(a, p);
+		p	+= p < end;
+		return true;
+	}
+
+	// one trimmed entry; lines continued with a trailing '\' are included as they are, for the data parser to skip
+	bool next_entry(string::view &line) {
+		if (!next(line))
+			return false;
+
+		line	= line.trim();
+		auto	a = line.begin();
+		string::view	line2;
+		while (!line.empty() && line.back() == '\\' && next(line2))
+			line = string::view(a, line2.trim().end());
+		return true;
+	}
+};
+
+// for QUERY /patterns: one literal pattern per line
+int load_patterns(const wchar_t *file, MultiMatch &m, bool fold) {
+	RegFileText		f(file);
+	if (!f)
+		return GetLastError();
+
+	RegLines		lines(f.text);
+	string::view	line;
+	while (lines.next(line)) {
+		line = line.trim();
+		if (!line.empty() && line[0] != ';')
+			m.add(line);
+	}
+	if (!m.compile(fold)) {
+		out << L"Too many distinct characters in patterns: " << file << endl;
+		return ERROR_NOT_ENOUGH_MEMORY;
+	}
+	return 0;
+}
+
+// each key is only read if it has been written since the time it is given
+int Reg::query_modified(const ParsedKey &parsed, const RegKey &root, QueryScratch &scratch) const {
+	// a key that can't be read (deleted since it was opened, say) is left to the caller
+	auto	check = [&](const RegKey &key, string::view keyname, uint64_t since) -> LSTATUS {
+		scratch.walk.pop(0);
+		scratch.walk.push(keyname);
+		auto	info	= key.info();
+		if (info.status)
+			return info.status;
+		auto	time	= (uint64_t(info.last_write.dwHighDateTime) << 32) | info.last_write.dwLowDateTime;
+		if (time <= since) {
+			print_unchanged(scratch, false);
+			return ERROR_SUCCESS;
+		}
+		print_last_write(scratch, time);
+		query(key, scratch, false);
+		return ERROR_SUCCESS;
+	};
+
+	if (ifmodified[0] != '@')
+		return check(root, parsed.get_keyname(), wcstoull(ifmodified, nullptr, 10));
+
+	RegFileText		f(ifmodified + 1);
+	if (!f)
+		return GetLastError();
+
+	RegLines		lines(f.text);
+	string::view	line;
+	while (lines.next(line)) {
+		line = line.trim();
+		if (line.empty() || line[0] == ';')
+			continue;
+
+		uint64_t	since	= 0;
+		auto		p		= line.begin();
+		for (; p < line.end() && *p >= '0' && *p <= '9'; ++p)
+			since = since * 10 + (*p - '0');
+
+		auto		sub		= string::view(p, line.end()).trim();
+		ParsedKey	child	= parsed;
+		if (sub.size())
+			child.subkey = parsed.subkey ? parsed.subkey + L'\\' + sub : string(sub);
+
+		RegKey		key;
+		if (child.open(KEY_READ | get_sam(), key) || check(key, child.get_keyname(), since)) {
+			scratch.walk.pop(0);
+			scratch.walk.push(child.get_keyname());
+			print_unchanged(scratch, true);
+		}
+	}
+	return 0;
+}
+
+// a run of whole sections, parsed independently of the others into entries to be applied in file order
+struct ImportChunk {
+	struct Entry {
+		enum KIND : uint8_t { KEY, DELETE_KEY, SET, REMOVE };
+		KIND			kind;
+		TYPE			type;
+		string::view	name;
+		size_t			offset, size;
+	};
+
+	string::view			text;
+	dynamic_range<Entry>	entries;
+	dynamic_range<byte>		data;
+
+	ImportChunk(string::view text) : text(text) {}
+
+	void add(Entry::KIND kind, string::view name, TYPE type = TYPE::NONE, size_t offset = 0, size_t size = 0) {
+		*entries.alloc(1) = {kind, type, name, offset, size};
+	}
+
+	void parse() {
+		RegLines		lines(text);
+		string::view	line;
+
+		while (lines.next_entry(line)) {
+			if (line.empty() || line[0] == ';')
+				continue;
+
+			if (line[0] == '[') {
+				bool	deleted = line.size() > 1 && line[1] == '-';
+				add(deleted ? Entry::DELETE_KEY : Entry::KEY, string::view(line.begin() + 1 + deleted, line.find(']')));
+
+			} else {
+				auto 	equals	= line.find('=');
+				if (equals < line.end()) {
+					auto	name 	= string::view(line.begin(), equals).trim();
+					auto	value	= string::view(equals + 1, line.end()).trim();
+
+					if (name == L"@"_s)
+						name = string::view(name.begin(), name.begin());	// the default value
+					else if (name.size() >= 2 && name[0] == '"' && name.back() == '"')
+						name = string::view(name.begin() + 1, name.end() - 1);
+
+					if (value == L"-"_s) {
+						add(Entry::REMOVE, name);
+
+					} else {
+						TYPE	type;
+						auto	offset = data.p - data.a;
+						if (parse_reg_data(value, type, data))	//ignore bad data
+							add(Entry::SET, name, type, offset, data.p - data.a - offset);
+					}
+				}
+			}
+		}
+	}
+};
+
+// start of the first section header at or after p, not counting a line continued from the previous one
+const wchar_t *find_section(const wchar_t *start, const wchar_t *p, const wchar_t *end) {
+	while (p < end) {
+		while (p < end && *p++ != '\n')
+			;
+		auto	s = p;
+		while (s < end && (*s == ' ' || *s == '\t'))
+			++s;
+		if (s < end && *s == '[') {
+			auto	prev = p - 1;
+			while (prev > start && is_whitespace(prev[-1]))
+				--prev;
+			if (prev == start || prev[-1] != '\\')
+				return p;
+		}
+	}
+	return end;
+}
+
+struct Importer {
+	RegKey	key;
+	REGSAM	access;
+	bool 	deleted = false;
+	dynamic_range<wchar_t>	name_buffer;
+
+	Importer(REGSAM access) : access(access) {}
+
+	const wchar_t *terminated(string::view v) {
+		auto	p = name_buffer.ensure(v.size() + 1);
+		copyn(p, v.begin(), v.size());
+		p[v.size()] = 0;
+		return p;
+	}
+
+	int apply(const ImportChunk &chunk) {
+		for (auto &i : make_range(chunk.entries.a, chunk.entries.p)) {
+			switch (i.kind) {
+				case ImportChunk::Entry::KEY: {
+					deleted = false;
+					if (auto ret = ParsedKey(i.name).open(access, key))
+						return ret;
+					break;
+				}
+				case ImportChunk::Entry::DELETE_KEY: {
+					ParsedKey	parsed(i.name);
+					deleted = true;
+					if (auto ret = parsed.delete_key(access))
+						return ret;
+					key_cache.forget(parsed.folded());
+					break;
+				}
+
+				case ImportChunk::Entry::REMOVE:
+					if (!deleted)
+						key.remove_value(terminated(i.name));
+					break;
+
+				case ImportChunk::Entry::SET:
+					if (!deleted) {
+						if (auto ret = key.set_value(terminated(i.name), i.type, chunk.data.a + i.offset, i.size))
+							return ret;
+					}
+					break;
+			}
+		}
+		return 0;
+	}
+};
+
+// snapshots recreate their keys (so can restore into an empty tree), then set every value they hold
+int import_snapshot(const Snapshot &s, int i, uint32_t end, HKEY parent, const wchar_t *name, REGSAM sam) {
+	HKEY	h;
+	if (auto ret = RegCreateKeyEx(parent, name, 0, NULL, REG_OPTION_NON_VOLATILE, sam, NULL, &h, NULL))
+		return ret;
+
+	RegKey	key(h);
+	for (uint32_t v = 0, nv = s.num_values(i); v < nv; v++) {
+		if (auto r = s.value(i, v)) {
+			auto	d = s.data(*r);
+			if (auto ret = key.set_value(SnapshotKey(s, i).name(r->name), (TYPE)r->type, (BYTE*)d.begin(), d.size()))
+				return ret;
+		}
+	}
+	for (uint32_t c = 0, nc = s.num_subkeys(i); c < nc; c++) {
+		auto	e	= end;
+		auto	sub	= s.subkey(i, c, e);
+		if (sub >= 0) {
+			if (auto ret = import_snapshot(s, sub, e, h, SnapshotKey(s, sub).name(s.key(sub).name), sam))
+				return ret;
+		}
+	}
+	return 0;
+}
+
+int import_snapshot(range<const byte*> file, REGSAM sam) {
+	Snapshot	snap(file);
+	if (!snap)
+		return ERROR_BAD_FORMAT;
+
+	auto		root = snap.name(snap.key(0).name);
+	ParsedKey	parsed(string::view((const wchar_t*)root.begin(), root.size()));
+	return import_snapshot(snap, 0, snap.header->num_keys, parsed.get_rootkey(), parsed.subkey ? (const wchar_t*)parsed.subkey : L"", sam);
+}
+
+// the entries of a .reg file, in order, to apply(const ImportChunk&); 1 if it doesn't start as one should
+template<typename A> int import_reg_text(string::view text, A &&apply) {
+	RegLines		lines(text);
+	string::view	line;
+	if (!lines.next(line) || line.trim() != L"Windows Registry Editor Version 5.00"_s)
+		return 1;
+
+	text = string::view(lines.p, lines.end);
+
+	// small files are parsed and applied on this thread
+	static const size_t	min_chunk = 256 * 1024, max_chunk = 16 * 1024 * 1024;
+	if (text.size() < min_chunk * 2) {
+		ImportChunk	chunk(text);
+		chunk.parse();
+		return apply(chunk);
+	}
+
+	// otherwise sections are parsed on a pool, a bounded distance ahead of the (serial) apply
+	ThreadPool					pool;
+	OrderedJobs<ImportChunk>	chunks(pool);
+
+	auto	chunk_size	= clamp(text.size() / (pool.num_threads * 8), min_chunk, max_chunk);
+	auto	next		= text.begin();
+	int		ret			= 0;
+
+	while (!ret) {
+		while (next < text.end() && !chunks.full()) {
+			auto	end = find_section(text.begin(), min(next + chunk_size, text.end()), text.end());
+			chunks.submit(new ImportChunk(string::view(next, end)), [](ImportChunk *chunk) { chunk->parse(); });
+			next = end;
+		}
+		auto	chunk = chunks.next();
+		if (!chunk)
+			break;
+		ret = apply(*chunk);
+		delete chunk;
+	}
+	return ret;
+}
+
+int Reg::doIMPORT() {
+	RegFileText	reader(file);
+	if (!reader) {
+		out << L"Failed to open file: " << file << endl;
+		return GetLastError();
+	}
+
+	if (Snapshot::is_snapshot(reader.data()))
+		return import_snapshot(reader.data(), KEY_ALL_ACCESS | get_sam());
+
+	Importer	importer(KEY_ALL_ACCESS | get_sam());
+	return import_reg_text(reader.text, [&importer](const ImportChunk &chunk) { return importer.apply(chunk); });
+}
+
+//-----------------------------------------------------------------------------
+// export
+//-----------------------------------------------------------------------------
+
+// each key's section: its header, then its values
+struct ExportVisitor {
+	BufferWriter	&out;
+	bool			subtree;
+
+	template<typename K> bool enter(TreeWalk &w, const K &key, const typename K::Info &info) {
+		out << L'[' << w.keyname() << L']' << endl;
+		return true;
+	}
+	void value(TreeWalk &w, const ValueView &value) {
+		if (value.name.size())
+			out << L'"' << value.name << L'"';
+		else
+			out << L'@';
+		out << L'=';
+
+		write_reg_data(out, value.data.begin(), value.data.size(), value.type);
+	}
+	template<typename K> bool subkeys(TreeWalk &w, const K &key, const typename K::Info &info) {
+		out << endl;
+		return subtree;
+	}
+	template<typename K> bool subkey(TreeWalk &w, const K &parent, int i, const wchar_t *name)	{ return true; }
+	template<typename K> bool leave(TreeWalk &w, const K *parent, const wchar_t *name)			{ return false; }
+};
+
+// the key's section, and with subtree those of everything below it
+template<typename K> void export_key(BufferWriter &out, const K &key, string::view keyname, bool subtree) {
+	TreeWalk		walk;
+	ExportVisitor	v{out, subtree};
+	walk.push(keyname);
+	walk.walk(key, v);
+}
+
+// a piece of a parallel export: the values of one of the top keys, or a whole subtree below them
+struct ExportSegment {
+	string			name, path;		// path is relative to the exported key
+	bool			subtree;
+	BufferWriter	text{4096};
+	ExportSegment(const string &name, const string &path, bool subtree) : name(name), path(path), subtree(subtree) {}
+};
+
+// lists the segments in the order a serial export would write them
+template<typename K> void plan_export(dynamic_range<ExportSegment*> &segments, const K &root, const string &name, const string &path, int levels) {
+	*segments.alloc(1) = new ExportSegment(name, path, levels == 0);
+	if (levels) {
+		auto	key = open_path(root, path);
+		auto	info = key.info();
+		for (DWORD i = 0; i < info.num_subkeys; i++) {
+			auto sub = key.subkey(i);
+			if (sub.length())
+				plan_export(segments, root, name + L'\\' + sub, path ? path + L'\\' + sub : sub, levels - 1);
+		}
+	}
+}
+
+// what an incremental EXPORT leaves beside its file (as FileName.manifest): a line per key giving its last write time and where its section is
+//	<last_write> <offset> <length> <keyname>
+// all in hex, offsets and lengths in chars from the start of the UTF-16 file
+struct ExportManifest {
+	struct Entry {
+		string::view	name;
+		uint64_t		last_write, offset, length;
+	};
+	static constexpr const wchar_t	*signature = L"REG EXPORT MANIFEST 2";
+
+	RegFileText				text;
+	WinFileMapping			prev;
+	dynamic_range<Entry>	entries;
+
+	static int compare(string::view a, string::view b) {
+		auto	r = wcsncmp(a.begin(), b.begin(), min(a.size(), b.size()));
+		return r ? r : int(a.size() > b.size()) - int(a.size() < b.size());
+	}
+	static uint64_t read_hex(const wchar_t *&p, const wchar_t *e) {
+		uint64_t	v = 0;
+		for (int d; p < e && (d = hexchar(*p)) >= 0; ++p)
+			v = (v << 4) | d;
+		if (p < e && *p == ' ')
+			++p;
+		return v;
+	}
+
+	// anything missing or unreadable leaves no entries, so everything gets exported
+	ExportManifest(const wchar_t *prevfile) : text(string(prevfile) + L".manifest"), prev(prevfile) {
+		auto	d = prev.data();
+		if (!text || !prev || d.size() < 2 || d[0] != 0xff || d[1] != 0xfe)
+			return;
+
+		RegLines		lines(text.text);
+		string::view	line;
+		if (!lines.next(line) || line.trim() != string::view(signature))
+			return;
+
+		while (lines.next(line)) {
+			auto	p = line.begin(), e = line.trim().end();
+			Entry	entry;
+			entry.last_write	= read_hex(p, e);
+			entry.offset		= read_hex(p, e);
+			entry.length		= read_hex(p, e);
+			entry.name			= string::view(p, e);
+			if (entry.offset + entry.length <= d.size() / 2)
+				*entries.alloc(1) = entry;
+		}
+		qsort(entries.begin(), entries.p - entries.begin(), sizeof(Entry), [](const void *a, const void *b) {
+			return compare(((const Entry*)a)->name, ((const Entry*)b)->name);
+		});
+	}
+
+	// the key's section of the previous export, if it was written at last_write
+	string::view find(string::view name, uint64_t last_write) const {
+		const Entry	*a = entries.begin(), *b = entries.p;
+		while (a < b) {
+			auto	m = a + (b - a) / 2;
+			if (compare(m->name, name) < 0)
+				a = m + 1;
+			else
+				b = m;
+		}
+		if (a == entries.p || a->name != name || a->last_write != last_write)
+			return {};
+
+		// only trust a section that starts with its own header
+		auto	section = string::view((const wchar_t*)prev.data().begin() + a->offset, a->length);
+		if (section.size() < name.size() + 2 || section[0] != '[' || string::view(section.begin() + 1, name.size()) != name)
+			return {};
+		return section;
+	}
+};
+
+uint64_t filetime64(const FILETIME &t) {
+	return ((uint64_t)t.dwHighDateTime << 32) | t.dwLowDateTime;
+}
+
+// unchanged keys are copied from the previous export; every key still has its info read, so added and removed subkeys are just part of the walk
+struct IncrementalExportVisitor : ExportVisitor {
+	BufferedFileWriter		&file;
+	BufferWriter			&manifest;
+	const ExportManifest	&prev;
+	uint64_t				last_write, start;
+	bool					copied;
+
+	IncrementalExportVisitor(BufferedFileWriter &file, BufferWriter &manifest, const ExportManifest &prev) : ExportVisitor{file, true}, file(file), manifest(manifest), prev(prev) {}
+
+	template<typename K> bool enter(TreeWalk &w, const K &key, const typename K::Info &info) {
+		last_write	= filetime64(info.last_write);
+		start		= file.position();
+
+		auto	section	= prev.find(w.keyname(), last_write);
+		if ((copied = section.size() != 0)) {
+			file.copy(section.begin(), section.size());
+			return false;
+		}
+		return ExportVisitor::enter(w, key, info);
+	}
+	template<typename K> bool subkeys(TreeWalk &w, const K &key, const typename K::Info &info) {
+		if (!copied)
+			out << endl;
+		manifest << base<16>(last_write) << L' ' << base<16>(start) << L' ' << base<16>(file.position() - start) << L' ' << w.keyname() << endl;
+		return true;
+	}
+};
+
+template<typename K> void export_incremental(BufferedFileWriter &out, BufferWriter &manifest, const ExportManifest &prev, const K &key, string::view keyname) {
+	TreeWalk					walk;
+	IncrementalExportVisitor	v(out, manifest, prev);
+	walk.push(keyname);
+	walk.walk(key, v);
+}
+
+// with prev, a key that has not been written since prev was taken (the same key in it being found as the walk goes) has its values
+// copied from there
+struct SnapshotVisitor {
+	struct Level {
+		uint32_t	i;			// the key in b
+		int			p;			// and in prev
+		uint32_t	hint;		// where to look for its next subkey in prev; subkeys come in the same order every time
+	};
+	SnapshotBuilder			&b;
+	const Snapshot			*prev;
+	int						p;			// in prev, of the key being entered
+	string::view			name;		// of the key being entered
+	dynamic_range<Level>	levels;
+
+	template<typename K> bool enter(TreeWalk &w, const K &key, const typename K::Info &info) {
+		auto	d			= w.depth();
+		auto	last_write	= filetime64(info.last_write);
+		levels.p			= levels.begin() + d;
+		*levels.alloc(1)	= {b.add_key(d ? levels.begin()[d - 1].i : SnapshotBuilder::NONE, to_snapshot(name), last_write), p, 0};
+
+		if (p >= 0 && prev->key(p).last_write == last_write) {
+			for (uint32_t v = 0; auto r = prev->value(p, v); v++)
+				b.add_value(prev->name(r->name), r->type, prev->data(*r));
+			return false;
+		}
+		return true;
+	}
+	void value(TreeWalk &w, const ValueView &value) {
+		b.add_value(to_snapshot(value.name), (uint32_t)value.type, value.data);
+	}
+	template<typename K> bool subkeys(TreeWalk &w, const K &key, const typename K::Info &info) {
+		return true;
+	}
+	template<typename K> bool subkey(TreeWalk &w, const K &parent, int i, const wchar_t *name) {
+		auto	&l	= levels.begin()[w.depth()];
+		this->name	= string::view(name, w.path.p);
+		p			= l.p >= 0 ? find_snapshot_subkey(*prev, l.p, this->name, l.hint) : -1;
+		return true;
+	}
+	template<typename K> bool leave(TreeWalk &w, const K *parent, const wchar_t *name) {
+		return false;
+	}
+};
+
+template<typename K> void snapshot_keys(SnapshotBuilder &b, const K &key, string::view keyname, const Snapshot *prev = nullptr, int p = -1) {
+	TreeWalk		walk;
+	SnapshotVisitor	v{b, prev, p, keyname};
+	walk.push(keyname);
+	walk.walk(key, v);
+}
+
+template<typename K> int export_snapshot(const wchar_t *file, const K &key, const string &keyname) {
+	SnapshotBuilder	b;
+	snapshot_keys(b, key, keyname);
+
+	WinFileWriter	stream(file);
+	if (!stream)
+		return GetLastError();
+
+	b.write([&stream](const void *p, size_t n) {
+		for (auto s = (const byte*)p, e = s + n; s < e; s += 1 << 30)
+			stream.writebuff(s, min(e - s, 1 << 30));
+	});
+	return 0;
+}
+
+// the snapshot is made in memory and indexed from there, so copied keys are indexed just as the ones read are
+template<typename K> int export_index(const wchar_t *file, const K &key, const string &keyname) {
+	SnapshotBuilder	b;
+	{
+		WinFileMapping	mapped(file);
+		Snapshot		prev(mapped.data());
+		snapshot_keys(b, key, keyname, &prev, prev ? find_snapshot_key(prev, keyname) : -1);
+	}
+
+	dynamic_range<byte>	snap;
+	b.write([&snap](const void *p, size_t n) { memcpy(snap.alloc(n), p, n); });
+	Snapshot			s(range<const byte*>(snap.begin(), snap.p));
+
+	SearchIndexBuilder	index;
+	BufferWriter		text(256);
+	for (uint32_t k = 0; k < s.header->num_keys; k++) {
+		SnapshotKey	r(s, k);
+		index.add_text(r.name(s.key(k).name));
+		for (uint32_t v = 0; auto value = s.value(k, v); v++) {
+			auto	data = s.data(*value);
+			text.clear();
+			write_command_data(text, data.begin(), data.size(), (TYPE)value->type, (wchar_t*)L"\\0");
+			index.add_text(r.name(value->name));
+			index.add_text(string::view(text.buffer, text.length()));
+		}
+		index.next_key();
+	}
+
+	WinFileWriter	stream(file);
+	if (!stream)
+		return GetLastError();
+
+	auto	write = [&stream](const void *p, size_t n) {
+		for (auto s = (const byte*)p, e = s + n; s < e; s += 1 << 30)
+			stream.writebuff(s, min(e - s, 1 << 30));
+	};
+	static const byte	zeros[8] = {0};
+	write(snap.begin(), snap.p - snap.begin());
+	write(zeros, SearchIndex::offset(s.header->size) - s.header->size);
+	index.write(write);
+	return 0;
+}
+
+// from the registry or a hive file
+template<typename K> int Reg::export_keys(const K &root, const string &keyname) {
+	if (snapshot || index) {
+		return index
+			? export_index(file, root, keyname)
+			: export_snapshot(file, root, keyname);
+	}
+
+	// the previous export is read in place while this one is written, so it can't be overwritten by it
+	if (incremental) {
+		WinFileReader	prev(incremental), next(file);
+		if (prev && next && prev.same_file(next)) {
+			out << L"/incremental needs the previous export kept under another name than " << file << endl;
+			return ERROR_INVALID_PARAMETER;
+		}
+	}
+
+//	 std::wofstream stream(file, std::ios_base::binary|std::ios_base::out);
+	BufferedFileWriter	stream(file);
+	if (!stream) {
+		auto	err = GetLastError();
+		out << L"Failed to create file: " << file << endl;
+		return err;
+	}
+
+	//stream.imbue(std::locale(std::locale(), new std::codecvt_utf16<wchar_t, 0x10ffff, std::little_endian>));
+
+	stream << L'\xfeff';	//BOM
+	stream << L"Windows Registry Editor Version 5.00" << endl << endl;
+
+	if (incremental) {
+		ExportManifest		prev(incremental);
+		BufferedFileWriter	manifest(string(file) + L".manifest");
+		manifest << L'\xfeff' << ExportManifest::signature << endl;
+		export_incremental(stream, manifest, prev, root, keyname);
+		return 0;
+	}
 
+	int		num		= threads ? wcstol(threads, nullptr, 10) : num_cpus();
+	if (num <= 1) {
+		export_key(stream, root, keyname, true);
+		return 0;
+	}
 
-	types_only = type ? get_type(type) : TYPE::NUM;
+	// the keys in the top levels are split off into segments that are rendered on a pool and written in order
+	static const int	split_levels = 2;
+	dynamic_range<ExportSegment*>	segments;
+	plan_export(segments, root, keyname, string(), split_levels);
 
-	query(RegKey(h), parsed.get_keyname(), false);
+	ThreadPool					pool(num);
+	OrderedJobs<ExportSegment>	pending(pool);
+	auto	render = [&root](ExportSegment *seg) {
+		export_key(seg->text, open_path(root, seg->path), seg->name, seg->subtree);
+	};
 
-	if (data) {
-		out << L"End of search: ";
-		if (keys_only)
-			out << found_keys << L" key(s)";
-		if (values_only)
-			out << onlyif(keys_only, L", ") << found_values << L" item(s)";
-		if (data_only)
-			out << onlyif(keys_only || values_only, L", ") << found_data << L" values(s)";
-		out << L" found.";
+	for (auto next = segments.begin(); ;) {
+		while (next < segments.p && !pending.full())
+			pending.submit(*next++, render);
+		auto	seg = pending.next();
+		if (!seg)
+			break;
+		stream.write(seg->text.buffer, seg->text.length());
+		delete seg;
 	}
 	return 0;
 }
 
-//-----------------------------------------------------------------------------
-// add
-//-----------------------------------------------------------------------------
-
-int Reg::doADD() {
+int Reg::doEXPORT() {
 	ParsedKey	parsed(key);
-	auto 		access = KEY_ALL_ACCESS | get_sam();
-	HKEY		h;
+	if (hive) {
+		WinFileMapping	mapped(hive);
+		if (!mapped)
+			return GetLastError();
+		Hive			h(mapped.data());
+		if (!h) {
+			out << L"Not a hive file: " << hive << endl;
+			return ERROR_BAD_FORMAT;
+		}
+		HiveKey			root(h, find_hive_key(h, parsed));
+		if (!root)
+			return ERROR_FILE_NOT_FOUND;
+		return export_keys(root, parsed.get_keyname());
+	}
 
-	auto ret = parsed.create_key(access, &h);
-	if (ret != ERROR_SUCCESS || (!value && !def_value))
+	RegKey		root;
+	if (auto ret = parsed.open(KEY_READ | get_sam(), root))
 		return ret;
-
-	wchar_t separator = L'\0';
-	if (sep) {
-		if (unescape(sep, sep) != 1)
-			return ERROR_INVALID_FUNCTION;//bad sep
-		separator = sep[0];
-	}{}
-
-	TYPE	itype = get_type(type);
-	if (itype == TYPE::NUM)
-		return 1;
-
-	DWORD	size = parse_command_data(data, itype, separator);
-	RegKey	r(h);
-	return r.set_value(value, itype, (BYTE*)data, size);
+	return export_keys(root, parsed.get_keyname());
 }
 
 //-----------------------------------------------------------------------------
-// delete
+// save
 //-----------------------------------------------------------------------------
 
-int Reg::doDELETE() {
-	ParsedKey	parsed(key);
-	auto 		access = KEY_ALL_ACCESS | get_sam();
-
-	if (!value && !def_value && !all_values)
-		return parsed.delete_key(access);
-
-	HKEY		h;
-	if (auto ret = parsed.open_key(access, &h))
-		return ret;
-
-	RegKey		r(h);
+// each key as it is entered, with its values and security; values are read here rather than by the walk, which passes over any with no
+// data
+struct SaveVisitor {
+	HiveBuilder				&b;
+	string::view			name;		// of the key being entered
+	dynamic_range<uint32_t>	levels;
+	dynamic_range<wchar_t>	value_name;
+	dynamic_range<byte>		data, sd;
+
+	range<const byte*> security(const RegKey &key) {
+		DWORD	size = 0;
+		if (RegGetKeySecurity(key, OWNER_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION | DACL_SECURITY_INFORMATION, nullptr, &size) != ERROR_INSUFFICIENT_BUFFER
+			|| RegGetKeySecurity(key, OWNER_SECURITY_INFORMATION | GROUP_SECURITY_INFORMATION | DACL_SECURITY_INFORMATION, sd.ensure(size), &size) != ERROR_SUCCESS
+		)
+			return {};
+		return {sd.begin(), size};
+	}
+	range<const byte*> security(const HiveKey &key) {
+		return key.h.security(*key.k);
+	}
+	template<typename K> range<const byte*> security(const K &key) {
+		return {};
+	}
+	static uint16_t	flags(const HiveKey &key)				{ return key.k->flags; }
+	template<typename K> static uint16_t flags(const K &key)	{ return 0; }
+
+	template<typename K> bool enter(TreeWalk &w, const K &key, const typename K::Info &info) {
+		auto	d	= w.depth();
+		auto	sd	= security(key);
+		levels.p	= levels.begin() + d;
+		*levels.alloc(1) = b.add_key(d ? levels.begin()[d - 1] : HiveBuilder::NONE, name, filetime64(info.last_write),
+			b.add_security(sd.empty() ? default_hive_security() : sd), flags(key)
+		);
 
-	if (all_values) {
-		auto 	info	= r.info();
-		for (int i = 0; i < info.num_values; i++) {
-			if (auto value = r.value(i, nullptr, 0)) {
-				if (auto ret = r.remove_value(value.name))
-					return ret;
-			}
+		for (auto value : key.values(info.num_values, value_name.ensure(MAX_VALUE_NAME), data.ensure(info.max_data + 1), info.max_data)) {
+			if (value.data.begin())
+				b.add_value(value.name, (uint32_t)value.type, value.data);
 		}
-		return 0;
+		return false;
+	}
+	void value(TreeWalk &w, const ValueView &value) {}
+	template<typename K> bool subkeys(TreeWalk &w, const K &key, const typename K::Info &info) {
+		return true;
 	}
+	template<typename K> bool subkey(TreeWalk &w, const K &parent, int i, const wchar_t *name) {
+		this->name = string::view(name, w.path.p);
+		return true;
+	}
+	template<typename K> bool leave(TreeWalk &w, const K *parent, const wchar_t *name) {
+		return false;
+	}
+};
 
-	return r.remove_value(value);
+// the last part of a full key name, which the key is called in a hive of its own
+string::view leaf_name(string::view keyname) {
+	auto	p = keyname.end();
+	while (p > keyname.begin() && p[-1] != '\\')
+		--p;
+	return string::view(p, keyname.end());
 }
 
-//-----------------------------------------------------------------------------
-// import
-//-----------------------------------------------------------------------------
-
-auto win_getline(FileReader &reader) {
-	auto line = string::read_to(reader, '\n');
-	if (line.back() == '\r')
-		line.pop_back();
-	return line;
+template<typename K> void save_keys(HiveBuilder &b, const K &key, string::view keyname) {
+	TreeWalk	walk;
+	SaveVisitor	v{b, leaf_name(keyname)};
+	walk.push(keyname);
+	walk.walk(key, v);
 }
 
-int Reg::doIMPORT() {
-	FileReader	reader(file);
-	if (!reader) {
-		out << L"Failed to open file: " << file << endl;
-		return errno;
+// a .reg file's entries for keys at or below root, applied to b as IMPORT would apply them to the registry
+struct HiveImporter {
+	HiveBuilder		&b;
+	ParsedKey		root;
+	uint64_t		now;
+	uint32_t		security;
+	uint32_t		key		= HiveBuilder::NONE;	// where values go, or none
+	bool			found	= false;				// any of root at all
+
+	HiveImporter(HiveBuilder &b, const ParsedKey &root, uint64_t now) : b(b), root(root), now(now), security(b.add_security(default_hive_security())) {
+		b.add_key(HiveBuilder::NONE, leaf_name(root.get_keyname()), now, security);
 	}
 
-//	stream.imbue(std::locale(std::locale(), new std::codecvt_utf16<wchar_t, 0x10FFFF, std::consume_header>));
-
-	string line, line2;
-	line = win_getline(reader);
-	if (line != L"Windows Registry Editor Version 5.00")
-		return 1;
+	// the key in b for a full key name, if it is root or below it; with create, any not there yet on the way are added
+	uint32_t find(string::view keyname, bool create) {
+		ParsedKey		parsed(keyname);
+		string::view	path	= parsed.subkey, base = root.subkey;
+		if (parsed.hive != root.hive || parsed.host != root.host || path.size() < base.size()
+			|| compare_folded(string::view(path.begin(), base.size()), base) != 0
+			|| (path.size() > base.size() && base.size() && path.begin()[base.size()] != '\\')
+		)
+			return HiveBuilder::NONE;
+
+		found = true;
+		uint32_t	k = 0;
+		for (auto p = path.begin() + base.size(); k != HiveBuilder::NONE && p < path.end();) {
+			auto	a		= p;
+			p				= string::view(a, path.end()).find('\\');
+			auto	name	= string::view(a, p);
+			p				+= p < path.end();
+			if (!name.empty())
+				k = create ? b.create_subkey(k, name, now, security) : b.find_subkey(k, name);
+		}
+		return k;
+	}
 
-	RegKey	key;
-	auto 	access = KEY_ALL_ACCESS | get_sam();
-	bool 	deleted = false;
-	HKEY	h;
+	int apply(const ImportChunk &chunk) {
+		for (auto &i : make_range(chunk.entries.a, chunk.entries.p)) {
+			switch (i.kind) {
+				case ImportChunk::Entry::KEY:
+					key = find(i.name, true);
+					break;
 
-	// Parse key values and subkeys
-	while ((line = win_getline(reader))) {
-		line = line.trim();
-		if (!line.empty() && line[0] != ';') {
-			bool	more = line.back() == '\\';
-			if (more) {
-				line.pop_back();
-				for (StringBuilder	b(line); more;) {
-					auto line2 = win_getline(reader);
-					more = line2.back() == '\\';
-					if (more)
-						line2.pop_back();
-					b << line2;
+				case ImportChunk::Entry::DELETE_KEY: {
+					auto	k = find(i.name, false);
+					if (k != HiveBuilder::NONE)
+						b.delete_key(k);
+					key = HiveBuilder::NONE;
+					break;
 				}
-			}
-
-			if (line[0] == '[') {
-				deleted = line[1] == '-';
-				auto	open	= 1 + deleted;
-				auto	close	= line.find_first(']');
-				ParsedKey	parsed(string::view(line.begin() + open, close));
 
-				if (deleted) {
-					if (auto ret = parsed.delete_key(access))
-						return ret;
-
-				} else {
-					if (auto ret = parsed.open_key(access, &h))
-						return ret;
-					key = RegKey(h);
-				}
+				case ImportChunk::Entry::REMOVE:
+					if (key != HiveBuilder::NONE)
+						b.remove_value(key, i.name);
+					break;
 
-			} else if (!deleted) {
-				auto 	equals	= line.find_first('=');
-				if (equals) {
-					auto	name 	= string::view(line.begin(), equals).trim();
-					auto	value	= string::view(equals + 1).trim();
+				case ImportChunk::Entry::SET:
+					if (key != HiveBuilder::NONE)
+						b.set_value(key, i.name, (uint32_t)i.type, {chunk.data.a + i.offset, i.size});
+					break;
+			}
+		}
+		return 0;
+	}
+};
 
-					if (name[0] == '"' && name.back() == '"')
-						name = string::view(name.begin() + 1, name.end() - 1);
+int Reg::doSAVE() {
+	ParsedKey	parsed(key);
+	auto		keyname	= parsed.get_keyname();
+	auto		start	= GetTickCount64();
+	uint64_t	input	= 0;
+	HiveBuilder	b;
+
+	if (hive && import_file) {
+		out << L"/hive and /import can't be used together" << endl;
+		return ERROR_INVALID_PARAMETER;
+	}
 
-					if (value == L"-") {
-						key.remove_value(string(name));
+	if (hive) {
+		WinFileMapping	mapped(hive);
+		if (!mapped)
+			return GetLastError();
+		Hive			h(mapped.data());
+		if (!h) {
+			out << L"Not a hive file: " << hive << endl;
+			return ERROR_BAD_FORMAT;
+		}
+		HiveKey			root(h, find_hive_key(h, parsed));
+		if (!root)
+			return ERROR_FILE_NOT_FOUND;
+		save_keys(b, root, keyname);
+		input = mapped.size;
+
+	} else if (import_file) {
+		RegFileText	reader(import_file);
+		if (!reader) {
+			out << L"Failed to open file: " << import_file << endl;
+			return GetLastError();
+		}
+		if (Snapshot::is_snapshot(reader.data())) {
+			Snapshot	snap(reader.data());
+			auto		i = snap ? find_snapshot_key(snap, keyname) : -1;
+			if (i < 0)
+				return snap ? ERROR_FILE_NOT_FOUND : ERROR_BAD_FORMAT;
+			save_keys(b, SnapshotKey(snap, i), keyname);
 
-					} else {
-						TYPE	type;
-						auto	data	= parse_reg_data(string(value), type);
-						if (data.size() > 0) {	//ignore bad data
-							if (auto ret = key.set_value(string(name), type, data.a, data.p - data.a))
-								return ret;
-						}
-					}
-				}
-			}
+		} else {
+			FILETIME	now;
+			GetSystemTimeAsFileTime(&now);
+			HiveImporter	importer(b, parsed, filetime64(now));
+			if (auto ret = import_reg_text(reader.text, [&importer](const ImportChunk &chunk) { return importer.apply(chunk); }))
+				return ret;
+			if (!importer.found)
+				return ERROR_FILE_NOT_FOUND;
 		}
+		input = reader.data().size();
+
+	} else {
+		RegKey	root;
+		if (auto ret = parsed.open(KEY_READ | get_sam(), root))
+			return ret;
+		save_keys(b, root, keyname);
 	}
 
+	WinFileWriter	stream(file);
+	if (!stream) {
+		auto	err = GetLastError();
+		out << L"Failed to create file: " << file << endl;
+		return err;
+	}
+	uint64_t	size = 0;
+	b.write([&stream, &size](const void *p, size_t n) {
+		for (auto s = (const byte*)p, e = s + n; s < e; s += 1 << 30)
+			stream.writebuff(s, min(e - s, 1 << 30));
+		size += n;
+	}, file);
+
+	out << L"Saved " << b.num_written_keys << L" keys and " << b.num_written_values << L" values in " << GetTickCount64() - start << L"ms: " << size << L" bytes";
+	if (input)
+		out << L", " << size * 100 / input << L"% of the " << input << L" read";
+	out << endl;
 	return 0;
 }
 
 //-----------------------------------------------------------------------------
-// export
+// watch
 //-----------------------------------------------------------------------------
 
-void export_recurse(FileWriter &out, const RegKey &key, string keyname) {
-	out << L'[' << keyname << L']' << endl;
+// a value as WATCH last saw it; its name and then its data follow it in the same block
+struct WatchedValue {
+	TYPE		type;
+	uint32_t	name_len;
+	DWORD		size;
+
+	static WatchedValue *make(const ValueView &value) {
+		auto	v	= (WatchedValue*)malloc(sizeof(WatchedValue) + value.name.size() * sizeof(wchar_t) + value.data.size());
+		v->type		= value.type;
+		v->name_len	= uint32_t(value.name.size());
+		v->size		= DWORD(value.data.size());
+		memcpy(v + 1, value.name.begin(), value.name.size() * sizeof(wchar_t));
+		memcpy((wchar_t*)(v + 1) + v->name_len, value.data.begin(), v->size);
+		return v;
+	}
+	string::view		name()	const	{ return {(const wchar_t*)(this + 1), name_len}; }
+	range<const BYTE*>	data()	const	{ return {(const BYTE*)name().end(), size}; }
+	ValueView			view()	const	{ return {name(), type, data()}; }
+	bool same(const WatchedValue &b) const {
+		return type == b.type && size == b.size && memcmp(data().begin(), b.data().begin(), size) == 0;
+	}
+};
 
-	auto info 	= key.info();
-	auto data	= (BYTE*)malloc(info.max_data + 1);
+// a key as WATCH last saw it, its values and subkeys sorted by name (ignoring case); without /s, the subkeys have neither
+struct WatchedKey {
+	string							name;
+	uint64_t						last_write	= 0;
+	dynamic_range<WatchedValue*>	values;
+	dynamic_range<WatchedKey*>		subkeys;
+
+	~WatchedKey() {
+		for (auto v : make_range(values.begin(), values.p))
+			free(v);
+		for (auto k : make_range(subkeys.begin(), subkeys.p))
+			delete k;
+	}
+};
 
-	// Enumerate the values
-	for (int i = 0; i < info.num_values; i++) {
-		if (auto value = key.value(i, data, info.max_data)) {
-			if (value.name.length())
-				out << L'"' << value.name << L'"';
-			else
-				out << L'@';
-			out << L'=';
+// a key's subkeys as they are now, sorted like WatchedKey's
+struct WatchSubkeys {
+	struct Entry {
+		string::view	name;		// 0-terminated
+		uint64_t		last_write;
+	};
+	dynamic_range<wchar_t>	names;
+	dynamic_range<Entry>	entries;
+
+	WatchSubkeys(const RegKey &key) {
+		wchar_t		name[MAX_KEY_LENGTH + 1];
+		uint64_t	time;
+		for (int i = 0; ; i++) {
+			auto	n = key.subkey(i, name, time);
+			if (n.empty())
+				break;
+			memcpy(names.alloc(n.size() + 1), name, (n.size() + 1) * sizeof(wchar_t));
+			*entries.alloc(1) = {string::view(nullptr, n.size()), time};
+		}
+		// names has stopped moving
+		auto	p = names.begin();
+		for (auto &e : make_range(entries.begin(), entries.p)) {
+			e.name	= {p, e.name.size()};
+			p		+= e.name.size() + 1;
+		}
+		qsort(entries.begin(), entries.p - entries.begin(), sizeof(Entry), [](const void *a, const void *b) {
+			return compare_folded(((const Entry*)a)->name, ((const Entry*)b)->name);
+		});
+		// a key renamed while being enumerated can be seen twice
+		auto	out = entries.begin();
+		for (auto &e : make_range(entries.begin(), entries.p)) {
+			if (out == entries.begin() || compare_folded(out[-1].name, e.name))
+				*out++ = e;
+		}
+		entries.p = out;
+	}
+};
 
-			write_reg_data(out, data, value.size, value.type);
+// brings a model of a key (with /s, of everything below it) up to date, printing what changed
+// a key's enumeration gives its subkeys' last write times, so only the keys written since the last sweep have their values read,
+// and only those and the ones with subkeys of their own are opened
+struct Watcher {
+	const Reg			&reg;
+	QueryScratch		&scratch;
+	REGSAM				sam;
+	int					changes	= 0;	// printed by the current sweep
+	wchar_t				name[MAX_VALUE_NAME];
+	dynamic_range<BYTE>	data;
+
+	Watcher(const Reg &reg, QueryScratch &scratch) : reg(reg), scratch(scratch), sam(KEY_READ | reg.get_sam()) {}
+
+	static uint64_t time(const RegKey::Info &info) {
+		return (uint64_t(info.last_write.dwHighDateTime) << 32) | info.last_write.dwLowDateTime;
+	}
+
+	void print(wchar_t mark, const ValueView &value) {
+		scratch.text.clear();
+		if (reg.text_output() && mark != '-')
+			write_command_data(scratch.text, value.data.begin(), value.data.size(), value.type, reg.sep);
+		reg.print_value(scratch, value, string::view(scratch.text.buffer, scratch.text.length()), mark);
+		++changes;
+	}
+	void print(wchar_t mark) {
+		reg.print_change(scratch, mark);
+		++changes;
+	}
+
+	void read_values(const RegKey &key, const RegKey::Info &info, dynamic_range<WatchedValue*> &values) {
+		data.p = data.begin();
+		data.ensure(info.max_data + 1);
+		for (DWORD i = 0; i < info.num_values; i++) {
+			auto	value = key.value(i, name, data.begin(), info.max_data);
+			// a value changed under the enumeration is picked up by the next sweep, the key's time having moved again
+			if (value.name.begin())
+				*values.alloc(1) = WatchedValue::make(value);
 		}
+		qsort(values.begin(), values.p - values.begin(), sizeof(WatchedValue*), [](const void *a, const void *b) {
+			return compare_folded((*(WatchedValue* const*)a)->name(), (*(WatchedValue* const*)b)->name());
+		});
 	}
-	free(data);
 
-	out << endl;
+	// a key that wasn't in the model, with scratch.walk at it; full reads its values and subkeys (and theirs, with /s)
+	WatchedKey *add(const RegKey &key, string::view name, uint64_t last_write, bool full, bool printing) {
+		auto	w		= new WatchedKey;
+		w->name			= string(name);
+		w->last_write	= last_write;
+		if (printing)
+			print('+');
+		if (!full)
+			return w;
+
+		auto	info	= key.info();
+		w->last_write	= time(info);
+		read_values(key, info, w->values);
+		if (printing) {
+			for (auto v : make_range(w->values.begin(), w->values.p))
+				print('+', v->view());
+		}
 
-	// Enumerate the subkeys
-	for (int i = 0; i < info.num_subkeys; i++) {
-		auto name = key.subkey(i);
-		if (name.length())
-			export_recurse(out, RegKey(key.h, name), keyname + L'\\' + name);
+		WatchSubkeys	now(key);
+		for (auto &e : make_range(now.entries.begin(), now.entries.p)) {
+			auto	len = scratch.walk.push(e.name);
+			RegKey	child;
+			if (reg.all_subkeys)
+				child = RegKey(key, e.name.begin(), sam);
+			*w->subkeys.alloc(1) = add(child, e.name, e.last_write, !!child, printing);
+			scratch.walk.pop(len);
+		}
+		return w;
 	}
-}
 
-int Reg::doEXPORT() {
-//	 std::wofstream stream(file, std::ios_base::binary|std::ios_base::out);
-	FileWriter	stream(file);
-	if (!stream) {
-		out << L"Failed to create file: " << file << endl;
-		return errno;
+	// merges values just read into w's, printing the differences after the key
+	void update_values(WatchedKey *w, dynamic_range<WatchedValue*> &now) {
+		bool	printed_key	= false;
+		auto	change		= [&](wchar_t mark, const WatchedValue *v) {
+			if (!printed_key) {
+				print('*');
+				printed_key = true;
+			}
+			print(mark, v->view());
+		};
+
+		auto	a = w->values.begin(), b = now.begin();
+		while (a < w->values.p || b < now.p) {
+			int	c = a == w->values.p ? 1 : b == now.p ? -1 : compare_folded((*a)->name(), (*b)->name());
+			if (c < 0)
+				change('-', *a);
+			else if (c > 0)
+				change('+', *b);
+			else if (!(*a)->same(**b))
+				change('*', *b);
+			if (c <= 0)
+				free(*a++);
+			if (c >= 0)
+				++b;
+		}
+		auto	n = now.p - now.begin();
+		w->values.p = w->values.begin();
+		memcpy(w->values.alloc(n), now.begin(), n * sizeof(WatchedValue*));
 	}
 
-	//stream.imbue(std::locale(std::locale(), new std::codecvt_utf16<wchar_t, 0x10ffff, std::little_endian>));
+	// brings w up to date with key, whose last write time is now last_write, with scratch.walk at it
+	// a key's time moves when its values change or it gains or loses a subkey, but not for anything further down
+	void update(WatchedKey *w, const RegKey &key, uint64_t last_write) {
+		bool	written = last_write != w->last_write;
+		if (written) {
+			auto	info	= key.info();
+			w->last_write	= time(info);
+			dynamic_range<WatchedValue*>	now;
+			read_values(key, info, now);
+			update_values(w, now);
+		}
+		if (!written && !reg.all_subkeys)
+			return;
+
+		WatchSubkeys				now(key);
+		dynamic_range<WatchedKey*>	merged;
+		auto	a = w->subkeys.begin();
+		auto	b = now.entries.begin();
+		while (a < w->subkeys.p || b < now.entries.p) {
+			int		c	= a == w->subkeys.p ? 1 : b == now.entries.p ? -1 : compare_folded((*a)->name, b->name);
+			auto	len	= scratch.walk.push(c < 0 ? string::view((*a)->name) : b->name);
+			if (c < 0) {
+				print('-');
+				delete *a++;
+			} else {
+				// a subkey that can't be opened (it may have just gone) is left as it was for the next sweep
+				RegKey	child;
+				if (reg.all_subkeys && (c > 0 || b->last_write != (*a)->last_write || (*a)->subkeys.p != (*a)->subkeys.begin()))
+					child = RegKey(key, b->name.begin(), sam);
+				if (c > 0) {
+					*merged.alloc(1) = add(child, b->name, b->last_write, !!child, true);
+				} else {
+					if (child)
+						update(*a, child, b->last_write);
+					*merged.alloc(1) = *a++;
+				}
+				++b;
+			}
+			scratch.walk.pop(len);
+		}
+		auto	n = merged.p - merged.begin();
+		w->subkeys.p = w->subkeys.begin();
+		memcpy(w->subkeys.alloc(n), merged.begin(), n * sizeof(WatchedKey*));
+	}
+};
 
-	stream << L'\xfeff';	//BOM
-	stream << L"Windows Registry Editor Version 5.00" << endl << endl;
+// reads the key, then prints what changes in it until it is deleted (or the process is stopped):
+//	+KeyName		for a key added, followed (as QUERY prints them) by its values, each marked +
+//	-KeyName		for a key removed
+//	*KeyName		for a key whose values changed, followed by each one added (+), changed (*) or removed (-, with only its name)
+// it sleeps on a change notification where the key allows one, and otherwise polls, less often while nothing is changing
+int Reg::doWATCH() {
+	if (StdoutWriter::redirect) {
+		out << L"WATCH can't be run from SERVE" << endl;
+		return ERROR_INVALID_FUNCTION;
+	}
 
 	ParsedKey	parsed(key);
-	HKEY h;
-	if (auto ret = parsed.open_key(KEY_READ | get_sam(), &h))
+	HKEY		h;
+	if (auto ret = parsed.open_key(KEY_READ | KEY_NOTIFY | get_sam(), &h))
 		return ret;
+	RegKey		root(h);
+
+	// armed before each sweep, so a change made during one wakes the next
+	HANDLE	event	= CreateEvent(NULL, FALSE, FALSE, NULL);
+	auto	arm		= [&] {
+		return event && RegNotifyChangeKeyValue(root, all_subkeys, REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET, event, TRUE) == ERROR_SUCCESS;
+	};
+	bool	notified = arm();
+
+	QueryScratch	scratch;
+	Watcher			watcher(*this, scratch);
+	scratch.walk.push(parsed.get_keyname());
+	auto	model	= watcher.add(root, parsed.get_keyname(), 0, true, false);
+	print_change(scratch, ' ');
+	out.drain();
+
+	DWORD		min_wait	= interval ? wcstoul(interval, nullptr, 10) : 100;
+	DWORD		wait		= min_wait;
+	ULONGLONG	last		= GetTickCount64();
+	for (;;) {
+		if (notified) {
+			WaitForSingleObject(event, INFINITE);
+			auto	since = GetTickCount64() - last;
+			if (since < min_wait)
+				Sleep(DWORD(min_wait - since));
+		} else {
+			Sleep(wait);
+		}
+		notified	= arm();
+		last		= GetTickCount64();
+
+		FILETIME	time;
+		if (::RegQueryInfoKey(root, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &time) != ERROR_SUCCESS) {
+			watcher.print('-');
+			break;
+		}
+		watcher.changes = 0;
+		watcher.update(model, root, (uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime);
+		if (watcher.changes)
+			out.drain();
+		wait = watcher.changes ? min_wait : min(wait * 2, min_wait * 32);
+	}
 
-	export_recurse(stream, h, parsed.get_keyname());
+	out.drain();
+	delete model;
+	if (event)
+		CloseHandle(event);
 	return 0;
 }
 
@@ -1191,6 +3929,7 @@ int Reg::doLOAD()	{
 
 int Reg::doUNLOAD()	{
 	ParsedKey	parsed(key);
+	key_cache.forget(parsed.folded());
 	return RegUnLoadKey(parsed.get_rootkey(), parsed.subkey);
 }
 
@@ -1215,7 +3954,7 @@ void print_options(OP op) {
 
 		if (opt->sw) {
 			out << L'/' << opt->sw;
-			if (opt->arg)
+			if (opt->arg && opt->sw[wcslen(opt->sw) - 1] != ':')
 				out << L' ';
 		}
 		if (opt->arg)
@@ -1241,40 +3980,21 @@ void print_options(OP op) {
 	}
 }
 
-int wmain(int argc, wchar_t* argv[]) {
-	_setmode(_fileno(stdout), _O_U8TEXT);
-
-#if 0
-	bool forever = true;
-	while (forever) {
-		out << L"waiting for attach..." << endl;
-		Sleep(1000);
-	}
-#endif
-
-	if (argc < 2) {
-		out << L"** NOTE: this is an unofficial replacement for REG **" << endl << endl
-			<< L"REG Operation [Parameter List]" << endl << endl
-			<< L"Operation  [ QUERY | ADD | DELETE | EXPORT | IMPORT]" << endl << endl
-			<< L"Returns WINERROR code (e.g ERROR_SUCCESS = 0 on sucess)" << endl << endl
-			<< L"For help on a specific operation type:" << endl << endl
-			<< L"REG Operation /?" << endl << endl;
-		return 0;
-	}
-
-	OP op = get_op(argv[1]);
+// runs one operation; args starts with its name
+int run(int argc, wchar_t* argv[]) {
+	OP op = get_op(argv[0]);
 	if (op == OP::NUM) {
-		out << L"Unknown operation: " << argv[1] << endl;
+		out << L"Unknown operation: " << argv[0] << endl;
 		return ERROR_INVALID_FUNCTION;
 	}
 
-	if (argv[2] == L"/?"_s) {
+	if (argc > 1 && argv[1] == L"/?"_s) {
 		print_options(op);
 		return 0;
 	}
 
 	Reg reg;
-	auto err = get_options(op_options[(uint8_t)op].opts, argc - 2, argv + 2, reg.string_args, reg.bool_args);
+	auto err = get_options(op_options[(uint8_t)op].opts, argc - 1, argv + 1, reg.string_args, reg.bool_args);
 	if (err) {
 		out << L"Unknown option: " << err << endl;
 		return ERROR_INVALID_FUNCTION;
@@ -1288,10 +4008,12 @@ int wmain(int argc, wchar_t* argv[]) {
 		case OP::EXPORT: 	r = reg.doEXPORT(); break;
 		case OP::IMPORT: 	r = reg.doIMPORT(); break;
 	//	case OP::COPY: 		r = reg.doCOPY();	break;
-	//	case OP::SAVE: 		r = reg.doSAVE();	break;
+		case OP::SAVE: 		r = reg.doSAVE();	break;
 	//	case OP::RESTORE: 	r = reg.doRESTORE();break;
 		case OP::LOAD: 		r = reg.doLOAD();	break;
 		case OP::UNLOAD: 	r = reg.doUNLOAD(); break;
+		case OP::SERVE: 	r = reg.doSERVE();	break;
+		case OP::WATCH: 	r = reg.doWATCH();	break;
 	//	case OP::COMPARE: 	r = reg.doCOMPARE();break;
 	//	case OP::FLAGS: 	r = reg.doFLAGS();	break;
 		default: break;
@@ -1315,3 +4037,235 @@ int wmain(int argc, wchar_t* argv[]) {
 	}
 	return r;
 }
+
+//-----------------------------------------------------------------------------
+// serve
+//-----------------------------------------------------------------------------
+
+// stdin as UTF-16, decoded from UTF-8 as it arrives
+struct StdinReader {
+	HANDLE					h			= GetStdHandle(STD_INPUT_HANDLE);
+	char					partial[4];				// the start of a sequence the last read split
+	DWORD					num_partial	= 0;
+	dynamic_range<wchar_t>	text;					// decoded, from pos on not yet taken
+	size_t					pos			= 0;
+
+	string::view	available() const { return {text.begin() + pos, text.p}; }
+
+	// false at the end of the input
+	bool fill() {
+		char	buffer[65536];
+		DWORD	n;
+		memcpy(buffer, partial, num_partial);
+		if (!ReadFile(h, buffer + num_partial, sizeof(buffer) - num_partial, &n, NULL) || !n)
+			return false;
+		n += num_partial;
+
+		// a sequence that isn't all there yet waits for the next read
+		DWORD	e = n, lead = n;
+		while (lead && n - lead < 4 && (buffer[lead - 1] & 0xc0) == 0x80)
+			--lead;
+		if (lead && (buffer[lead - 1] & 0xc0) == 0xc0) {
+			auto	c = byte(buffer[lead - 1]);
+			if (n - lead + 1 < (c >= 0xf0 ? 4u : c >= 0xe0 ? 3u : 2u))
+				e = lead - 1;
+		}
+		num_partial = n - e;
+		memcpy(partial, buffer + e, num_partial);
+
+		// only what is still waiting is kept
+		if (pos) {
+			auto	rest = available().size();
+			memmove(text.begin(), text.begin() + pos, rest * sizeof(wchar_t));
+			text.p	= text.begin() + rest;
+			pos		= 0;
+		}
+		text.p += MultiByteToWideChar(CP_UTF8, 0, buffer, e, text.ensure(e), e);
+		return true;
+	}
+
+	// the next line, without its '\n'
+	bool line(string::view &line) {
+		for (size_t scanned = 0;;) {
+			auto	a	= available();
+			auto	nl	= string::view(a.begin() + scanned, a.end()).find('\n');
+			if (nl < a.end()) {
+				line	= string::view(a.begin(), nl);
+				pos		= nl + 1 - text.begin();
+				return true;
+			}
+			scanned = a.size();
+			if (!fill())
+				return false;
+		}
+	}
+
+	// the next n chars
+	bool read(size_t n, string::view &s) {
+		while (available().size() < n) {
+			if (!fill())
+				return false;
+		}
+		s	= string::view(text.begin() + pos, n);
+		pos	+= n;
+		return true;
+	}
+};
+
+struct ServeRequest {
+	dynamic_range<wchar_t>	args;		// each ended by a 0
+	dynamic_range<wchar_t*>	argv;
+	int						argc;
+	string					key;		// what it is ordered by
+	bool					writes;
+	FrameWriter				output;
+	ServeRequest			*next		= nullptr;	// waiting behind it
+
+	ServeRequest(string::view id, string::view payload) : output(id) {
+		auto	n = payload.size();
+		memcpy(args.alloc(n + 1), payload.begin(), n * sizeof(wchar_t));
+		args.begin()[n] = 0;
+		for (auto p = args.begin(), e = args.begin() + n; p < e; p += wcslen(p) + 1)
+			*argv.alloc(1) = p;
+		argc = int(argv.p - argv.begin());
+		*argv.alloc(1) = nullptr;
+
+		// requests that name no key, or could touch any, share the "" key
+		auto	op	= argc ? get_op(argv.begin()[0]) : OP::NUM;
+		writes		= op == OP::ADD || op == OP::DEL || op == OP::IMPORT || op == OP::LOAD || op == OP::UNLOAD;
+		if (op != OP::IMPORT && op != OP::LOAD && op != OP::UNLOAD && argc > 1 && argv.begin()[1][0] != '/') {
+			key = ParsedKey(argv.begin()[1]).folded();
+			// each view is a different key
+			for (auto a : make_range(argv.begin() + 2, argv.p - 1)) {
+				if (a == L"/reg:32"_s || a == L"/reg:64"_s)
+					key = key + L'|' + string::view(a + 5);
+			}
+		}
+	}
+};
+
+// runs requests on a pool, keeping each key's in order: reads of it run together, but a write waits for everything before it and holds up everything after
+struct Server {
+	struct Strand {
+		string			key;
+		int				reads	= 0;	// running
+		bool			write	= false;
+		ServeRequest	*head	= nullptr, *tail = nullptr;		// waiting
+	};
+	ThreadPool				pool;
+	Mutex					m;
+	dynamic_range<Strand*>	strands;	// any key with requests running or waiting; few enough to search
+
+	Server(int threads) : pool(threads) {}
+
+	// with m held
+	Strand *strand(string::view key) {
+		for (auto s : make_range(strands.begin(), strands.p)) {
+			if (string::view(s->key) == key)
+				return s;
+		}
+		auto	s	= new Strand;
+		s->key		= key;
+		*strands.alloc(1) = s;
+		return s;
+	}
+	static bool can_start(const Strand *s, const ServeRequest *r) {
+		return !s->write && !(r->writes && s->reads);
+	}
+	void start(Strand *s, ServeRequest *r) {
+		if (r->writes)
+			s->write = true;
+		else
+			++s->reads;
+		pool.submit([this, s, r]() { run(s, r); });
+	}
+
+	void submit(ServeRequest *r) {
+		Lock	lock(m);
+		auto	s = strand(r->key);
+		if (!s->head && can_start(s, r)) {
+			start(s, r);
+		} else {
+			(s->head ? s->tail->next : s->head) = r;
+			s->tail = r;
+		}
+	}
+
+	void run(Strand *s, ServeRequest *r) {
+		StdoutWriter::redirect = &r->output;
+		int	code = r->argc ? ::run(r->argc, r->argv.begin()) : ERROR_INVALID_FUNCTION;
+		StdoutWriter::redirect = nullptr;
+		r->output.finish(code);
+		delete r;
+
+		Lock	lock(m);
+		if (s->write)
+			s->write = false;
+		else
+			--s->reads;
+		while (s->head && can_start(s, s->head)) {
+			auto	next	= s->head;
+			s->head			= next->next;
+			start(s, next);
+		}
+		if (!s->reads && !s->write && !s->head) {
+			auto	i = strands.begin();
+			while (*i != s)
+				++i;
+			*i = *--strands.p;
+			delete s;
+		}
+	}
+};
+
+// runs operations in this process until stdin ends; each request is
+//	<id> <n>\n		followed by n UTF-16 units (as UTF-8): the operation and its arguments, each ended by a 0
+// and is answered in frames with the same id (see StdoutWriter::send_frame), as soon as it has anything to say, so answers to
+// requests run at the same time are interleaved
+int Reg::doSERVE() {
+	if (StdoutWriter::redirect) {
+		out << L"SERVE can't be run from SERVE" << endl;
+		return ERROR_INVALID_FUNCTION;
+	}
+
+	Server			server(threads ? wcstol(threads, nullptr, 10) : num_cpus());
+	StdinReader		in;
+	string::view	line;
+
+	while (in.line(line)) {
+		auto	sp	= line.find(' ');
+		size_t	n	= 0;
+		for (auto p = sp + (sp < line.end()); p < line.end() && *p >= '0' && *p <= '9'; ++p)
+			n = n * 10 + (*p - '0');
+
+		auto	id	= string(line.begin(), sp);	// line doesn't outlive reading more
+		string::view	payload;
+		if (!in.read(n, payload))
+			break;
+		server.submit(new ServeRequest(id, payload));
+	}
+	server.pool.wait();
+	return 0;
+}
+
+int wmain(int argc, wchar_t* argv[]) {
+#if 0
+	bool forever = true;
+	while (forever) {
+		out << L"waiting for attach..." << endl;
+		Sleep(1000);
+	}
+#endif
+
+	if (argc < 2) {
+		out << L"** NOTE: this is an unofficial replacement for REG **" << endl << endl
+			<< L"REG Operation [Parameter List]" << endl << endl
+			<< L"Operation  [ QUERY | ADD | DELETE | EXPORT | IMPORT | SAVE | SERVE | WATCH ]" << endl << endl
+			<< L"Returns WINERROR code (e.g ERROR_SUCCESS = 0 on sucess)" << endl << endl
+			<< L"For help on a specific operation type:" << endl << endl
+			<< L"REG Operation /?" << endl << endl;
+		return 0;
+	}
+
+	return run(argc - 1, argv + 1);
+}
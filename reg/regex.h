@@ -0,0 +1,639 @@
+#pragma once
+#include "match.h"
+#include "hex.h"
+
+//-----------------------------------------------------------------------------
+//	Regex - a regular expression, parsed into a Thompson NFA and run as a DFA built lazily, a state at a time, as the text needs it
+//
+//	syntax:	. [abc] [^a-z] \d \w \s \D \W \S (and escaped literals, \t \n \r \0 \xHH \uHHHH)
+//			* + ? {n} {n,} {n,m} (a trailing ? is accepted and ignored: it doesn't change whether there is a match)
+//			( ) (?: ) | ^ $
+//	chars are mapped to classes first (chars no part of the pattern can tell apart share one), so a DFA state's transitions are one row;
+//	a literal that every match must contain is looked for first, with a Wildcard, and the DFA only runs on text that has it
+//-----------------------------------------------------------------------------
+
+struct Regex {
+	enum : uint32_t { NONE = ~0u, INF = ~0u, MAX_REPEAT = 1000, MAX_NFA = 1 << 16, MAX_DFA = 4096, DEAD = 0 };
+
+	struct CharRange	{ wchar_t lo, hi; };
+	struct Set {
+		uint32_t	first, count;	// into ranges
+		bool		negate, literal;
+	};
+	struct Node {
+		enum KIND : uint8_t { EMPTY, SET, START, END, CAT, ALT, REPEAT };
+		KIND		kind;
+		uint32_t	a, b;			// children, or a set
+		uint32_t	min, max;
+	};
+	struct State {
+		enum KIND : uint8_t { CHAR, SPLIT, START, END, MATCH };
+		KIND		kind;
+		uint32_t	set;
+		uint32_t	out, out1;
+	};
+	struct DState {
+		uint32_t	first, count;	// into dsets
+		bool		match, match_at_end;
+	};
+
+	// pattern
+	dynamic_range<CharRange>	ranges;
+	dynamic_range<Set>			sets;
+	dynamic_range<Node>			nodes;
+	const wchar_t				*p		= nullptr;
+	const wchar_t				*error	= nullptr;
+	bool						fold	= false;
+	bool						whole	= false;
+
+	// NFA
+	dynamic_range<State>		states;
+	uint32_t					start	= 0;
+
+	// char classes
+	uint16_t					*classes	= nullptr;
+	dynamic_range<wchar_t>		reps;		// a char of each class
+
+	// DFA
+	dynamic_range<DState>		dstates;
+	dynamic_range<uint32_t>		dsets;
+	dynamic_range<uint32_t>		delta;		// dstates * classes; NONE until first needed
+	uint32_t					*table		= nullptr;
+	uint32_t					table_mask	= 0;
+	uint32_t					initial		= 0;
+	bool						empty_match	= false;
+
+	// scratch for building DFA states
+	dynamic_range<uint32_t>		set, stack;
+	uint32_t					*mark		= nullptr;
+	uint32_t					generation	= 0;
+
+	// prefilter
+	dynamic_range<wchar_t>		literal;
+	Wildcard					required;
+	bool						literal_only	= false;
+
+	~Regex() { free(classes); free(table); free(mark); }
+	explicit operator bool() const { return !!classes; }
+
+	uint32_t	num_classes()	const	{ return uint32_t(reps.p - reps.begin()); }
+	uint32_t	num_states()	const	{ return uint32_t(states.p - states.begin()); }
+	uint32_t	num_dstates()	const	{ return uint32_t(dstates.p - dstates.begin()); }
+
+//-----------------------------------------------------------------------------
+//	parsing
+//-----------------------------------------------------------------------------
+
+	uint32_t node(Node::KIND kind, uint32_t a = 0, uint32_t b = 0, uint32_t min = 0, uint32_t max = 0) {
+		*nodes.alloc(1) = {kind, a, b, min, max};
+		return uint32_t(nodes.p - nodes.begin() - 1);
+	}
+	uint32_t new_set(bool negate, bool literal = false) {
+		*sets.alloc(1) = {uint32_t(ranges.p - ranges.begin()), 0, negate, literal};
+		return uint32_t(sets.p - sets.begin() - 1);
+	}
+	void add_range(uint32_t s, wchar_t lo, wchar_t hi) {
+		*ranges.alloc(1) = {lo, hi};
+		++sets.begin()[s].count;
+	}
+	uint32_t literal_set(wchar_t c) {
+		auto	s = new_set(false, true);
+		add_range(s, c, c);
+		return s;
+	}
+
+	// \d \w \s, into s
+	static bool class_escape(wchar_t c) { return c == 'd' || c == 'w' || c == 's' || c == 'D' || c == 'W' || c == 'S'; }
+	void add_class(uint32_t s, wchar_t c) {
+		switch (to_lower((char)c)) {
+			case 'd':	add_range(s, '0', '9'); break;
+			case 'w':	add_range(s, '0', '9'); add_range(s, 'A', 'Z'); add_range(s, 'a', 'z'); add_range(s, '_', '_'); break;
+			case 's':	add_range(s, '\t', '\r'); add_range(s, ' ', ' '); break;
+		}
+	}
+
+	int hex_digits(int n) {
+		int	v = 0;
+		for (int i = 0; i < n; i++) {
+			int	d = hexchar(p[i]);
+			if (d < 0) {
+				error = L"bad hex escape";
+				return 0;
+			}
+			v = v * 16 + d;
+		}
+		p += n;
+		return v;
+	}
+
+	// the char after a '\' (p past it)
+	wchar_t escaped_char() {
+		auto	c = *p++;
+		switch (c) {
+			case 't':	return '\t';
+			case 'n':	return '\n';
+			case 'r':	return '\r';
+			case 'f':	return '\f';
+			case 'v':	return '\v';
+			case '0':	return 0;
+			case 'x':	return hex_digits(2);
+			case 'u':	return hex_digits(4);
+			default:	return c;
+		}
+	}
+
+	uint32_t parse_class() {
+		auto	s = new_set(*p == '^');
+		p += *p == '^';
+		for (bool first = true; first || *p != ']'; first = false) {
+			if (!*p) {
+				error = L"missing ]";
+				return s;
+			}
+			wchar_t	lo = *p++;
+			if (lo == '\\') {
+				if (!*p) {
+					error = L"missing ]";
+					return s;
+				}
+				if (class_escape(*p)) {
+					if (*p < 'a') {
+						error = L"\\D, \\W and \\S are not supported inside []";
+						return s;
+					}
+					add_class(s, *p++);
+					continue;
+				}
+				lo = escaped_char();
+			}
+			wchar_t	hi = lo;
+			if (p[0] == '-' && p[1] && p[1] != ']') {
+				++p;
+				hi = *p++;
+				if (hi == '\\')
+					hi = escaped_char();
+				if (hi < lo) {
+					error = L"bad range in []";
+					return s;
+				}
+			}
+			add_range(s, lo, hi);
+		}
+		++p;
+		return s;
+	}
+
+	uint32_t parse_atom() {
+		auto	c = *p++;
+		switch (c) {
+			case '(': {
+				if (p[0] == '?' && p[1] == ':')
+					p += 2;
+				auto	n = parse_alt();
+				if (*p != ')')
+					error = L"missing )";
+				else
+					++p;
+				return n;
+			}
+			case '[':	return node(Node::SET, parse_class());
+			case '^':	return node(Node::START);
+			case '$':	return node(Node::END);
+			case '.': {
+				auto	s = new_set(true);
+				add_range(s, '\n', '\n');
+				return node(Node::SET, s);
+			}
+			case '*': case '+': case '?':
+				error = L"nothing to repeat";
+				return node(Node::EMPTY);
+			case '\\':
+				if (class_escape(*p)) {
+					auto	s = new_set(*p < 'a');
+					add_class(s, *p++);
+					return node(Node::SET, s);
+				}
+				if (!*p) {
+					error = L"trailing \\";
+					return node(Node::EMPTY);
+				}
+				return node(Node::SET, literal_set(escaped_char()));
+			default:
+				return node(Node::SET, literal_set(c));
+		}
+	}
+
+	static uint32_t number(const wchar_t *&s) {
+		uint32_t	n = 0;
+		while (*s >= '0' && *s <= '9' && n <= MAX_REPEAT)
+			n = n * 10 + (*s++ - '0');
+		return n;
+	}
+
+	// {n}, {n,} or {n,m}; anything else leaves the '{' to be a literal
+	bool parse_count(uint32_t &min, uint32_t &max) {
+		auto	s = p + 1;
+		if (*s < '0' || *s > '9')
+			return false;
+		min = max = number(s);
+		if (*s == ',') {
+			++s;
+			max = *s >= '0' && *s <= '9' ? number(s) : INF;
+		}
+		if (*s != '}')
+			return false;
+		p = s + 1;
+		if (min > MAX_REPEAT || (max != INF && (max > MAX_REPEAT || max < min)))
+			error = L"bad repeat count";
+		return true;
+	}
+
+	uint32_t parse_repeat() {
+		auto	n = parse_atom();
+		for (;;) {
+			uint32_t	min, max;
+			if (*p == '*') {
+				min = 0; max = INF; ++p;
+			} else if (*p == '+') {
+				min = 1; max = INF; ++p;
+			} else if (*p == '?') {
+				min = 0; max = 1; ++p;
+			} else if (*p != '{' || !parse_count(min, max)) {
+				return n;
+			}
+			p += *p == '?';
+			n = node(Node::REPEAT, n, 0, min, max);
+		}
+	}
+
+	uint32_t parse_cat() {
+		uint32_t	n = NONE;
+		while (*p && *p != '|' && *p != ')' && !error) {
+			auto	r = parse_repeat();
+			n = n == NONE ? r : node(Node::CAT, n, r);
+		}
+		return n == NONE ? node(Node::EMPTY) : n;
+	}
+
+	uint32_t parse_alt() {
+		auto	n = parse_cat();
+		while (*p == '|' && !error) {
+			++p;
+			auto	b = parse_cat();
+			n = node(Node::ALT, n, b);
+		}
+		return n;
+	}
+
+//-----------------------------------------------------------------------------
+//	the longest run of literal chars at the top level, which any match must contain
+//-----------------------------------------------------------------------------
+
+	bool is_literal(const Node &n) const {
+		if (n.kind != Node::SET || !sets.begin()[n.a].literal)
+			return false;
+		auto	c = ranges.begin()[sets.begin()[n.a].first].lo;
+		return c && c != '*' && c != '?';		// which would mean something to Wildcard
+	}
+
+	void find_literal(uint32_t i, dynamic_range<wchar_t> &run) {
+		auto	&n = nodes.begin()[i];
+		if (n.kind == Node::CAT) {
+			find_literal(n.a, run);
+			find_literal(n.b, run);
+
+		} else if (is_literal(n)) {
+			auto	c = ranges.begin()[sets.begin()[n.a].first].lo;
+			*run.alloc(1) = fold ? fold_case(c) : c;
+			auto	len = run.p - run.begin();
+			if (len > literal.p - literal.begin()) {
+				literal.p = literal.begin();
+				memcpy(literal.alloc(len), run.begin(), len * sizeof(wchar_t));
+			}
+
+		} else if (n.kind != Node::START && n.kind != Node::END && n.kind != Node::EMPTY) {
+			run.p = run.begin();
+		}
+	}
+
+	// a pattern that is nothing but the literal needs no DFA at all
+	void make_prefilter(uint32_t root) {
+		dynamic_range<wchar_t>	run;
+		find_literal(root, run);
+		if (literal.p > literal.begin()) {
+			literal_only = true;
+			for (auto &n : make_range(nodes.begin(), nodes.p))
+				literal_only = literal_only && (n.kind == Node::CAT || is_literal(n));
+			*literal.alloc(1) = 0;
+			required.compile(literal.begin(), literal_only && whole, fold);
+		}
+	}
+
+//-----------------------------------------------------------------------------
+//	NFA, built back to front so each fragment knows what follows it
+//-----------------------------------------------------------------------------
+
+	uint32_t add_state(State::KIND kind, uint32_t set, uint32_t out, uint32_t out1 = NONE) {
+		*states.alloc(1) = {kind, set, out, out1};
+		return num_states() - 1;
+	}
+
+	uint32_t emit(uint32_t i, uint32_t next) {
+		if (num_states() > MAX_NFA) {
+			error = L"expression too big";
+			return next;
+		}
+		auto	n = nodes.begin()[i];
+		switch (n.kind) {
+			default:
+			case Node::EMPTY:	return next;
+			case Node::SET:		return add_state(State::CHAR, n.a, next);
+			case Node::START:	return add_state(State::START, 0, next);
+			case Node::END:		return add_state(State::END, 0, next);
+			case Node::CAT:		return emit(n.a, emit(n.b, next));
+			case Node::ALT: {
+				auto	a = emit(n.a, next);
+				auto	b = emit(n.b, next);
+				return add_state(State::SPLIT, 0, a, b);
+			}
+			case Node::REPEAT: {
+				auto	cur = next;
+				if (n.max == INF) {
+					auto	loop	= add_state(State::SPLIT, 0, NONE, next);
+					auto	body	= emit(n.a, loop);
+					states.begin()[loop].out = body;
+					cur = loop;
+				} else {
+					for (uint32_t j = n.min; j < n.max; j++) {
+						auto	body = emit(n.a, cur);
+						cur = add_state(State::SPLIT, 0, body, cur);
+					}
+				}
+				for (uint32_t j = 0; j < n.min; j++)
+					cur = emit(n.a, cur);
+				return cur;
+			}
+		}
+	}
+
+//-----------------------------------------------------------------------------
+//	char classes
+//-----------------------------------------------------------------------------
+
+	bool in_ranges(const Set &s, wchar_t c) const {
+		for (auto r = ranges.begin() + s.first, e = r + s.count; r < e; ++r) {
+			if (c >= r->lo && c <= r->hi)
+				return true;
+		}
+		return false;
+	}
+
+	// a literal matches exactly what Wildcard does with fold, so the prefilter never rejects a match; a [] takes either case of c (before any ^)
+	bool matches(const Set &s, wchar_t c) const {
+		if (!fold)
+			return in_ranges(s, c) != s.negate;
+		if (s.literal)
+			return fold_case(ranges.begin()[s.first].lo) == fold_case(c);
+		return (in_ranges(s, c) || in_ranges(s, (wchar_t)towlower(c)) || in_ranges(s, (wchar_t)towupper(c))) != s.negate;
+	}
+
+	// each set splits every class into the chars in it and those not; a literal char that has been seen already can't split anything
+	void make_classes() {
+		auto	cls		= (uint32_t*)calloc(0x10000, sizeof(uint32_t));
+		auto	remap	= (uint32_t*)malloc(0x20000 * sizeof(uint32_t));
+		auto	folded	= (wchar_t*)malloc(0x10000 * sizeof(wchar_t));
+		auto	seen	= (uint32_t*)calloc(0x10000 / 32, sizeof(uint32_t));
+		for (uint32_t c = 0; c < 0x10000; c++)
+			folded[c] = fold ? fold_case((wchar_t)c) : (wchar_t)c;
+
+		uint32_t	n	= 1;
+		for (auto &s : make_range(sets.begin(), sets.p)) {
+			auto	x	= folded[(uint16_t)ranges.begin()[s.first].lo];
+			if (s.literal) {
+				if (seen[x / 32] & (1u << (x % 32)))
+					continue;
+				seen[x / 32] |= 1u << (x % 32);
+			}
+			memset(remap, 0xff, n * 2 * sizeof(uint32_t));
+			uint32_t	n2 = 0;
+			for (uint32_t c = 0; c < 0x10000; c++) {
+				auto	&r = remap[cls[c] * 2 + (s.literal ? folded[c] == x : matches(s, (wchar_t)c))];
+				if (r == NONE)
+					r = n2++;
+				cls[c] = r;
+			}
+			n = n2;
+		}
+		free(remap);
+		free(folded);
+		free(seen);
+
+		classes	= (uint16_t*)malloc(0x10000 * sizeof(uint16_t));
+		memset(reps.alloc(n), 0, n * sizeof(wchar_t));
+		for (uint32_t c = 0x10000; c--;) {
+			classes[c]			= (uint16_t)cls[c];
+			reps.begin()[cls[c]] = (wchar_t)c;
+		}
+		free(cls);
+	}
+
+//-----------------------------------------------------------------------------
+//	DFA
+//-----------------------------------------------------------------------------
+
+	// adds the states reachable from s without consuming a char; ^ only passes at the start of the text
+	void closure(uint32_t s, bool at_start) {
+		*stack.alloc(1) = s;
+		while (stack.p > stack.begin()) {
+			auto	i = *--stack.p;
+			if (i == NONE || mark[i] == generation)
+				continue;
+			mark[i] = generation;
+			auto	&st = states.begin()[i];
+			switch (st.kind) {
+				case State::SPLIT:
+					*stack.alloc(1) = st.out1;
+					*stack.alloc(1) = st.out;
+					break;
+				case State::START:
+					if (at_start)
+						*stack.alloc(1) = st.out;
+					break;
+				default:
+					*set.alloc(1) = i;
+					break;
+			}
+		}
+	}
+
+	// whether the text could end here: $ passes, and anything left to consume can't be (nor can ^, unless the text is empty)
+	bool accepts_at_end(range<const uint32_t*> s, bool at_start = false) {
+		++generation;
+		for (auto i : s) {
+			if (states.begin()[i].kind == State::END)
+				*stack.alloc(1) = states.begin()[i].out;
+		}
+		bool	found = false;
+		while (stack.p > stack.begin()) {
+			auto	i = *--stack.p;
+			if (found || mark[i] == generation)
+				continue;
+			mark[i] = generation;
+			auto	&st = states.begin()[i];
+			switch (st.kind) {
+				case State::SPLIT:	*stack.alloc(1) = st.out1; *stack.alloc(1) = st.out; break;
+				case State::END:	*stack.alloc(1) = st.out; break;
+				case State::START:	if (at_start) *stack.alloc(1) = st.out; break;
+				case State::MATCH:	found = true; break;
+				default:			break;
+			}
+		}
+		stack.p = stack.begin();
+		return found;
+	}
+
+	static uint32_t hash(range<const uint32_t*> s) {
+		uint32_t	h = 2166136261u;
+		for (auto i : s)
+			h = (h ^ i) * 16777619u;
+		return h;
+	}
+
+	void clear_dfa() {
+		dstates.p	= dstates.begin();
+		dsets.p		= dsets.begin();
+		delta.p		= delta.begin();
+		memset(table, 0xff, (table_mask + 1) * sizeof(uint32_t));
+	}
+
+	// the DFA state for the sorted NFA states in set, made if it's new
+	uint32_t dstate() {
+		auto	s		= make_range((const uint32_t*)set.begin(), (const uint32_t*)set.p);
+		auto	n		= s.size();
+		for (auto h = hash(s);; ++h) {
+			auto	&slot = table[h & table_mask];
+			if (slot == NONE) {
+				auto	d = num_dstates();
+				slot	= d;
+				auto	first = uint32_t(dsets.p - dsets.begin());
+				memcpy(dsets.alloc(n), s.begin(), n * sizeof(uint32_t));
+
+				bool	match = false;
+				for (auto i : s)
+					match = match || states.begin()[i].kind == State::MATCH;
+				*dstates.alloc(1) = {first, uint32_t(n), match, match || accepts_at_end(s)};
+				memset(delta.alloc(num_classes()), 0xff, num_classes() * sizeof(uint32_t));
+				return d;
+			}
+			auto	&d = dstates.begin()[slot];
+			if (d.count == n && memcmp(dsets.begin() + d.first, s.begin(), n * sizeof(uint32_t)) == 0)
+				return slot;
+		}
+	}
+
+	static int compare_ids(const void *a, const void *b) {
+		auto	x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+		return x < y ? -1 : x > y;
+	}
+
+	uint32_t finish_set() {
+		qsort(set.begin(), set.p - set.begin(), sizeof(uint32_t), compare_ids);
+		auto	d = dstate();
+		set.p = set.begin();
+		return d;
+	}
+
+	void start_dfa() {
+		finish_set();					// DEAD, with nothing in it
+		++generation;
+		closure(start, true);
+		initial = finish_set();
+
+		auto	&d	= dstates.begin()[initial];
+		empty_match	= d.match || accepts_at_end(make_range((const uint32_t*)dsets.begin() + d.first, d.count), true);
+	}
+
+	// where d goes on class k; a full cache is thrown away (keeping d) rather than let it grow without bound
+	uint32_t step(uint32_t &d, uint32_t k) {
+		if (num_dstates() >= MAX_DFA) {
+			auto	from	= dstates.begin()[d];
+			auto	saved	= (uint32_t*)malloc(from.count * sizeof(uint32_t));
+			memcpy(saved, dsets.begin() + from.first, from.count * sizeof(uint32_t));
+			clear_dfa();
+			start_dfa();
+			memcpy(set.alloc(from.count), saved, from.count * sizeof(uint32_t));
+			free(saved);
+			d = finish_set();
+		}
+
+		++generation;
+		auto	c = reps.begin()[k];
+		auto	from = dstates.begin()[d];
+		for (uint32_t j = 0; j < from.count; j++) {
+			auto	&st = states.begin()[dsets.begin()[from.first + j]];
+			if (st.kind == State::CHAR && matches(sets.begin()[st.set], c))
+				closure(st.out, false);
+		}
+		if (!whole)
+			closure(start, false);		// a match may begin anywhere
+		auto	t = finish_set();
+		delta.begin()[d * num_classes() + k] = t;
+		return t;
+	}
+
+//-----------------------------------------------------------------------------
+//	interface
+//-----------------------------------------------------------------------------
+
+	// with whole the pattern must match all of the text, otherwise any part of it; fails with error set
+	bool compile(const wchar_t *pattern, bool fold, bool whole) {
+		this->fold	= fold;
+		this->whole	= whole;
+		p			= pattern;
+		auto	root = parse_alt();
+		if (!error && *p)
+			error = L"unmatched )";
+		if (error)
+			return false;
+
+		auto	match = add_state(State::MATCH, 0, NONE);
+		start = emit(root, match);
+		if (error)
+			return false;
+
+		make_prefilter(root);
+		make_classes();
+		mark		= (uint32_t*)calloc(num_states(), sizeof(uint32_t));
+		table_mask	= MAX_DFA * 2 - 1;
+		table		= (uint32_t*)malloc((table_mask + 1) * sizeof(uint32_t));
+		clear_dfa();
+		start_dfa();
+		return true;
+	}
+
+	bool operator()(string::view text) {
+		if (literal.begin() && !required(text))
+			return false;
+		if (literal_only)
+			return true;
+
+		if (text.empty())
+			return empty_match;
+
+		auto		nc	= num_classes();
+		uint32_t	d	= initial;
+		for (auto c : text) {
+			auto	&ds = dstates.begin()[d];
+			if (ds.match && !whole)
+				return true;
+			auto	k	= classes[(uint16_t)c];
+			auto	t	= delta.begin()[d * nc + k];
+			if (t == NONE)
+				t = step(d, k);
+			if (t == DEAD)
+				return false;
+			d = t;
+		}
+		return dstates.begin()[d].match_at_end;
+	}
+};
@@ -0,0 +1,215 @@
+#pragma once
+#include "base.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//-----------------------------------------------------------------------------
+//	snapshot - a binary copy of a subtree, laid out to be used straight from a mapped file
+//
+//	header
+//	blobs:		names (uint32 length, UTF-16 chars, a terminating 0) and value data, 4-byte aligned
+//	keys:		SnapshotKeyRecord[num_keys], in the order a depth-first walk visits them; key 0 is the root, named with its full path
+//	values:		SnapshotValueRecord[num_values], each key's values contiguous
+//	children:	uint32 key indices, each key's subkeys contiguous
+//-----------------------------------------------------------------------------
+
+struct SnapshotHeader {
+	enum { MAGIC = 'R' | ('E' << 8) | ('G' << 16) | ('S' << 24), VERSION = 1 };
+	uint32_t	magic, version;
+	uint32_t	num_keys, num_values;
+	uint64_t	keys, values, children;		// section offsets
+	uint64_t	size;
+};
+
+struct SnapshotKeyRecord {
+	uint64_t	name;
+	uint64_t	last_write;					// FILETIME
+	uint32_t	first_value, num_values;
+	uint32_t	first_subkey, num_subkeys;	// into children
+	uint32_t	max_data, pad;
+};
+
+struct SnapshotValueRecord {
+	uint64_t	name;
+	uint64_t	data;
+	uint32_t	size, type;
+};
+
+typedef range<const char16_t*>	snapshot_name;
+
+struct Snapshot {
+	range<const byte*>			file;
+	const SnapshotHeader		*header	= nullptr;
+	const SnapshotKeyRecord		*keys	= nullptr;
+	const SnapshotValueRecord	*values	= nullptr;
+	const uint32_t				*children = nullptr;
+
+	// n bytes at offset lie within size, without a sum that could wrap
+	static bool fits(uint64_t offset, uint64_t n, uint64_t size) {
+		return n <= size && offset <= size - n;
+	}
+
+	static bool is_snapshot(range<const byte*> file) {
+		return file.size() >= sizeof(SnapshotHeader) && ((const SnapshotHeader*)file.begin())->magic == SnapshotHeader::MAGIC;
+	}
+
+	Snapshot(range<const byte*> file) : file(file) {
+		if (!is_snapshot(file))
+			return;
+		auto	h = (const SnapshotHeader*)file.begin();
+		if (h->version != SnapshotHeader::VERSION || h->size > file.size() || !h->num_keys
+			|| !fits(h->keys,		uint64_t(h->num_keys)	* sizeof(SnapshotKeyRecord),	h->size)
+			|| !fits(h->values,		uint64_t(h->num_values)	* sizeof(SnapshotValueRecord),	h->size)
+			|| !fits(h->children,	uint64_t(h->num_keys)	* sizeof(uint32_t),				h->size)
+		)
+			return;
+		header		= h;
+		keys		= (const SnapshotKeyRecord*)(file.begin() + h->keys);
+		values		= (const SnapshotValueRecord*)(file.begin() + h->values);
+		children	= (const uint32_t*)(file.begin() + h->children);
+	}
+	explicit operator bool() const { return !!header; }
+
+	// anything pointing outside the file comes back empty rather than faulting
+	snapshot_name name(uint64_t offset) const {
+		if (!fits(offset, 4, header->size))
+			return {};
+		auto	len = *(const uint32_t*)(file.begin() + offset);
+		if (!fits(offset + 4, (uint64_t(len) + 1) * 2, header->size))
+			return {};
+		return {(const char16_t*)(file.begin() + offset + 4), len};
+	}
+	range<const byte*> data(const SnapshotValueRecord &v) const {
+		if (!fits(v.data, v.size, header->size))
+			return {};
+		return {file.begin() + v.data, v.size};
+	}
+
+	const SnapshotKeyRecord		&key(uint32_t i)					const	{ return keys[i]; }
+	const SnapshotValueRecord	*value(uint32_t key, uint32_t i)	const	{
+		return i < num_values(key) ? values + keys[key].first_value + i : nullptr;
+	}
+
+	// a key's counts, cut down to the records there are
+	uint32_t num_values(uint32_t key) const {
+		auto	&k = keys[key];
+		return k.first_value < header->num_values ? min(k.num_values, header->num_values - k.first_value) : 0;
+	}
+	uint32_t num_subkeys(uint32_t key) const {
+		auto	&k = keys[key];
+		return k.first_subkey < header->num_keys ? min(k.num_subkeys, header->num_keys - k.first_subkey) : 0;
+	}
+
+	// keys are in depth-first order, so a key's subtree is the run of keys after it up to end, split between its subkeys in order;
+	// end is set to where the subkey's run ends, and one outside its parent's is left out, so walking a corrupt file can't loop
+	// or come to the same key twice
+	int subkey(uint32_t key, uint32_t i, uint32_t &end) const {
+		auto	n = num_subkeys(key);
+		if (i >= n)
+			return -1;
+		auto	c		= children + keys[key].first_subkey;
+		auto	sub		= c[i];
+		auto	next	= i + 1 < n ? min(c[i + 1], end) : end;
+		if (sub <= key || (i && sub <= c[i - 1]) || sub >= next)
+			return -1;
+		end = next;
+		return (int)sub;
+	}
+	// for looking a subkey up by name, rather than walking into it
+	int subkey(uint32_t key, uint32_t i) const {
+		uint32_t	end = header->num_keys;
+		return subkey(key, i, end);
+	}
+};
+
+//-----------------------------------------------------------------------------
+//	SnapshotBuilder - keys must be added depth first, each followed by its own values before any subkeys
+//-----------------------------------------------------------------------------
+
+struct SnapshotBuilder {
+	enum : uint32_t { NONE = ~0u };		// the root's parent
+	dynamic_range<byte>					blobs;
+	dynamic_range<SnapshotKeyRecord>	keys;
+	dynamic_range<SnapshotValueRecord>	values;
+	dynamic_range<uint32_t>				parents;
+
+	static size_t align(size_t n, size_t a) { return (n + a - 1) & ~(a - 1); }
+
+	size_t	num_keys()		const	{ return keys.p - keys.begin(); }
+	size_t	num_values()	const	{ return values.p - values.begin(); }
+
+	uint64_t add_blob(const void *p, size_t n) {
+		auto	offset	= blobs.p - blobs.begin();
+		auto	size	= align(n, 4);
+		auto	d		= blobs.alloc(size);
+		memcpy(d, p, n);
+		memset(d + n, 0, size - n);
+		return sizeof(SnapshotHeader) + offset;
+	}
+	uint64_t add_name(snapshot_name name) {
+		uint32_t	len		= name.size();
+		auto		offset	= blobs.p - blobs.begin();
+		auto		size	= align(4 + (len + 1) * 2, 4);
+		auto		d		= blobs.alloc(size);
+		memcpy(d, &len, 4);
+		memcpy(d + 4, name.begin(), len * 2);
+		memset(d + 4 + len * 2, 0, size - 4 - len * 2);
+		return sizeof(SnapshotHeader) + offset;
+	}
+
+	uint32_t add_key(uint32_t parent, snapshot_name name, uint64_t last_write) {
+		auto	i = num_keys();
+		*keys.alloc(1)		= {add_name(name), last_write, (uint32_t)num_values(), 0, 0, 0, 0, 0};
+		*parents.alloc(1)	= parent;
+		return i;
+	}
+
+	// adds to the most recently added key
+	void add_value(snapshot_name name, uint32_t type, range<const byte*> data) {
+		auto	&k = keys.p[-1];
+		*values.alloc(1) = {add_name(name), add_blob(data.begin(), data.size()), (uint32_t)data.size(), type};
+		++k.num_values;
+		k.max_data = max(k.max_data, (uint32_t)data.size());
+	}
+
+	// w(const void*, size_t) is called with the file in order
+	template<typename W> void write(W &&w) {
+		auto	nk	= num_keys(), nv = num_values();
+		auto	k	= keys.begin();
+
+		// subkeys are listed grouped by parent, each group in the order added
+		auto	children	= (uint32_t*)calloc(max(nk, size_t(1)), sizeof(uint32_t));	// the root is no key's child, so one is spare
+		for (size_t i = 1; i < nk; i++)
+			++k[parents.begin()[i]].num_subkeys;
+		uint32_t	first = 0;
+		for (size_t i = 0; i < nk; i++) {
+			k[i].first_subkey	= first;
+			first				+= k[i].num_subkeys;
+			k[i].num_subkeys	= 0;
+		}
+		for (size_t i = 1; i < nk; i++) {
+			auto	&parent = k[parents.begin()[i]];
+			children[parent.first_subkey + parent.num_subkeys++] = i;
+		}
+
+		SnapshotHeader	h;
+		h.magic			= SnapshotHeader::MAGIC;
+		h.version		= SnapshotHeader::VERSION;
+		h.num_keys		= nk;
+		h.num_values	= nv;
+		h.keys			= align(sizeof(h) + (blobs.p - blobs.begin()), 8);
+		h.values		= h.keys + nk * sizeof(SnapshotKeyRecord);
+		h.children		= h.values + nv * sizeof(SnapshotValueRecord);
+		h.size			= h.children + nk * sizeof(uint32_t);
+
+		static const byte	zeros[8] = {0};
+		w(&h, sizeof(h));
+		w(blobs.begin(), blobs.p - blobs.begin());
+		w(zeros, h.keys - sizeof(h) - (blobs.p - blobs.begin()));
+		w(keys.begin(), nk * sizeof(SnapshotKeyRecord));
+		w(values.begin(), nv * sizeof(SnapshotValueRecord));
+		w(children, nk * sizeof(uint32_t));
+		free(children);
+	}
+};
@@ -1,3 +1,4 @@
+#pragma once
 #include "text.h"
 #include <memory.h>
 #include <stdlib.h>
@@ -26,12 +27,20 @@ public:
 		view 	substr(int i, int j)	const	{ return {a + i, a + i + j}; }
 		view 	trim()					const	{
 			auto a = begin(), b = end();
-			while (is_whitespace(*a))
+			while (a < b && is_whitespace(*a))
 				a++;
 			while (b > a && is_whitespace(b[-1]))
 				--b;
 			return {a, b};
 		}
+		bool	startsWith(const view &s)	const	{ return s.size() <= size() && comparen(a, s.a, s.size()); }
+		const wchar_t* find_last(wchar_t c)	const	{
+			for (auto t = b; t-- != a; ) {
+				if (*t == c)
+					return t;
+			}
+			return nullptr;
+		}
 		friend string operator+(const view &a, const view &b);
 		friend string operator+(const view &a, wchar_t b);
 	};
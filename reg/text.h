@@ -23,7 +23,7 @@ template<typename C> size_t string_length(const C* s) {
 	return i - s;
 }
 
-template<typename C> size_t string_compare(const C* a, const C *b) {
+template<typename C> int string_compare(const C* a, const C *b) {
 	if (a && b) {
 		while (*a && *a == *b)
 			++a, ++b;
@@ -32,15 +32,19 @@ template<typename C> size_t string_compare(const C* a, const C *b) {
 	return (a ? *a : 0) - (b ? *b : 0);
 }
 
-template<typename C> size_t string_compare(const C* a, const C *b, size_t blen) {
+template<typename C> int string_compare(const C* a, const C *b, size_t blen) {
 	while (blen && *a && *a == *b)
 		++a, ++b, --blen;
 	return blen ? *a - *b : *a;
 }
 
-template<typename C> size_t string_compare(const C* a, const C *b, size_t alen, size_t blen) {
-	auto r = memcmp(a, b, min(alen, blen));
-	return r ? r : alen - blen;
+// by chars, not bytes (memcmp would order UTF-16 by its low byte first)
+template<typename C> int string_compare(const C* a, const C *b, size_t alen, size_t blen) {
+	for (size_t i = 0, n = min(alen, blen); i < n; i++) {
+		if (a[i] != b[i])
+			return a[i] - b[i];
+	}
+	return int(alen > blen) - int(alen < blen);
 }
 
 template<int B, typename C, typename T> inline C *put_digits(T t, C *d, identity_t<C> ten = 'A', int num_digits = -1) {
@@ -0,0 +1,330 @@
+#pragma once
+#include "base.h"
+#include <windows.h>
+
+//-----------------------------------------------------------------------------
+//	synchronisation
+//-----------------------------------------------------------------------------
+
+struct Mutex {
+	SRWLOCK	srw = SRWLOCK_INIT;
+	void	lock()		{ AcquireSRWLockExclusive(&srw); }
+	void	unlock()	{ ReleaseSRWLockExclusive(&srw); }
+};
+
+struct Lock {
+	Mutex	&m;
+	Lock(Mutex &m) : m(m)	{ m.lock(); }
+	~Lock()					{ m.unlock(); }
+};
+
+struct Condition {
+	CONDITION_VARIABLE	cv = CONDITION_VARIABLE_INIT;
+	void	wait(Mutex &m)	{ SleepConditionVariableSRW(&cv, &m.srw, INFINITE, 0); }
+	bool	wait(Mutex &m, DWORD ms)	{ return SleepConditionVariableSRW(&cv, &m.srw, ms, 0); }	// false on timing out
+	void	notify()		{ WakeConditionVariable(&cv); }
+	void	notify_all()	{ WakeAllConditionVariable(&cv); }
+};
+
+inline int num_cpus() {
+	SYSTEM_INFO	info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+}
+
+//-----------------------------------------------------------------------------
+//	ThreadPool
+//-----------------------------------------------------------------------------
+
+struct ThreadPool {
+	struct Job {
+		Job	*next = nullptr;
+		virtual ~Job() {}
+		virtual void run() = 0;
+	};
+	template<typename F> struct FunctionJob : Job {
+		F	f;
+		FunctionJob(const F &f) : f(f) {}
+		void run() override { f(); }
+	};
+
+	Mutex		m;
+	Condition	work_cv, idle_cv;
+	Job			*head = nullptr, *tail = nullptr;
+	HANDLE		*threads;
+	int			num_threads;
+	int			busy	= 0;
+	bool		quit	= false;
+
+	static DWORD WINAPI thread_proc(void *p) {
+		((ThreadPool*)p)->worker();
+		return 0;
+	}
+
+	void worker() {
+		for (;;) {
+			Job	*job;
+			{
+				Lock	lock(m);
+				while (!head && !quit)
+					work_cv.wait(m);
+				if (!head)
+					return;
+				job		= head;
+				head	= job->next;
+				if (!head)
+					tail = nullptr;
+				++busy;
+			}
+			job->run();
+			delete job;
+			{
+				Lock	lock(m);
+				if (!--busy && !head)
+					idle_cv.notify_all();
+			}
+		}
+	}
+
+	ThreadPool(int n = num_cpus()) : threads((HANDLE*)malloc(max(n, 1) * sizeof(HANDLE))), num_threads(max(n, 1)) {
+		for (int i = 0; i < num_threads; i++)
+			threads[i] = CreateThread(NULL, 0, thread_proc, this, 0, NULL);
+	}
+
+	// runs everything already queued before returning
+	~ThreadPool() {
+		{
+			Lock	lock(m);
+			quit = true;
+		}
+		work_cv.notify_all();
+		for (int i = 0; i < num_threads; i++) {
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+		}
+		free(threads);
+	}
+
+	template<typename F> void submit(const F &f) {
+		Job	*job = new FunctionJob<F>(f);
+		{
+			Lock	lock(m);
+			if (tail)
+				tail->next = job;
+			else
+				head = job;
+			tail = job;
+		}
+		work_cv.notify();
+	}
+
+	void wait() {
+		Lock	lock(m);
+		while (head || busy)
+			idle_cv.wait(m);
+	}
+};
+
+//-----------------------------------------------------------------------------
+//	OrderedJobs - runs jobs on a pool a bounded distance ahead of a consumer that takes them back in submission order
+//-----------------------------------------------------------------------------
+
+template<typename T> struct OrderedJobs {
+	struct Slot {
+		T		*item;
+		bool	done;
+	};
+	ThreadPool	&pool;
+	Mutex		m;
+	Condition	finished;
+	Slot		ring[64]	= {};
+	int			ahead, submitted = 0, taken = 0;
+
+	OrderedJobs(ThreadPool &pool) : pool(pool), ahead(min(pool.num_threads * 2, (int)num_elements(ring))) {}
+
+	// anything not taken back finishes running before it is freed
+	~OrderedJobs() {
+		pool.wait();
+		for (auto &i : ring)
+			delete i.item;
+	}
+
+	bool full() const { return submitted == taken + ahead; }
+
+	// f(item) runs on the pool; only call when !full()
+	template<typename F> void submit(T *item, const F &f) {
+		auto	slot = &ring[submitted++ % ahead];
+		slot->item	= item;
+		slot->done	= false;
+		pool.submit([this, slot, item, f]() {
+			f(item);
+			{
+				Lock	lock(m);
+				slot->done = true;
+			}
+			finished.notify_all();
+		});
+	}
+
+	// waits for the oldest outstanding item and hands it (and its ownership) back, or nullptr if there are none
+	T *next() {
+		if (taken == submitted)
+			return nullptr;
+		auto	&slot = ring[taken++ % ahead];
+		{
+			Lock	lock(m);
+			while (!slot.done)
+				finished.wait(m);
+		}
+		return exchange(slot.item, nullptr);
+	}
+};
+
+//-----------------------------------------------------------------------------
+//	StealingPool - a deque of jobs per worker; a worker takes its own newest job first, and only when it has none the oldest job of another,
+//	so each goes depth first through the work it makes itself while idle ones take the biggest pieces of it
+//-----------------------------------------------------------------------------
+
+struct StealingPool {
+	struct Job {
+		virtual ~Job() {}
+		virtual void run(int worker) = 0;
+	};
+	template<typename F> struct FunctionJob : Job {
+		F	f;
+		FunctionJob(const F &f) : f(f) {}
+		void run(int worker) override { f(worker); }
+	};
+
+	struct Deque {
+		Mutex		m;
+		Job			**jobs		= nullptr;
+		uint32_t	capacity	= 0;	// a power of 2
+		uint32_t	head = 0, tail = 0;	// oldest at head; both only ever increase, and wrap through capacity
+
+		~Deque() { free(jobs); }
+
+		uint32_t size() {
+			Lock	lock(m);
+			return tail - head;
+		}
+		void push(Job *job) {
+			Lock	lock(m);
+			if (tail - head == capacity) {
+				auto	n		= max(capacity * 2, 16u);
+				auto	jobs2	= (Job**)malloc(n * sizeof(Job*));
+				for (uint32_t i = head; i != tail; i++)
+					jobs2[i - head] = jobs[i & (capacity - 1)];
+				free(jobs);
+				jobs		= jobs2;
+				tail		-= head;
+				head		= 0;
+				capacity	= n;
+			}
+			jobs[tail++ & (capacity - 1)] = job;
+		}
+		Job *pop() {
+			Lock	lock(m);
+			return head == tail ? nullptr : jobs[--tail & (capacity - 1)];
+		}
+		Job *steal() {
+			Lock	lock(m);
+			return head == tail ? nullptr : jobs[head++ & (capacity - 1)];
+		}
+	};
+
+	Mutex		m;
+	Condition	work_cv, idle_cv;
+	Deque		*deques;
+	HANDLE		*threads;
+	int			num_threads;
+	int			started	= 0;
+	int			queued	= 0, busy = 0;
+	bool		quit	= false;
+
+	static DWORD WINAPI thread_proc(void *p) {
+		auto	pool = (StealingPool*)p;
+		int		w;
+		{
+			Lock	lock(pool->m);
+			w = pool->started++;
+		}
+		pool->worker(w);
+		return 0;
+	}
+
+	Job *take(int w) {
+		auto	job = deques[w].pop();
+		for (int i = 1; !job && i < num_threads; i++)
+			job = deques[(w + i) % num_threads].steal();
+		return job;
+	}
+
+	void worker(int w) {
+		for (;;) {
+			auto	job = take(w);
+			if (!job) {
+				// queued only counts a job once it is in a deque, and until it's been taken out of one, so this can't miss any
+				Lock	lock(m);
+				if (!queued) {
+					if (quit)
+						return;
+					work_cv.wait(m);
+				}
+				continue;
+			}
+			{
+				Lock	lock(m);
+				--queued;
+				++busy;
+			}
+			job->run(w);
+			delete job;
+			{
+				Lock	lock(m);
+				if (!--busy && !queued)
+					idle_cv.notify_all();
+			}
+		}
+	}
+
+	StealingPool(int n = num_cpus()) : num_threads(max(n, 1)) {
+		deques	= new Deque[num_threads];
+		threads	= (HANDLE*)malloc(num_threads * sizeof(HANDLE));
+		for (int i = 0; i < num_threads; i++)
+			threads[i] = CreateThread(NULL, 0, thread_proc, this, 0, NULL);
+	}
+
+	// runs everything already queued before returning
+	~StealingPool() {
+		{
+			Lock	lock(m);
+			quit = true;
+		}
+		work_cv.notify_all();
+		for (int i = 0; i < num_threads; i++) {
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+		}
+		free(threads);
+		delete[] deques;
+	}
+
+	// f(worker) runs on the pool; a job passes its own worker to keep what it makes to itself until someone steals it
+	template<typename F> void submit(const F &f, int worker = 0) {
+		deques[worker].push(new FunctionJob<F>(f));
+		{
+			Lock	lock(m);
+			++queued;
+		}
+		work_cv.notify();
+	}
+
+	uint32_t waiting(int worker) { return deques[worker].size(); }
+
+	void wait() {
+		Lock	lock(m);
+		while (queued || busy)
+			idle_cv.wait(m);
+	}
+};
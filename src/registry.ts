@@ -7,7 +7,11 @@ const KEY_PATTERN   = /(\\[a-zA-Z0-9_\s]+)*/;
 const PATH_PATTERN	= /^(HKEY_LOCAL_MACHINE|HKEY_CURRENT_USER|HKEY_CLASSES_ROOT|HKEY_USERS|HKEY_CURRENT_CONFIG).*\\(.*)$/;
 const ITEM_PATTERN  = /^\s*(.*?)\s+(REG_[A-Z_]+)(\s+\((.*?)\))?\s*(.*)$/;
 
-let		reg_exec = process.platform === 'win32' ? path.join(process.env.windir || '', 'system32', 'reg.exe') : "REG";
+function systemReg() {
+	return process.platform === 'win32' ? path.join(process.env.windir || '', 'system32', 'reg.exe') : "REG";
+}
+
+let		reg_exec = systemReg();
 const	hosts32 : Record<string, KeyHost> = {};
 const	hosts64 : Record<string, KeyHost> = {};
 
@@ -313,7 +317,11 @@ export class CancellablePromise<T> extends Promise<T> {
 	}
 }
 
-class Process {
+interface Output {
+	stdout:	string;
+}
+
+class Process implements Output {
 	proc: ChildProcess;
 	stdout: string = '';
 	stderr: string = '';
@@ -359,6 +367,119 @@ class Process {
 	}
 }
 
+function spawnReg(exec: string, args: string[]) {
+	return new Promise<Process>((resolve, reject) => new Process(exec, args, resolve, reject));
+}
+
+interface Request {
+	args:		string[];
+	plain:		string[];		// to run instead if it has to fall back to an executable without SERVE
+	stdout:		string;
+	resolve:	(output: Output) => void;
+	reject:		(reason?: Error) => void;
+}
+
+// one `REG SERVE` running every command sent to it, so an alternative executable isn't started again for each one
+class Server {
+	proc:		ChildProcess;
+	output		= '';
+	next		= 0;
+	pending:	Record<string, Request> = {};
+	answered	= false;
+	closed		= false;
+
+	constructor(public exec: string) {
+		const proc = spawn(exec, ['SERVE'], {
+			cwd: undefined,
+			env: process.env,
+			shell: false,
+			stdio: ['pipe', 'pipe', 'ignore']
+		});
+		this.proc = proc;
+
+		proc.stdout!.setEncoding('utf8');
+		proc.stdout!.on('data', (data: string) => {
+			this.output += data;
+			this.parse();
+		});
+		proc.stdin!.on('error', () => this.close());
+		proc.on('error', () => this.close());
+		proc.on('close', () => this.close());
+	}
+
+	// "<id> data <n>\n" followed by n chars of output, any number of times, then "<id> exit <code>\n"
+	private parse() {
+		let pos = 0;
+		for (;;) {
+			const nl = this.output.indexOf('\n', pos);
+			if (nl < 0)
+				break;
+
+			const [id, kind, n] = this.output.substring(pos, nl).split(' ');
+			const req = this.pending[id];
+			if (kind === 'data') {
+				const end = nl + 1 + +n;
+				if (end > this.output.length)
+					break;
+				if (req)
+					req.stdout += this.output.substring(nl + 1, end);
+				pos = end;
+
+			} else {
+				pos = nl + 1;
+				if (req) {
+					delete this.pending[id];
+					this.answered = true;
+					const code = +n;
+					if (code)
+						req.reject(new Error(`${this.exec} ${req.args.join(' ')} command exited with code ${code}:\n${req.stdout.trim()}`, {cause:code}));
+					else
+						req.resolve(req);
+				}
+			}
+		}
+		this.output = this.output.substring(pos);
+	}
+
+	// an executable without SERVE just exits; anything still waiting is run the old way
+	private close() {
+		if (this.closed)
+			return;
+		this.closed = true;
+		if (!this.answered)
+			no_server = true;
+		for (const req of Object.values(this.pending))
+			spawnReg(this.exec, req.plain).then(req.resolve, req.reject);
+		this.pending = {};
+	}
+
+	public run(args: string[], plain: string[]) : Promise<Output> {
+		return new Promise<Output>((resolve, reject) => {
+			const id		= `${this.next++}`;
+			const request	= args.map(a => a + '\0').join('');
+			this.pending[id] = {args, plain, stdout: '', resolve, reject};
+			this.proc.stdin!.write(`${id} ${request.length}\n${request}`);
+		});
+	}
+
+	public stop() {
+		this.proc.stdin!.end();
+	}
+}
+
+let server: Server | undefined;
+let no_server = false;		// reg_exec turned out not to have SERVE
+
+// plain is what to run if the executable turns out not to have SERVE, so args can use what only executables with it understand
+function runReg(args: string[], plain = args) : Promise<Output> {
+	// the system's reg.exe doesn't have it
+	if (no_server || reg_exec === systemReg())
+		return spawnReg(reg_exec, plain);
+	if (!server || server.closed)
+		server = new Server(reg_exec);
+	return server.run(args, plain);
+}
+
 function argName(name?:string) {
 	return name ? ['/v', name] : ['/ve'];
 }
@@ -372,6 +493,7 @@ export class KeyPromise implements KeyBase {
 	public _items?: Promise<Record<string, Data>>;
 	public _keys: 	Record<string, KeyPromise> = {};
 	public found?:	boolean;
+	private lastWrite = '0';	// as of _items, if it came from QUERY /ifmodified
 
 	constructor(public name: string, public parent?: KeyPromise) {}
 
@@ -403,13 +525,17 @@ export class KeyPromise implements KeyBase {
 		return this.path;
 	}
 
-	private runCommand(command:string, ...args:string[]) {
+	private commandArgs(command:string, ...args:string[]) {
 		const [root, fullpath] = this.getRootAndPath();
 		const view = hosts32[root.name] === root ? '32' : '64';
 		if (view)
 			args.push('/reg:' + view);
 
-		return new Promise<Process>((resolve, reject) => new Process(reg_exec, [command, fullpath, ...args], resolve, reject));
+		return [command, fullpath, ...args];
+	}
+
+	private runCommand(command:string, ...args:string[]) {
+		return runReg(this.commandArgs(command, ...args));
 	}
 
 	private add_found_key(key:string) {
@@ -421,10 +547,23 @@ export class KeyPromise implements KeyBase {
 	}
 
 	public reread() : Promise<Record<string, any>> {
-		return this._items = this.runCommand('QUERY', '/z').then(proc => {
+		// a key that hasn't been written since it was last read keeps what was read then, without its values being read again
+		const prev	= this._items;
+		const plain	= this.commandArgs('QUERY', '/z');
+		const since	= prev ? this.lastWrite : '0';
+		return this._items = runReg([...plain, `/ifmodified:${since}`], plain).then(proc => {
+			const lines = proc.stdout.split('\n');
+			const first = lines[0].trim();
+			if (prev && first.startsWith('Unchanged '))
+				return prev;
+			if (first.startsWith('LastWrite ')) {
+				this.lastWrite = first.substring(10);
+				lines.shift();
+			}
+
 			const items : Record<string, Data> = {};
 			let lineNumber = 0;
-			for (const i of proc.stdout.split('\n')) {
+			for (const i of lines) {
 				const line = i.trim();
 				if (line.length > 0) {
 					if (lineNumber++ !== 0) {
@@ -645,7 +784,7 @@ export async function importReg(file: string, view?: string, dirty?: KeyBase[])
 	if (view)
 		args.push('/reg:' + view);
 
-	return new Promise<Process>((resolve, reject) => new Process(reg_exec, args, resolve, reject)).then(() => {
+	return runReg(args).then(() => {
 		if (dirty) {
 			const parents = new Set<KeyPromise>();
 			for (const i of dirty) {
@@ -666,7 +805,12 @@ export async function importReg(file: string, view?: string, dirty?: KeyBase[])
 
 export async function setExecutable(file?: string) {
 	if (!file)
-		file = process.platform === 'win32' ? path.join(process.env.windir || '', 'system32', 'reg.exe') : "REG";
+		file = systemReg();
+	if (file !== reg_exec) {
+		server?.stop();
+		server		= undefined;
+		no_server	= false;
+	}
 	reg_exec = file;
 }
 